@@ -0,0 +1,93 @@
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+#include "analysis.h"
+#include "chess_board.h"
+#include "chess_player.h"
+#include "engine.h"
+
+using std::atomic;
+using std::istringstream;
+using std::lock_guard;
+using std::mutex;
+using std::thread;
+
+ostream& operator<<(ostream& os, const AnalysisResult& result) {
+    os << result.index;
+    if (!result.has_move) {
+        return os << " error " << result.error;
+    }
+    return os
+        << " bestmove " << result.best_move << " score cp " << result.score
+        << " depth " << result.depth << " nodes " << result.nodes
+        << " time " << static_cast<long>(result.seconds * 1000);
+}
+
+static AnalysisResult analyze_position(const AIPlayer& player, const string& position, const SearchLimits& limits) {
+    AnalysisResult result;
+    Board board;
+    try {
+        istringstream args(position);
+        read_position(args, board);
+    }
+    catch (const std::exception& error) {
+        result.error = error.what();
+        return result;
+    }
+    if (board.game_over() || board.get_moves().empty()) {
+        result.error = "the game is over";
+        return result;
+    }
+    int sign = board.teams_turn() == WHITE ? 1 : -1;
+    result.best_move = player.search(board, limits, [&](const SearchProgress& progress) {
+        result.score = sign * progress.score;
+        result.depth = progress.depth;
+        result.nodes = progress.nodes;
+        result.seconds = progress.seconds;
+    });
+    result.has_move = true;
+    return result;
+}
+
+void analyze_positions(
+    const vector<string>& positions, const AnalysisOptions& options,
+    const function<void(const AnalysisResult&)>& emit) {
+    int threads = options.threads > 0 ? options.threads : std::max(1u, thread::hardware_concurrency());
+    threads = std::max(1, std::min<int>(threads, static_cast<int>(positions.size())));
+    SearchLimits limits = options.limits;
+    limits.stop = nullptr;
+
+    // Finished results wait here until every result before them is done.
+    vector<AnalysisResult> results(positions.size());
+    vector<bool> done(positions.size(), false);
+    size_t next_to_emit = 0;
+    mutex results_mutex;
+    atomic<size_t> next_position(0);
+
+    auto work = [&]() {
+        AIPlayer player(WHITE, options.network);
+        for (size_t i = next_position++; i < positions.size(); i = next_position++) {
+            AnalysisResult result = analyze_position(player, positions[i], limits);
+            result.index = i;
+            lock_guard<mutex> lock(results_mutex);
+            results[i] = result;
+            done[i] = true;
+            while (next_to_emit < positions.size() && done[next_to_emit]) {
+                emit(results[next_to_emit]);
+                // Emitted results aren't needed any more.
+                results[next_to_emit] = AnalysisResult();
+                ++next_to_emit;
+            }
+        }
+    };
+    vector<thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back(work);
+    }
+    for (thread& worker : workers) {
+        worker.join();
+    }
+}
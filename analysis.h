@@ -0,0 +1,57 @@
+#ifndef _ANALYSIS_H_
+#define _ANALYSIS_H_
+
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "chess_board.h"
+#include "chess_nnue.h"
+#include "chess_player.h"
+
+using std::function;
+using std::ostream;
+using std::string;
+using std::vector;
+
+struct AnalysisOptions {
+    // The search for each position (its stop flag is ignored).
+    SearchLimits limits;
+    // Worker threads, 0 for one per core.
+    int threads = 0;
+    const NnueNetwork* network = nullptr;
+};
+
+// What the search found for one position.
+struct AnalysisResult {
+    // The position's index in the input.
+    size_t index = 0;
+    // False if the position couldn't be read or the game is already over, in
+    // which case error says why.
+    bool has_move = false;
+    Move best_move;
+    // From the side to move's point of view.
+    int score = 0;
+    int depth = 0;
+    uint64_t nodes = 0;
+    double seconds = 0;
+    string error;
+};
+
+// One line per result: "<index> bestmove <move> score cp <s> depth <d>
+// nodes <n> time <ms>", or "<index> error <why>".
+ostream& operator<<(ostream& os, const AnalysisResult& result);
+
+// Searches every position (each in the engine protocol's position format,
+// see read_position in engine.h) on a pool of worker threads and calls emit
+// with the results in input order, as soon as each one and all those before
+// it are done. Each worker keeps one AIPlayer and its thread's evaluation
+// caches for all the positions it searches. emit is never called by two
+// threads at once.
+void analyze_positions(
+    const vector<string>& positions, const AnalysisOptions& options,
+    const function<void(const AnalysisResult&)>& emit);
+
+#endif  // _ANALYSIS_H_
@@ -0,0 +1,388 @@
+// Microbenchmarks for the board, move generation, evaluation and text I/O,
+// and a fixed-depth search whose node count is a signature of the search:
+// a change that shouldn't change what the search does has to leave it alone.
+//
+// Usage: bench [--json file] [--filter text] [--min-time seconds] [--depth n]
+// Prints a table, and with --json also writes the results as JSON so runs
+// can be compared for regressions. Run `make bench` to build and run it.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "board_reader.h"
+#include "chess_board.h"
+#include "chess_eval.h"
+#include "chess_player.h"
+#include "eval_batch.h"
+#include "notation.h"
+#include "utf8_codepoint.h"
+
+using std::cerr;
+using std::cout;
+using std::endl;
+using std::function;
+using std::string;
+using std::stringstream;
+using std::vector;
+
+using Clock = std::chrono::steady_clock;
+
+struct BenchPosition {
+    const char* name;
+    const char* notation;
+};
+
+const BenchPosition BENCH_POSITIONS[] = {
+    { "start", "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w" },
+    { "middlegame", "r1bq1rk1/pp2bppp/2n1pn2/3p4/3P4/2NBPN2/PP3PPP/R1BQ1RK1 w" },
+    { "endgame", "8/5pk1/6p1/3r4/8/2R3P1/5PK1/8 b" },
+    { "fairy", "rhbqkbmr/pppppppp/8/8/8/8/PPPPPPPP/RHBQKBMR w" },
+};
+
+// Samples per benchmark. The fastest is reported as the time, since noise
+// only ever makes a run slower.
+const int SAMPLES = 5;
+
+struct BenchResult {
+    string name;
+    uint64_t iterations;
+    double best_ns;
+    double median_ns;
+};
+
+// Written to after every benchmark so the compiler can't drop the work.
+volatile uint64_t bench_sink;
+
+// Runs body(iterations), which returns a checksum of what it computed, with
+// enough iterations per sample to take min_seconds / SAMPLES.
+static BenchResult run_bench(const string& name, double min_seconds, const function<uint64_t(uint64_t)>& body) {
+    double sample_seconds = min_seconds / SAMPLES;
+    uint64_t iterations = 1;
+    while (true) {
+        auto start = Clock::now();
+        bench_sink = body(iterations);
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        if (seconds >= sample_seconds) {
+            break;
+        }
+        // Aim a bit past the target so this usually takes one more step.
+        double scale = seconds > 0 ? 1.2 * sample_seconds / seconds : 100;
+        iterations = std::max(iterations + 1, static_cast<uint64_t>(iterations * std::min(scale, 100.0)));
+    }
+    vector<double> samples;
+    for (int i = 0; i < SAMPLES; ++i) {
+        auto start = Clock::now();
+        bench_sink = body(iterations);
+        samples.push_back(std::chrono::duration<double, std::nano>(Clock::now() - start).count() / iterations);
+    }
+    std::sort(samples.begin(), samples.end());
+    return BenchResult{ name, iterations, samples[0], samples[SAMPLES / 2] };
+}
+
+// Positions reached by seeded random games from the bench positions, for
+// benchmarks that shouldn't keep looking at the same board.
+static vector<Board> playout_positions(int count) {
+    std::mt19937 rng(12345);
+    vector<Board> boards;
+    while (static_cast<int>(boards.size()) < count) {
+        for (const BenchPosition& position : BENCH_POSITIONS) {
+            Board board = board_from_notation(position.notation);
+            for (int ply = 0; ply < 40 && board.winner() == NONE && static_cast<int>(boards.size()) < count; ++ply) {
+                vector<Move> moves = board.get_moves();
+                if (moves.empty()) {
+                    break;
+                }
+                board.make_move(moves[rng() % moves.size()]);
+                boards.push_back(board);
+            }
+        }
+    }
+    return boards;
+}
+
+static vector<BenchResult> run_microbenchmarks(double min_seconds, const string& filter) {
+    vector<BenchResult> results;
+    auto bench = [&](const string& name, const function<uint64_t(uint64_t)>& body) {
+        if (name.find(filter) == string::npos) {
+            return;
+        }
+        results.push_back(run_bench(name, min_seconds, body));
+        const BenchResult& result = results.back();
+        cout << std::left << std::setw(32) << result.name << std::right << std::fixed << std::setprecision(1)
+            << std::setw(12) << result.best_ns << " ns/op" << std::setw(12) << result.median_ns << " median" << endl;
+    };
+
+    for (const BenchPosition& position : BENCH_POSITIONS) {
+        Board board = board_from_notation(position.notation);
+        bench(string("get_moves/") + position.name, [&board](uint64_t iterations) {
+            uint64_t total = 0;
+            for (uint64_t i = 0; i < iterations; ++i) {
+                total += board.get_moves().size();
+            }
+            return total;
+        });
+    }
+    for (const BenchPosition& position : BENCH_POSITIONS) {
+        Board board = board_from_notation(position.notation);
+        vector<Move> moves = board.get_moves();
+        // One op is a make_move and its undo_move, through every move in turn.
+        bench(string("make_undo_move/") + position.name, [&board, &moves](uint64_t iterations) {
+            uint64_t total = 0;
+            for (uint64_t i = 0; i < iterations; ++i) {
+                board.make_move(moves[i % moves.size()]);
+                total += board.hash();
+                board.undo_move();
+            }
+            return total;
+        });
+    }
+
+    vector<Board> boards = playout_positions(1024);
+    bench("winner", [&boards](uint64_t iterations) {
+        uint64_t total = 0;
+        for (uint64_t i = 0; i < iterations; ++i) {
+            total += boards[i % boards.size()].winner();
+        }
+        return total;
+    });
+    // AIPlayer::eval goes through the eval cache, which holds every one of
+    // these positions after the first pass, as it would the positions a
+    // search keeps coming back to. evaluate is the full evaluation.
+    AIPlayer player(WHITE, nullptr, 1);
+    bench("eval/AIPlayer::eval", [&boards, &player](uint64_t iterations) {
+        uint64_t total = 0;
+        for (uint64_t i = 0; i < iterations; ++i) {
+            total += player.eval(boards[i % boards.size()]);
+        }
+        return total;
+    });
+    bench("eval/evaluate", [&boards](uint64_t iterations) {
+        uint64_t total = 0;
+        for (uint64_t i = 0; i < iterations; ++i) {
+            total += evaluate(boards[i % boards.size()]);
+        }
+        return total;
+    });
+    // What evaluate_batch computes, a board at a time and without the
+    // caches.
+    bench("eval/evaluate+pawn_structure_eval", [&boards](uint64_t iterations) {
+        uint64_t total = 0;
+        for (uint64_t i = 0; i < iterations; ++i) {
+            const Board& board = boards[i % boards.size()];
+            total += evaluate(board) + pawn_structure_eval(board);
+        }
+        return total;
+    });
+    // One op is one position of a batch of all of them.
+    EvalBatch batch(boards.size());
+    for (const Board& board : boards) {
+        batch.add(board);
+    }
+    vector<int> batch_scores(batch.size());
+    bench("eval/evaluate_batch", [&batch, &batch_scores](uint64_t iterations) {
+        uint64_t total = 0;
+        for (uint64_t done = 0; done < iterations; done += batch.size()) {
+            evaluate_batch(batch, batch_scores.data());
+            total += batch_scores[done % batch.size()];
+        }
+        return total;
+    });
+
+    // The printed boards are mostly multi-byte chess glyphs and box drawing
+    // characters, so they're a fair sample of the text we decode.
+    stringstream printed;
+    for (size_t i = 0; i < 16; ++i) {
+        printed << boards[i * 37 % boards.size()] << '\n';
+    }
+    string text = printed.str();
+    vector<char32_t> code_points(text.size());
+    size_t num_code_points = utf8_decode(text.data(), text.size(), code_points.data());
+    code_points.resize(num_code_points);
+    bench("utf8/decode_board_text", [&text](uint64_t iterations) {
+        vector<char32_t> out(text.size());
+        uint64_t total = 0;
+        for (uint64_t i = 0; i < iterations; ++i) {
+            total += utf8_decode(text.data(), text.size(), out.data());
+        }
+        return total;
+    });
+    bench("utf8/encode_board_text", [&code_points](uint64_t iterations) {
+        string out(code_points.size() * 4, '\0');
+        uint64_t total = 0;
+        for (uint64_t i = 0; i < iterations; ++i) {
+            total += utf8_encode(code_points.data(), code_points.size(), &out[0]);
+        }
+        return total;
+    });
+    // One op reads or writes one code point through the stream operators.
+    bench("utf8/UTF8CodePoint>>", [&text, num_code_points](uint64_t iterations) {
+        uint64_t total = 0;
+        stringstream in;
+        UTF8CodePoint cp;
+        for (uint64_t i = 0; i < iterations; ++i) {
+            if (!(in >> cp)) {
+                in.clear();
+                in.str(text);
+                in >> cp;
+            }
+            total += static_cast<char32_t>(cp);
+        }
+        return total;
+    });
+    bench("utf8/UTF8CodePoint<<", [&code_points](uint64_t iterations) {
+        stringstream out;
+        for (uint64_t i = 0; i < iterations; ++i) {
+            if (i % code_points.size() == 0) {
+                out.str("");
+            }
+            out << UTF8CodePoint(code_points[i % code_points.size()]);
+        }
+        return static_cast<uint64_t>(out.tellp());
+    });
+
+    Board start = board_from_notation(BENCH_POSITIONS[0].notation);
+    stringstream start_printed;
+    start_printed << start;
+    string start_text = start_printed.str();
+    bench("board/print", [&start](uint64_t iterations) {
+        uint64_t total = 0;
+        stringstream out;
+        for (uint64_t i = 0; i < iterations; ++i) {
+            out.str("");
+            out << start;
+            total += out.tellp();
+        }
+        return total;
+    });
+    bench("board/read", [&start_text](uint64_t iterations) {
+        uint64_t total = 0;
+        Board board;
+        for (uint64_t i = 0; i < iterations; ++i) {
+            stringstream in(start_text);
+            BoardReader reader(in);
+            reader.read(board);
+            total += board.hash();
+        }
+        return total;
+    });
+    bench("board/notation_print", [&boards](uint64_t iterations) {
+        uint64_t total = 0;
+        string out;
+        for (uint64_t i = 0; i < iterations; ++i) {
+            out.clear();
+            append_notation(boards[i % boards.size()], out);
+            total += out.size();
+        }
+        return total;
+    });
+    vector<string> notations;
+    for (const Board& board : boards) {
+        notations.push_back(board_to_notation(board));
+    }
+    bench("board/notation_parse", [&notations](uint64_t iterations) {
+        uint64_t total = 0;
+        Board board = board_from_notation(notations[0]);
+        for (uint64_t i = 0; i < iterations; ++i) {
+            const string& notation = notations[i % notations.size()];
+            total += parse_notation(notation.data(), notation.data() + notation.size(), board);
+        }
+        return total;
+    });
+    return results;
+}
+
+struct SearchBench {
+    int depth;
+    uint64_t nodes;
+    double seconds;
+};
+
+// Searches every bench position to depth with a seeded AIPlayer. The node
+// count only depends on what the search does, not how fast it does it.
+static SearchBench run_search_bench(int depth) {
+    SearchBench result{ depth, 0, 0 };
+    SearchLimits limits;
+    limits.depth = depth;
+    for (const BenchPosition& position : BENCH_POSITIONS) {
+        Board board = board_from_notation(position.notation);
+        AIPlayer player(board.teams_turn(), nullptr, 1);
+        auto start = Clock::now();
+        player.search(board, limits);
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        cout << std::left << std::setw(32) << (string("search/") + position.name) << std::right
+            << std::setw(12) << player.stats().nodes << " nodes" << std::fixed << std::setprecision(3)
+            << std::setw(10) << seconds << " s" << endl;
+        result.nodes += player.stats().nodes;
+        result.seconds += seconds;
+    }
+    return result;
+}
+
+static void write_json(std::ostream& os, const vector<BenchResult>& results, const SearchBench* search) {
+    os << "{\n  \"benchmarks\": [";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchResult& result = results[i];
+        os << (i == 0 ? "\n" : ",\n") << std::fixed << std::setprecision(2)
+            << "    {\"name\": \"" << result.name << "\", \"iterations\": " << result.iterations
+            << ", \"ns_per_op\": " << result.best_ns << ", \"median_ns_per_op\": " << result.median_ns << "}";
+    }
+    os << "\n  ]";
+    if (search) {
+        os << ",\n  \"search\": {\"depth\": " << search->depth << ", \"nodes\": " << search->nodes
+            << ", \"seconds\": " << std::setprecision(4) << search->seconds
+            << ", \"nps\": " << std::setprecision(0) << search->nodes / search->seconds << "}";
+    }
+    os << "\n}" << endl;
+}
+
+int main(int argc, const char* argv[]) {
+    string json_path, filter;
+    double min_seconds = 0.5;
+    int depth = 5;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (i + 1 < argc && arg == "--json") {
+            json_path = argv[++i];
+        }
+        else if (i + 1 < argc && arg == "--filter") {
+            filter = argv[++i];
+        }
+        else if (i + 1 < argc && arg == "--min-time") {
+            min_seconds = std::stod(argv[++i]);
+        }
+        else if (i + 1 < argc && arg == "--depth") {
+            depth = std::stoi(argv[++i]);
+        }
+        else {
+            cerr << "Usage: bench [--json file] [--filter text] [--min-time seconds] [--depth n]" << endl;
+            return 1;
+        }
+    }
+
+    vector<BenchResult> results = run_microbenchmarks(min_seconds, filter);
+    SearchBench search{ depth, 0, 0 };
+    bool searched = string("search").find(filter) != string::npos || filter.empty();
+    if (searched) {
+        search = run_search_bench(depth);
+        cout << "Nodes searched: " << search.nodes << endl;
+        cout << "Nodes/second: " << static_cast<uint64_t>(search.nodes / search.seconds) << endl;
+    }
+    if (!json_path.empty()) {
+        std::ofstream out(json_path);
+        write_json(out, results, searched ? &search : nullptr);
+        if (!out) {
+            cerr << "Could not write " << json_path << endl;
+            return 1;
+        }
+    }
+    return 0;
+}
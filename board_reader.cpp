@@ -0,0 +1,156 @@
+#include <sstream>
+#include <stdexcept>
+
+#include "board_reader.h"
+#include "chess_board.h"
+#include "chess_pieces.h"
+#include "piece_registry.h"
+#include "utf8_codepoint.h"
+
+using std::getline;
+using std::runtime_error;
+using std::stringstream;
+
+// If line is the row of column letters above and below a board ("abc..."
+// after some spaces), returns the number of columns, otherwise 0.
+static int column_labels(const string& line) {
+    size_t start = line.find_first_not_of(' ');
+    size_t end = line.find_last_not_of(' ');
+    if (start == string::npos) {
+        return 0;
+    }
+    for (size_t i = start; i <= end; ++i) {
+        if (line[i] != 'a' + static_cast<int>(i - start)) {
+            return 0;
+        }
+    }
+    return static_cast<int>(end - start + 1);
+}
+
+static bool is_blank(const string& line) {
+    return line.find_first_not_of(" \t") == string::npos;
+}
+
+BoardReader::BoardReader(istream& in) : in(in), line_number(0) {}
+
+int BoardReader::line() const {
+    return line_number;
+}
+
+bool BoardReader::next_line(string& line) {
+    if (!getline(in, line)) {
+        return false;
+    }
+    ++line_number;
+    if (!line.empty() && line.back() == '\r') {
+        line.pop_back();
+    }
+    return true;
+}
+
+void BoardReader::error(const string& message) const {
+    stringstream err_msg;
+    err_msg << "BoardReader: line " << line_number << ": " << message;
+    throw runtime_error(err_msg.str());
+}
+
+bool BoardReader::read(Board& board) {
+    string line;
+    do {
+        if (!next_line(line)) {
+            return false;
+        }
+    } while (is_blank(line));
+
+    int width = column_labels(line);
+    if (width == 0) {
+        error("expected the column letters at the top of a board");
+    }
+    cells.clear();
+    const PieceRegistry& registry = piece_registry();
+    int height = 0, next_row = 0;
+    while (true) {
+        if (!next_line(line)) {
+            error("the board ends before its bottom row of column letters");
+        }
+        if (column_labels(line) == width) {
+            break;
+        }
+        size_t position = line.find_first_not_of(' ');
+        int row_number = 0;
+        size_t digits_start = position;
+        for (; position < line.size() && line[position] >= '0' && line[position] <= '9'; ++position) {
+            row_number = row_number * 10 + (line[position] - '0');
+        }
+        if (digits_start == string::npos || position == digits_start) {
+            error("expected a row number");
+        }
+        if (height == 0) {
+            height = next_row = row_number;
+        }
+        if (row_number != next_row || row_number < 1) {
+            stringstream err_msg;
+            err_msg << "expected row " << next_row << ", not " << row_number;
+            error(err_msg.str());
+        }
+        --next_row;
+        if (position == line.size() || line[position] != ' ') {
+            error("expected a space after the row number");
+        }
+        size_t cells_start = position + 1, cells_end = line.size();
+        // The row number is repeated after the cells.
+        size_t last_space = line.find_last_of(' ');
+        if (last_space >= cells_start && last_space + 1 < line.size()) {
+            if (line.find_first_not_of("0123456789", last_space + 1) == string::npos) {
+                if (std::stoi(line.substr(last_space + 1)) != row_number) {
+                    error("the row numbers at the start and end of the row don't match");
+                }
+                cells_end = last_space;
+            }
+        }
+        size_t num_bytes = cells_end - cells_start, bytes_used;
+        code_points.resize(num_bytes);
+        size_t num_cells = utf8_decode(line.data() + cells_start, num_bytes, code_points.data(), &bytes_used);
+        code_points.resize(num_cells);
+        if (bytes_used != num_bytes) {
+            error("invalid UTF-8");
+        }
+        if (num_cells != static_cast<size_t>(width)) {
+            stringstream err_msg;
+            err_msg << "expected " << width << " cells in row " << row_number << ", not " << num_cells;
+            error(err_msg.str());
+        }
+        for (char32_t cp : code_points) {
+            const ChessPiece* piece = registry.find(cp);
+            if (!piece) {
+                stringstream err_msg;
+                err_msg << "unknown piece " << UTF8CodePoint(cp);
+                error(err_msg.str());
+            }
+            cells.push_back(piece);
+        }
+    }
+    if (height == 0 || next_row != 0) {
+        error("the rows should count down to 1");
+    }
+
+    board.clear(width, height);
+    for (int i = 0; i < height; ++i) {
+        for (int x = 0; x < width; ++x) {
+            // The first row read is the top of the board.
+            board.set_piece(Cell(x, height - 1 - i), *cells[i * width + x]);
+        }
+    }
+    // Boards and blank lines start with a space or a line break, so peeking
+    // at one character tells a turn line is next without taking anything
+    // else (and on a pipe waits for at most that one character).
+    int next = in.peek();
+    if (next == 'W' || next == 'B') {
+        next_line(line);
+        if (line != "White's turn." && line != "Black's turn.") {
+            error("expected \"White's turn.\" or \"Black's turn.\" after the board");
+        }
+        board.set_teams_turn(line[0] == 'W' ? WHITE : BLACK);
+    }
+    return true;
+}
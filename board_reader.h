@@ -0,0 +1,38 @@
+#ifndef _BOARD_READER_H_
+#define _BOARD_READER_H_
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "chess_board.h"
+#include "chess_pieces.h"
+
+using std::istream;
+using std::string;
+using std::vector;
+
+// Reads boards written the way operator<<(ostream&, const Board&) prints
+// them (see board.txt) from a stream, one line at a time and without ever
+// seeking, so it works on std::cin and pipes. A stream can hold any number
+// of boards, separated by blank lines. A board can be followed by a
+// "White's turn." or "Black's turn." line; otherwise it's White's turn.
+class BoardReader {
+    istream& in;
+    int line_number;
+    vector<const ChessPiece*> cells;
+    vector<char32_t> code_points;
+
+    bool next_line(string& line);
+    [[noreturn]] void error(const string& message) const;
+public:
+    explicit BoardReader(istream& in);
+    // Reads the next board into board. Returns false if there are no more
+    // boards. Throws runtime_error, saying which line is wrong, if the input
+    // isn't a board.
+    bool read(Board& board);
+    // The number of lines read so far.
+    int line() const;
+};
+
+#endif  // _BOARD_READER_H_
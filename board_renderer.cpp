@@ -0,0 +1,131 @@
+#include <string>
+
+#include "board_renderer.h"
+#include "chess_board.h"
+#include "chess_pieces.h"
+#include "utf8_codepoint.h"
+
+using std::to_string;
+
+// Terminals draw most emoji (like the Mouse) two columns wide, which shifts
+// every cell after them.
+static bool is_wide(char32_t cp) {
+    return cp >= 0x1F000;
+}
+
+static void add_ascii(vector<char32_t>& text, const string& ascii) {
+    text.insert(text.end(), ascii.begin(), ascii.end());
+}
+
+// Moves the cursor to a 1-based line and column.
+static void add_cursor_move(vector<char32_t>& text, int line, int column) {
+    add_ascii(text, "\x1b[" + to_string(line) + ';' + to_string(column) + 'H');
+}
+
+static void add_column_labels(vector<char32_t>& text, int width) {
+    add_ascii(text, "   ");
+    for (int x = 0; x < width; ++x) {
+        text.push_back(static_cast<char32_t>('a' + x));
+    }
+    text.push_back('\n');
+}
+
+static void add_row(vector<char32_t>& text, const Board& board, int y) {
+    string rank = to_string(y + 1);
+    add_ascii(text, y >= 9 ? rank + ' ' : ' ' + rank + ' ');
+    for (int x = 0; x < board.width(); ++x) {
+        text.push_back(board[Cell(x, y)].utf8_codepoint);
+    }
+    add_ascii(text, ' ' + rank + '\n');
+}
+
+BoardRenderer::BoardRenderer() : shown_width(0), shown_height(0) {}
+
+void BoardRenderer::encode_text() {
+    buffer.resize(4 * text.size());
+    buffer.resize(utf8_encode(text.data(), text.size(), &buffer[0]));
+}
+
+const string& BoardRenderer::render(const Board& board) {
+    text.clear();
+    add_column_labels(text, board.width());
+    for (int y = board.height() - 1; y >= 0; --y) {
+        add_row(text, board, y);
+    }
+    add_column_labels(text, board.width());
+    encode_text();
+    return buffer;
+}
+
+void BoardRenderer::write(ostream& os, const Board& board) {
+    const string& rendered = render(board);
+    os.write(rendered.data(), rendered.size());
+}
+
+void BoardRenderer::reset() {
+    shown.clear();
+    shown_width = shown_height = 0;
+}
+
+void BoardRenderer::write_changes(ostream& os, const Board& board) {
+    int width = board.width(), height = board.height();
+    text.clear();
+    if (width != shown_width || height != shown_height) {
+        // Clear the screen and draw everything from the top left corner.
+        add_ascii(text, "\x1b[2J\x1b[H");
+        add_column_labels(text, width);
+        for (int y = height - 1; y >= 0; --y) {
+            add_row(text, board, y);
+        }
+        add_column_labels(text, width);
+        shown.resize(width * height);
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                shown[y * width + x] = &board[Cell(x, y)];
+            }
+        }
+        shown_width = width;
+        shown_height = height;
+    }
+    else {
+        for (int y = 0; y < height; ++y) {
+            const ChessPiece** shown_row = &shown[y * width];
+            // The screen line of row y, below the column labels.
+            int line = 2 + (height - 1 - y);
+            bool changed = false, wide = false;
+            for (int x = 0; x < width; ++x) {
+                const ChessPiece& piece = board[Cell(x, y)];
+                changed = changed || shown_row[x] != &piece;
+                wide = wide || is_wide(piece.utf8_codepoint) || is_wide(shown_row[x]->utf8_codepoint);
+            }
+            if (!changed) {
+                continue;
+            }
+            if (wide) {
+                // Cell columns move around, so redraw the whole row.
+                add_cursor_move(text, line, 1);
+                add_ascii(text, "\x1b[K");
+                add_row(text, board, y);
+            }
+            else {
+                for (int x = 0; x < width; ++x) {
+                    const ChessPiece& piece = board[Cell(x, y)];
+                    if (shown_row[x] != &piece) {
+                        // Rows start with the 3 column row number.
+                        add_cursor_move(text, line, 4 + x);
+                        text.push_back(piece.utf8_codepoint);
+                    }
+                }
+            }
+            for (int x = 0; x < width; ++x) {
+                shown_row[x] = &board[Cell(x, y)];
+            }
+        }
+        add_cursor_move(text, height + 3, 1);
+    }
+    // Clear whatever was written below the board last time.
+    add_ascii(text, "\x1b[J");
+    encode_text();
+    os.write(buffer.data(), buffer.size());
+    os.flush();
+}
@@ -0,0 +1,44 @@
+#ifndef _BOARD_RENDERER_H_
+#define _BOARD_RENDERER_H_
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "chess_board.h"
+#include "chess_pieces.h"
+
+using std::ostream;
+using std::string;
+using std::vector;
+
+// Draws boards as text, keeping its buffers from one board to the next so
+// drawing doesn't allocate once they are big enough.
+class BoardRenderer {
+    vector<char32_t> text;
+    string buffer;
+    // What the terminal shows, for write_changes.
+    vector<const ChessPiece*> shown;
+    int shown_width;
+    int shown_height;
+
+    // Encodes text into buffer.
+    void encode_text();
+public:
+    BoardRenderer();
+    // Formats board the way operator<<(ostream&, const Board&) prints it and
+    // returns the text, which stays valid until the next call.
+    const string& render(const Board& board);
+    // Writes board to os with a single write call.
+    void write(ostream& os, const Board& board);
+    // For watching a game live in a terminal: the first call clears the
+    // screen and draws board at the top; later calls only redraw the cells
+    // that changed, using ANSI cursor movement. Either way the cursor is left
+    // on the line below the board, with the rest of the screen cleared.
+    void write_changes(ostream& os, const Board& board);
+    // Forgets what the terminal shows, so the next write_changes redraws
+    // the whole screen.
+    void reset();
+};
+
+#endif  // _BOARD_RENDERER_H_
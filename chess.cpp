@@ -1,78 +1,393 @@
-#include <algorithm>
-#include <chrono>
-#include <iostream>
-#include <map>
-#include <vector>
-#include <fstream>
-#include "chess_pieces.h"
-#include "chess_board.h"
-#include "chess_player.h"
-
-using namespace std;
-
-void play_chess_one_turn(Board& board, Player& player) {
-    cout << board << endl;
-    cout << player.name() << "'s turn." << endl;
-    vector<Move> moves = board.get_moves();
-    Move move;
-    while (true) {
-        move = player.get_move(board, moves);
-        if (find(moves.begin(), moves.end(), move) != moves.end()) {
-            break;
-        }
-    }
-    cout
-        << player.name() << " chose to move " << board[move.from]
-        << " from " << move.from << " to " << move.to << " ("
-        << board[move.to] << ")\n\n";
-    board.make_move(move);
-}
-
-Team play_one_chess_game(Player& white_player, Player& black_player) {
-    Board board;
-    vector<Move> moves;
-    while (true) {
-        play_chess_one_turn(board, white_player);
-        if (board.winner() != NONE) {
-            break;
-        }
-        play_chess_one_turn(board, black_player);
-        if (board.winner() != NONE) {
-            break;
-        }
-    }
-    Team winner = board.winner();
-    cout << team_name(winner) << " won!\n";
-    return winner;
-}
-
-int main(int argc, const char* argv[]) {
-    AIPlayer white1(WHITE);
-    CheckMateCapturePlayer black1(BLACK);
-    AIPlayer black2(BLACK);
-    CheckMateCapturePlayer white2(WHITE);
-    HumanPlayer human(WHITE);
-
-    play_one_chess_game(human, black2);
-
-    return 0;
-
-
-    int counter1 = 0;
-    int counter2 = 0;
-    int num_games = 100;
-    for (int i = 1; i <= num_games; ++i)
-    {
-        Team x = play_one_chess_game(white1, black1);
-        Team y = play_one_chess_game(white2, black2);
-        if (x == WHITE)
-            ++counter1;
-        if (y == BLACK)
-            ++counter2;
-        cout << endl;
-    }
-    cout << "As white AI Player won: " << counter1 << "/" << num_games << endl;
-    cout << "As black AI Player won: " << counter2 << "/" << num_games << endl;
-
-    return 0;
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <thread>
+#include <vector>
+#include <fstream>
+#include "analysis.h"
+#include "board_reader.h"
+#include "board_renderer.h"
+#include "chess_pieces.h"
+#include "chess_board.h"
+#include "chess_player.h"
+#include "chess_nnue.h"
+#include "defined_pieces.h"
+#include "engine.h"
+#include "game_record.h"
+#include "game_scheduler.h"
+#include "nnue_trainer.h"
+#include "notation.h"
+#include "position_dataset.h"
+#include "sharded_tournament.h"
+#include "sprt.h"
+#include "texel_tuner.h"
+#include "tournament.h"
+
+using namespace std;
+
+void play_chess_one_turn(Board& board, Player& player) {
+    cout << board << endl;
+    cout << player.name() << "'s turn." << endl;
+    vector<Move> moves = board.get_moves();
+    Move move;
+    while (true) {
+        move = player.get_move(board, moves);
+        if (find(moves.begin(), moves.end(), move) != moves.end()) {
+            break;
+        }
+    }
+    cout
+        << player.name() << " chose to move " << board[move.from]
+        << " from " << move.from << " to " << move.to << " ("
+        << board[move.to] << ")\n\n";
+    board.make_move(move);
+}
+
+Team play_one_chess_game(Player& white_player, Player& black_player) {
+    Board board;
+    vector<Move> moves;
+    while (true) {
+        play_chess_one_turn(board, white_player);
+        if (board.game_over()) {
+            break;
+        }
+        play_chess_one_turn(board, black_player);
+        if (board.game_over()) {
+            break;
+        }
+    }
+    Team winner = board.winner();
+    if (winner == NONE) {
+        cout << "Draw!\n";
+    }
+    else {
+        cout << team_name(winner) << " won!\n";
+    }
+    return winner;
+}
+
+// chess train-nnue <weights file> [games] [epochs]
+// Generates self-play positions, fits a network to them and saves it.
+int train_nnue_command(int argc, const char* argv[]) {
+    string path = argv[2];
+    int num_games = argc > 3 ? stoi(argv[3]) : 2000;
+    int epochs = argc > 4 ? stoi(argv[4]) : 10;
+    vector<NnueTrainingPosition> positions = generate_selfplay_positions(num_games, 1);
+    cout << "Generated " << positions.size() << " positions from " << num_games << " games" << endl;
+    NnueFloatWeights weights = train_nnue(positions, epochs, 1, cout);
+    NnueNetwork(weights).save(path);
+    cout << "Saved network to " << path << endl;
+    return 0;
+}
+
+// chess gen-data <dataset file> [games]
+// Appends labeled self-play positions to a dataset file for the tuner.
+int gen_data_command(int argc, const char* argv[]) {
+    int num_games = argc > 3 ? stoi(argv[3]) : 10000;
+    DatasetWriter writer(argv[2]);
+    long written = 0;
+    for_each_selfplay_position(num_games, 1, [&](const Board& position, Team winner) {
+        PackedPosition packed;
+        if (pack_position(position, winner, packed)) {
+            writer.write(packed);
+            ++written;
+        }
+    });
+    cout << "Wrote " << written << " positions from " << num_games << " games to " << argv[2] << endl;
+    return 0;
+}
+
+// chess tune <dataset file> <parameters file> [epochs]
+// Tunes the evaluation on a dataset and writes the tuned parameter tables.
+int tune_command(int argc, const char* argv[]) {
+    vector<PackedPosition> positions = read_dataset(argv[2]);
+    cout << "Read " << positions.size() << " positions" << endl;
+    TexelTunerOptions options;
+    if (argc > 4) {
+        options.epochs = stoi(argv[4]);
+    }
+    EvalParams tuned = tune_eval_params(positions, eval_params(), options, cout);
+    save_eval_params(tuned, argv[3]);
+    cout << "Saved parameters to " << argv[3] << endl;
+    return 0;
+}
+
+// chess tournament <player> <player> [games] [threads] [seed] [record file]
+// Plays the two kinds of player (see make_player) against each other without
+// printing the games, and prints the first player's results. The games are
+// appended to the record file if one is given.
+int tournament_command(int argc, const char* argv[], const NnueNetwork* network) {
+    TournamentOptions options;
+    options.first_player = argv[2];
+    options.second_player = argv[3];
+    options.network = network;
+    if (argc > 4) {
+        options.games = stoi(argv[4]);
+    }
+    if (argc > 5) {
+        options.threads = stoi(argv[5]);
+    }
+    if (argc > 6) {
+        options.seed = stoul(argv[6]);
+    }
+    if (argc > 7) {
+        options.record_path = argv[7];
+    }
+    TournamentResult result = run_tournament(options);
+    cout << options.first_player << " vs " << options.second_player << ": " << result << endl;
+    return 0;
+}
+
+// chess sharded <player> <player> [games] [processes] [journal file]
+// Like chess tournament, but the games are played in worker processes. With
+// a journal file, running the same command again after a crash carries on
+// from the shards that were finished.
+int sharded_command(int argc, const char* argv[], const NnueNetwork* network) {
+    ShardedTournamentOptions options;
+    options.tournament.first_player = argv[2];
+    options.tournament.second_player = argv[3];
+    options.tournament.network = network;
+    if (argc > 4) {
+        options.tournament.games = stoi(argv[4]);
+    }
+    if (argc > 5) {
+        options.processes = stoi(argv[5]);
+    }
+    if (argc > 6) {
+        options.journal_path = argv[6];
+    }
+    TournamentResult result = run_sharded_tournament(options, cerr);
+    cout << options.tournament.first_player << " vs " << options.tournament.second_player << ": " << result << endl;
+    return 0;
+}
+
+// chess schedule <player> <player> [games] [threads]
+// Plays all the games at once on a GameScheduler (the players swap colors
+// every game) and prints the scheduler's counters every second until they
+// are done.
+int schedule_command(int argc, const char* argv[], const NnueNetwork* network) {
+    int num_games = argc > 4 ? stoi(argv[4]) : 1000;
+    int threads = argc > 5 ? stoi(argv[5]) : 0;
+    GameScheduler scheduler(threads);
+    std::atomic<int> first_wins(0), draws(0);
+    for (int game = 0; game < num_games; ++game) {
+        Team first_team = game % 2 == 0 ? WHITE : BLACK;
+        Team second_team = first_team == WHITE ? BLACK : WHITE;
+        unique_ptr<Player> first = make_player(argv[2], first_team, clock_seed() + 2 * game, network);
+        unique_ptr<Player> second = make_player(argv[3], second_team, clock_seed() + 2 * game + 1, network);
+        scheduler.start_game(
+            first_team == WHITE ? move(first) : move(second), first_team == WHITE ? move(second) : move(first), 1000,
+            [&, first_team](const GameSummary& summary) {
+                first_wins += summary.winner == first_team;
+                draws += summary.winner == NONE;
+            });
+    }
+    while (true) {
+        SchedulerStats stats = scheduler.stats();
+        cout << stats << endl;
+        if (stats.games_running == 0) {
+            break;
+        }
+        this_thread::sleep_for(chrono::seconds(1));
+    }
+    scheduler.wait();
+    cout << argv[2] << " vs " << argv[3] << ": " << first_wins << " wins, " << draws << " draws, "
+         << num_games - first_wins - draws << " losses" << endl;
+    return 0;
+}
+
+// chess sprt <player> <player> [elo0] [elo1] [threads]
+// Plays the two kinds of player against each other until a sequential
+// probability ratio test decides whether the first is elo1 stronger than
+// the second or at most elo0 stronger.
+int sprt_command(int argc, const char* argv[], const NnueNetwork* network) {
+    SprtOptions options;
+    options.match.first_player = argv[2];
+    options.match.second_player = argv[3];
+    options.match.network = network;
+    if (argc > 4) {
+        options.elo0 = stod(argv[4]);
+    }
+    if (argc > 5) {
+        options.elo1 = stod(argv[5]);
+    }
+    if (argc > 6) {
+        options.match.threads = stoi(argv[6]);
+    }
+    SprtResult result = run_sprt(options, cout);
+    if (result.decision == SPRT_CONTINUE) {
+        cout << "No decision after " << result.games.games() << " games" << endl;
+    }
+    return 0;
+}
+
+// chess analyze <positions file> [depth] [movetime ms] [threads]
+// Searches every position in the file (one per line, written like the
+// engine's position command) and prints the results in the same order.
+// With "-" for the file, it reads boards drawn like board.txt from stdin.
+int analyze_command(int argc, const char* argv[], const NnueNetwork* network) {
+    vector<string> positions;
+    if (string(argv[2]) == "-") {
+        BoardReader reader(cin);
+        Board board;
+        while (reader.read(board)) {
+            positions.push_back("fen " + board_to_notation(board));
+        }
+    }
+    else {
+        ifstream in(argv[2]);
+        if (!in) {
+            cout << "Could not open " << argv[2] << endl;
+            return 1;
+        }
+        string line;
+        while (getline(in, line)) {
+            if (!line.empty() && line.back() == '\r') {
+                line.pop_back();
+            }
+            if (!line.empty() && line[0] != '#') {
+                positions.push_back(line);
+            }
+        }
+    }
+    AnalysisOptions options;
+    options.network = network;
+    if (argc > 3) {
+        options.limits.depth = stoi(argv[3]);
+    }
+    if (argc > 4) {
+        options.limits.movetime = stol(argv[4]);
+    }
+    if (argc > 5) {
+        options.threads = stoi(argv[5]);
+    }
+    analyze_positions(positions, options, [](const AnalysisResult& result) {
+        cout << result << '\n';
+    });
+    cout.flush();
+    return 0;
+}
+
+// chess watch <player> <player> [milliseconds per move]
+// Shows a game between two kinds of player as it is played, redrawing only
+// the cells that change.
+int watch_command(int argc, const char* argv[], const NnueNetwork* network) {
+    unique_ptr<Player> white = make_player(argv[2], WHITE, clock_seed(), network);
+    unique_ptr<Player> black = make_player(argv[3], BLACK, clock_seed(), network);
+    int delay = argc > 4 ? stoi(argv[4]) : 200;
+    Board board;
+    BoardRenderer renderer;
+    for (int ply = 1; !board.game_over(); ++ply) {
+        vector<Move> moves = board.get_moves();
+        if (moves.empty()) {
+            break;
+        }
+        const Player& player = board.teams_turn() == WHITE ? *white : *black;
+        Move move = player.get_move(board, moves);
+        board.make_move(move);
+        renderer.write_changes(cout, board);
+        cout << "Move " << ply << ": " << player.name() << " played " << move << endl;
+        this_thread::sleep_for(chrono::milliseconds(delay));
+    }
+    if (board.winner() == NONE) {
+        cout << "Draw!" << endl;
+    }
+    else {
+        cout << team_name(board.winner()) << " won!" << endl;
+    }
+    return 0;
+}
+
+// chess games <record file>
+// Prints a summary of the games in a game record file.
+int games_command(int argc, const char* argv[]) {
+    GameArchive archive(argv[2]);
+    long games = 0, moves = 0, white_wins = 0, black_wins = 0;
+    for (GameView game : archive) {
+        ++games;
+        moves += game.num_moves();
+        if (game.winner() == WHITE) {
+            ++white_wins;
+        }
+        else if (game.winner() == BLACK) {
+            ++black_wins;
+        }
+    }
+    cout
+        << games << " games: White won " << white_wins << ", Black won " << black_wins
+        << ", " << games - white_wins - black_wins << " drawn, "
+        << (games ? static_cast<double>(moves) / games : 0) << " moves per game" << endl;
+    return 0;
+}
+
+int main(int argc, const char* argv[]) {
+    // chess --eval-params <parameters file> ... evaluates with tuned tables.
+    if (argc > 2 && string(argv[1]) == "--eval-params") {
+        set_eval_params(load_eval_params(argv[2]));
+        argc -= 2;
+        argv += 2;
+    }
+    // chess --pieces <definitions file> ... adds custom pieces (see
+    // defined_pieces.h) that boards can be read with.
+    if (argc > 2 && string(argv[1]) == "--pieces") {
+        vector<const DefinedPiece*> pieces = load_piece_definitions(argv[2]);
+        cerr << "Loaded " << pieces.size() / 2 << " custom pieces from " << argv[2] << endl;
+        argc -= 2;
+        argv += 2;
+    }
+    if (argc > 2 && string(argv[1]) == "train-nnue") {
+        return train_nnue_command(argc, argv);
+    }
+    if (argc > 2 && string(argv[1]) == "gen-data") {
+        return gen_data_command(argc, argv);
+    }
+    if (argc > 2 && string(argv[1]) == "games") {
+        return games_command(argc, argv);
+    }
+    if (argc > 3 && string(argv[1]) == "tune") {
+        return tune_command(argc, argv);
+    }
+    // chess --nnue <weights file> lets the AI players use a trained network.
+    NnueNetwork network;
+    const NnueNetwork* ai_network = nullptr;
+    if (argc > 2 && string(argv[1]) == "--nnue") {
+        network.load(argv[2]);
+        ai_network = &network;
+        argc -= 2;
+        argv += 2;
+    }
+
+    // chess engine talks the engine protocol (see engine.h) on stdin/stdout.
+    if (argc > 1 && string(argv[1]) == "engine") {
+        EngineServer server(cin, cout, ai_network);
+        server.run();
+        return 0;
+    }
+    if (argc > 3 && string(argv[1]) == "tournament") {
+        return tournament_command(argc, argv, ai_network);
+    }
+    if (argc > 2 && string(argv[1]) == "analyze") {
+        return analyze_command(argc, argv, ai_network);
+    }
+    if (argc > 3 && string(argv[1]) == "watch") {
+        return watch_command(argc, argv, ai_network);
+    }
+    if (argc > 3 && string(argv[1]) == "sharded") {
+        return sharded_command(argc, argv, ai_network);
+    }
+    if (argc > 3 && string(argv[1]) == "schedule") {
+        return schedule_command(argc, argv, ai_network);
+    }
+    if (argc > 3 && string(argv[1]) == "sprt") {
+        return sprt_command(argc, argv, ai_network);
+    }
+
+    AIPlayer black2(BLACK, ai_network);
+    HumanPlayer human(WHITE);
+
+    play_one_chess_game(human, black2);
+    cout << "AI search: " << black2.stats() << endl;
+
+    return 0;
 }
\ No newline at end of file
@@ -1,335 +1,653 @@
-#include <iostream>
-#include <map>
-#include <sstream>
-#include <stdexcept>
-#include <vector>
-#include "utf8_codepoint.h"
-#include "chess_pieces.h"
-#include "chess_board.h"
-
-using std::endl;
-using std::istream;
-using std::map;
-using std::ostream;
-using std::out_of_range;
-using std::stringstream;
-using std::vector;
-using std::string;
-using std::runtime_error;
-using std::ios;
-using std::getline;
-using std::cout;
-
-const char* team_name(Team team) {
-    switch (team) {
-    case WHITE:
-        return "White";
-    case BLACK:
-        return "Black";
-    case NONE:
-        return "None";
-    }
-    return "UNKNOWN";
-}
-
-
-bool Cell::operator==(Cell other) const {
-    return x == other.x && y == other.y;
-}
-
-bool Cell::operator!=(Cell other) const {
-    return !(*this == other);
-}
-
-bool Move::operator==(Move other) const {
-    return to == other.to && from == other.from;
-}
-
-bool Move::operator!=(Move other) const {
-    return !(*this == other);
-}
-
-
-ostream& operator<<(ostream& os, const Cell& cell) {
-    return os << static_cast<char>(cell.x + 'a') << cell.y + 1;
-}
-istream& operator>>(istream& is, Cell& cell) {
-    char x_plus_a;
-    int y_plus_1;
-    is >> x_plus_a >> y_plus_1;
-    cell.x = x_plus_a - 'a';
-    cell.y = y_plus_1 - 1;
-    return is;
-}
-
-ostream& operator<<(ostream& os, const Move& move) {
-    return os << move.from << move.to;
-}
-istream& operator>>(istream& is, Move& move) {
-    return is >> move.from >> move.to;
-}
-
-Board::Board() {
-    reset_board();
-}
-
-const ChessPiece& Board::operator[](Cell cell) const {
-    return *board2[cell.y][cell.x];
-}
-
-/*
-vector<vector<int>> ints;
-
-    for (int i = 0; i < 5; ++i)
-    {
-        vector<int> x;
-        ints.push_back(x);
-        for (int j = 0; j < 5; ++j)
-        {
-            ints[i].push_back(j);
-        }
-    }
-
-    for (int i = 0; i < 5; ++i)
-    {
-        for (int j = 0; j < 5; ++j)
-        {
-            cout << ints[i][j] << " ";
-        }
-        cout << endl;
-    }
-*/
-
-void Board::reset_board() {
-    for (int y = 0; y < 8; ++y) {
-        vector<const ChessPiece*> x;
-        board2.push_back(x);
-        for (int x = 0; x < 8; ++x) {
-            board2[y].push_back(& EMPTY_SPACE);
-        }
-    }
-
-    for (int x = 0; x < 8; ++x) {
-        board2[1][x] = &WHITE_PAWN;
-        board2[6][x] = &BLACK_PAWN;
-    }
-
-    board2[0][0] = &WHITE_ROOK;
-    board2[0][1] = &WHITE_KNIGHT;
-    board2[0][2] = &WHITE_BISHOP;
-    board2[0][3] = &WHITE_QUEEN;
-    board2[0][4] = &WHITE_KING;
-    board2[0][5] = &WHITE_BISHOP;
-    board2[0][6] = &WHITE_KNIGHT;
-    board2[0][7] = &WHITE_ROOK;
-
-    board2[7][0] = &BLACK_ROOK;
-    board2[7][1] = &BLACK_KNIGHT;
-    board2[7][2] = &BLACK_BISHOP;
-    board2[7][3] = &BLACK_QUEEN;
-    board2[7][4] = &BLACK_KING;
-    board2[7][5] = &BLACK_BISHOP;
-    board2[7][6] = &BLACK_KNIGHT;
-    board2[7][7] = &BLACK_ROOK;
-
-    current_teams_turn = WHITE;
-}
-
-vector<Move> Board::get_moves() const {
-    vector<Move> moves;
-    for (int y = 0; y < board2.size(); ++y) {
-        for (int x = 0; x < board2[y].size(); ++x) {
-            if (board2[y][x]->team == current_teams_turn) {
-                board2[y][x]->get_moves(*this, Cell(x, y), moves);
-            }
-        }
-    }
-    for (Move move : moves) {
-        if (!contains(move.to) || !contains(move.from)) {
-            stringstream err_msg;
-            err_msg << "Board::get_moves got a move that moves to or from a cell that is not on the board: " << move;
-            throw out_of_range(err_msg.str());
-        }
-    }
-    return moves;
-}
-
-// This function represents how most classical chess ALL_CHESS_PIECES would move.
-// This also allows us to add support for more complex "moves", like a pawn
-// getting to the end of the board and turning into a queen or some other type
-// of piece.
-// If we allow the chess piece that's moving to define the move, then we can
-// add really interesting custom ALL_CHESS_PIECES that are nothing like normal ALL_CHESS_PIECES!
-void Board::make_classical_chess_move(Move move) {
-    board2[move.to.y][move.to.x] = board2[move.from.y][move.from.x];
-    board2[move.from.y][move.from.x] = &EMPTY_SPACE;
-    current_teams_turn = current_teams_turn == WHITE ? BLACK : WHITE;
-}
-
-void Board::make_move(Move move) {
-    if (!contains(move.to) || !contains(move.from)) {
-        stringstream err_msg;
-        err_msg << "Board::make_move called with a move that moves to or from a cell that is not on the board: " << move;
-        throw out_of_range(err_msg.str());
-    }
-    board2[move.from.y][move.from.x]->make_move(*this, move);
-}
-
-bool Board::contains(Cell cell) const { // CHANGE THIS
-    return cell.x >= 0 && cell.x < board2[0].size() && cell.y >= 0 && cell.y < board2.size();
-}
-
-Team Board::winner() const {
-    bool found_white_king = false, found_black_king = false;
-    for (int y = 0; y < board2.size(); ++y) { //CHANGE THIS
-        for (int x = 0; x < board2[y].size(); ++x) {
-            if (board2[y][x] == &WHITE_KING) {
-                found_white_king = true;
-            }
-            else if (board2[y][x] == &BLACK_KING) {
-                found_black_king = true;
-            }
-        }
-    }
-    if (!found_white_king) {
-        return BLACK;
-    }
-    if (!found_black_king) {
-        return WHITE;
-    }
-    return NONE;
-}
-
-ostream& operator<<(ostream& os, const Board& board) {
-    os << "   ";
-        //abcdefgh\n"; // CHANGE THIS
-    for (int x = 0; x < board.board2[0].size(); ++x)
-    {
-        os << static_cast<char>('a' + x);
-    }
-    os << '\n';
-    for (int y = board.board2.size()-1; y >= 0; --y) {
-        if(y>=9)
-            os << (y + 1) << ' ';
-        else
-            os << ' ' << (y + 1) << ' ';
-
-
-        for (int x = 0; x < board.board2[y].size(); ++x) {
-            os << board[Cell(x, y)];
-        }
-       // if (y >= 10)
-        //    os << y + 1 << '\n';
-       // else
-           os << ' ' << (y + 1) << '\n';
-    }
-    os << "   ";
-    for (int x = 0; x < board.board2[0].size(); ++x)
-    {
-        os << static_cast<char>('a' + x);
-    }
-    os << "\n";
-    return os;
-}
-
-
-/*
-   abcdefg     h
- 8 ♜♞♝♛♚♝♞♜ 8
- 7 ♟♟♟♟♟♟♟♟ 7
- 6 ........ 6
- 5 ........ 5
- 4 ........ 4
- 3 ........ 3
- 2 ♙♙♙♙♙♙♙♙ 2
- 1 ♖♘♗♕♔♗♘♖ 1
-   abcdefgh
-
-
-*/
-
-/*
-
-   ab
- 4 ♛♙ 4
- 3 .. 3
- 2 ♟. 2
- 1 ♕♔ 1
-   ab
-
-*/
-
-istream& operator>>(istream& is, Board& board)
-{
-    string s;
-    stringstream st;
-    UTF8CodePoint utf;
-
-
-
-
-    board.board2.clear();
-
-    is.seekg(0, ios::beg);
-
-    char c;
-    int x_max = 0; // number of columns
-    int y_max = 0; // number of rows
-
-    is.seekg(3, ios::cur);
-    is.get(c);
-
-    while (c != '\n')
-    {
-        is.get(c);
-        ++x_max;
-    }
-
-    // now count number of rows by counting frequency of '\n'
-
-    is.seekg(0, ios::beg);
-
-    getline(is, s);
-
-    while (is.peek() != EOF)
-    {
-        is.get(c);
-        if (c == '\n')
-            ++y_max;
-    }
-    y_max = y_max - 1; // subtract one since it will also read \n of the last line of the file, which has the column labels abcdefg...
-
-
-
-    is.seekg(0, ios::beg);
-    getline(is, s);
-
-    for (int i = 0; i < y_max; ++i)
-    {
-        vector<const ChessPiece*> x;
-        board.board2.push_back(x);
-        for (int j = 0; j < x_max; ++j)
-        {
-            board.board2[i].push_back(&EMPTY_SPACE);
-        }
-    }
-
-    is.seekg(0, ios::beg);
-    getline(is, s);
-
-    for (int i = y_max - 1; i >= 0; --i)
-    {
-        is.seekg(3, ios::cur);
-
-        for (int j = 0; j < x_max; ++j)
-        {
-            is >> utf;
-            board.board2[i][j] = (ALL_CHESS_PIECES.at(utf));
-
-        }
-        getline(is, s);
-
-    }
-    return is;
-}
-
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+#include "utf8_codepoint.h"
+#include "chess_pieces.h"
+#include "chess_board.h"
+#include "board_reader.h"
+#include "board_renderer.h"
+#include "chess_eval.h"
+#include "chess_nnue.h"
+#include "trace.h"
+
+using std::endl;
+using std::istream;
+using std::map;
+using std::ostream;
+using std::out_of_range;
+using std::stringstream;
+using std::vector;
+using std::string;
+using std::runtime_error;
+using std::ios;
+using std::getline;
+using std::cout;
+
+const char* team_name(Team team) {
+    switch (team) {
+    case WHITE:
+        return "White";
+    case BLACK:
+        return "Black";
+    case NONE:
+        return "None";
+    }
+    return "UNKNOWN";
+}
+
+
+bool Cell::operator==(Cell other) const {
+    return x == other.x && y == other.y;
+}
+
+bool Cell::operator!=(Cell other) const {
+    return !(*this == other);
+}
+
+bool Move::operator==(Move other) const {
+    return to == other.to && from == other.from;
+}
+
+bool Move::operator!=(Move other) const {
+    return !(*this == other);
+}
+
+
+ostream& operator<<(ostream& os, const Cell& cell) {
+    return os << static_cast<char>(cell.x + 'a') << cell.y + 1;
+}
+istream& operator>>(istream& is, Cell& cell) {
+    char x_plus_a;
+    int y_plus_1;
+    is >> x_plus_a >> y_plus_1;
+    cell.x = x_plus_a - 'a';
+    cell.y = y_plus_1 - 1;
+    return is;
+}
+
+ostream& operator<<(ostream& os, const Move& move) {
+    return os << move.from << move.to;
+}
+istream& operator>>(istream& is, Move& move) {
+    return is >> move.from >> move.to;
+}
+
+Board::Board() : capture_free_plies(0), draw_plies(DEFAULT_NO_CAPTURE_LIMIT), network(nullptr), attacks_tracked(false) {
+    reset_board();
+}
+
+const ChessPiece& Board::operator[](Cell cell) const {
+    return *board2[cell.y][cell.x];
+}
+
+int Board::width() const {
+    return board2.empty() ? 0 : static_cast<int>(board2[0].size());
+}
+
+int Board::height() const {
+    return static_cast<int>(board2.size());
+}
+
+Team Board::teams_turn() const {
+    return current_teams_turn;
+}
+
+void Board::set_teams_turn(Team team) {
+    current_teams_turn = team;
+}
+
+const uint8_t* Board::piece_codes() const {
+    return codes.data();
+}
+
+/*
+vector<vector<int>> ints;
+
+    for (int i = 0; i < 5; ++i)
+    {
+        vector<int> x;
+        ints.push_back(x);
+        for (int j = 0; j < 5; ++j)
+        {
+            ints[i].push_back(j);
+        }
+    }
+
+    for (int i = 0; i < 5; ++i)
+    {
+        for (int j = 0; j < 5; ++j)
+        {
+            cout << ints[i][j] << " ";
+        }
+        cout << endl;
+    }
+*/
+
+// A random looking 64 bit number for every input (splitmix64).
+static uint64_t mix_bits(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+// The Zobrist key of the piece with this code standing on cell_index. Keys
+// are computed instead of looked up so boards of any size can be hashed.
+static uint64_t zobrist_key(int code, int cell_index) {
+    if (code_type(code) == EMPTY) {
+        return 0;
+    }
+    return mix_bits(static_cast<uint64_t>(cell_index) * MAX_PIECE_CODES + code);
+}
+
+static const uint64_t BLACK_TO_MOVE_KEY = mix_bits(0xB1ACC);
+
+void Board::resize(int width, int height) {
+    // Refill the rows in place, so a board loaded again and again with
+    // positions of the same size doesn't allocate.
+    board2.resize(height);
+    for (vector<const ChessPiece*>& row : board2) {
+        row.assign(width, &EMPTY_SPACE);
+    }
+    codes.assign(width * height, EMPTY_SPACE.code);
+    for (int team = 0; team < 3; ++team) {
+        material_sums[team] = 0;
+        positional_sums[team] = 0;
+    }
+    // Start from a key for the board's size, so an empty 8x8 board and an
+    // empty 2x4 board don't look the same.
+    piece_hash = structure_hash = mix_bits(static_cast<uint64_t>(width) << 32 | height);
+    rebuild_attacks();
+    changes.clear();
+    move_records.clear();
+    capture_free_plies = 0;
+    if (network) {
+        network->refresh(*this, nnue_accumulator.data());
+    }
+}
+
+void Board::set_piece(Cell cell, const ChessPiece& piece) {
+    if (!move_records.empty()) {
+        changes.push_back(CellChange{ cell, board2[cell.y][cell.x] });
+    }
+    place_piece(cell, piece);
+}
+
+void Board::place_piece(Cell cell, const ChessPiece& piece) {
+    const ChessPiece& before = *board2[cell.y][cell.x];
+    int square = pst_square(cell, width(), height());
+    material_sums[before.team] -= material_score(before.type);
+    positional_sums[before.team] -= positional_score(before.code, square);
+    material_sums[piece.team] += material_score(piece.type);
+    positional_sums[piece.team] += positional_score(piece.code, square);
+    if (network) {
+        network->update(nnue_accumulator.data(), before.code, piece.code, square);
+    }
+
+    int cell_index = cell.y * width() + cell.x;
+    uint64_t before_key = zobrist_key(before.code, cell_index);
+    uint64_t piece_key = zobrist_key(piece.code, cell_index);
+    piece_hash ^= before_key ^ piece_key;
+    if (is_pawn_structure_piece(before.type)) {
+        structure_hash ^= before_key;
+    }
+    if (is_pawn_structure_piece(piece.type)) {
+        structure_hash ^= piece_key;
+    }
+
+    board2[cell.y][cell.x] = &piece;
+    codes[cell_index] = piece.code;
+    if (attacks_tracked) {
+        update_attacks(cell_index, before);
+    }
+}
+
+void Board::update_attacks(int cell_index, const ChessPiece& before) {
+    const ChessPiece& piece = *board2[cell_index / width()][cell_index % width()];
+    // Take away the attacks of the piece that was here.
+    vector<uint16_t>& before_counts = attack_counts[before.team];
+    for (uint16_t attacked : attacks_from[cell_index]) {
+        --before_counts[attacked];
+    }
+    if (before.has_sliding_attacks()) {
+        for (uint16_t attacked : attacks_from[cell_index]) {
+            --sliding_attack_counts[attacked];
+        }
+        slider_cells.erase(std::find(slider_cells.begin(), slider_cells.end(), cell_index));
+    }
+    attacks_from[cell_index].clear();
+    if (before.type == KING) {
+        vector<int>& kings = king_cells[before.team];
+        kings.erase(std::find(kings.begin(), kings.end(), cell_index));
+    }
+    // Filling or emptying a cell moves where sliding attacks through it stop.
+    if ((before.type == EMPTY) != (piece.type == EMPTY) && sliding_attack_counts[cell_index] != 0) {
+        for (int slider : slider_cells) {
+            const vector<uint16_t>& attacks = attacks_from[slider];
+            if (std::find(attacks.begin(), attacks.end(), cell_index) != attacks.end()) {
+                remove_attacks(slider);
+                add_attacks(slider);
+            }
+        }
+    }
+    add_attacks(cell_index);
+    if (piece.has_sliding_attacks()) {
+        slider_cells.push_back(cell_index);
+    }
+    if (piece.type == KING) {
+        king_cells[piece.team].push_back(cell_index);
+    }
+}
+
+void Board::rebuild_attacks() {
+    int num_cells = attacks_tracked ? width() * height() : 0;
+    for (int team = 0; team < 3; ++team) {
+        attack_counts[team].assign(num_cells, 0);
+        king_cells[team].clear();
+    }
+    sliding_attack_counts.assign(num_cells, 0);
+    attacks_from.resize(num_cells);
+    slider_cells.clear();
+    for (int cell_index = 0; cell_index < num_cells; ++cell_index) {
+        attacks_from[cell_index].clear();
+    }
+    for (int cell_index = 0; cell_index < num_cells; ++cell_index) {
+        const ChessPiece& piece = *board2[cell_index / width()][cell_index % width()];
+        add_attacks(cell_index);
+        if (piece.has_sliding_attacks()) {
+            slider_cells.push_back(cell_index);
+        }
+        if (piece.type == KING) {
+            king_cells[piece.team].push_back(cell_index);
+        }
+    }
+}
+
+void Board::set_attack_tracking(bool track) {
+    attacks_tracked = track;
+    rebuild_attacks();
+}
+
+bool Board::attack_tracking() const {
+    return attacks_tracked;
+}
+
+void Board::add_attacks(int cell_index) {
+    int width = this->width();
+    const ChessPiece& piece = *board2[cell_index / width][cell_index % width];
+    attack_scratch.clear();
+    piece.get_attacks(*this, Cell(cell_index % width, cell_index / width), attack_scratch);
+    vector<uint16_t>& attacks = attacks_from[cell_index];
+    vector<uint16_t>& counts = attack_counts[piece.team];
+    for (Cell attacked : attack_scratch) {
+        uint16_t attacked_index = static_cast<uint16_t>(attacked.y * width + attacked.x);
+        attacks.push_back(attacked_index);
+        ++counts[attacked_index];
+    }
+    if (piece.has_sliding_attacks()) {
+        for (uint16_t attacked : attacks) {
+            ++sliding_attack_counts[attacked];
+        }
+    }
+}
+
+void Board::remove_attacks(int cell_index) {
+    const ChessPiece& piece = *board2[cell_index / width()][cell_index % width()];
+    vector<uint16_t>& counts = attack_counts[piece.team];
+    for (uint16_t attacked : attacks_from[cell_index]) {
+        --counts[attacked];
+    }
+    if (piece.has_sliding_attacks()) {
+        for (uint16_t attacked : attacks_from[cell_index]) {
+            --sliding_attack_counts[attacked];
+        }
+    }
+    attacks_from[cell_index].clear();
+}
+
+void Board::clear(int width, int height) {
+    resize(width, height);
+    current_teams_turn = WHITE;
+}
+
+void Board::reset_board() {
+    resize(8, 8);
+
+    for (int x = 0; x < 8; ++x) {
+        set_piece(Cell(x, 1), WHITE_PAWN);
+        set_piece(Cell(x, 6), BLACK_PAWN);
+    }
+
+    set_piece(Cell(0, 0), WHITE_ROOK);
+    set_piece(Cell(1, 0), WHITE_KNIGHT);
+    set_piece(Cell(2, 0), WHITE_BISHOP);
+    set_piece(Cell(3, 0), WHITE_QUEEN);
+    set_piece(Cell(4, 0), WHITE_KING);
+    set_piece(Cell(5, 0), WHITE_BISHOP);
+    set_piece(Cell(6, 0), WHITE_KNIGHT);
+    set_piece(Cell(7, 0), WHITE_ROOK);
+
+    set_piece(Cell(0, 7), BLACK_ROOK);
+    set_piece(Cell(1, 7), BLACK_KNIGHT);
+    set_piece(Cell(2, 7), BLACK_BISHOP);
+    set_piece(Cell(3, 7), BLACK_QUEEN);
+    set_piece(Cell(4, 7), BLACK_KING);
+    set_piece(Cell(5, 7), BLACK_BISHOP);
+    set_piece(Cell(6, 7), BLACK_KNIGHT);
+    set_piece(Cell(7, 7), BLACK_ROOK);
+
+    current_teams_turn = WHITE;
+}
+
+// The moves of kind (a MoveKind, see chess_pieces.h) of the pieces on cells
+// the predicate picks, checked to stay on the board.
+template <typename UsePiece>
+static vector<Move> generate_moves(const Board& board, MoveKind kind, UsePiece use_piece) {
+    vector<Move> moves;
+    for (int y = 0; y < board.height(); ++y) {
+        for (int x = 0; x < board.width(); ++x) {
+            const ChessPiece& piece = board[Cell(x, y)];
+            if (use_piece(piece, y * board.width() + x)) {
+                if (kind == ALL_MOVES) {
+                    piece.get_moves(board, Cell(x, y), moves);
+                }
+                else {
+                    piece.get_moves_of_kind(board, Cell(x, y), kind, moves);
+                }
+            }
+        }
+    }
+    for (Move move : moves) {
+        if (!board.contains(move.to) || !board.contains(move.from)) {
+            stringstream err_msg;
+            err_msg << "Board::get_moves got a move that moves to or from a cell that is not on the board: " << move;
+            throw out_of_range(err_msg.str());
+        }
+    }
+    return moves;
+}
+
+vector<Move> Board::get_moves() const {
+    TRACE_ZONE("Board::get_moves");
+    return generate_moves(*this, ALL_MOVES, [this](const ChessPiece& piece, int) {
+        return piece.team == current_teams_turn;
+    });
+}
+
+vector<Move> Board::get_captures() const {
+    return generate_moves(*this, CAPTURES, [this](const ChessPiece& piece, int) {
+        return piece.team == current_teams_turn;
+    });
+}
+
+vector<Move> Board::get_quiet_moves() const {
+    return generate_moves(*this, QUIET_MOVES, [this](const ChessPiece& piece, int) {
+        return piece.team == current_teams_turn;
+    });
+}
+
+vector<Move> Board::get_king_captures() const {
+    Team other_team = current_teams_turn == WHITE ? BLACK : WHITE;
+    vector<int> kings;
+    if (attacks_tracked) {
+        // Only the attacked kings, and only the pieces attacking them.
+        for (int king : king_cells[other_team]) {
+            if (attack_counts[current_teams_turn][king] != 0) {
+                kings.push_back(king);
+            }
+        }
+    }
+    else {
+        for (int cell_index = 0; cell_index < static_cast<int>(codes.size()); ++cell_index) {
+            int code = codes[cell_index];
+            if (code_type(code) == KING && code_team(code) == other_team) {
+                kings.push_back(cell_index);
+            }
+        }
+    }
+    if (kings.empty()) {
+        return vector<Move>();
+    }
+    vector<Move> captures = generate_moves(*this, CAPTURES, [&](const ChessPiece& piece, int cell_index) {
+        if (piece.team != current_teams_turn) {
+            return false;
+        }
+        if (!attacks_tracked) {
+            return true;
+        }
+        const vector<uint16_t>& attacks = attacks_from[cell_index];
+        for (int king : kings) {
+            if (std::find(attacks.begin(), attacks.end(), king) != attacks.end()) {
+                return true;
+            }
+        }
+        return false;
+    });
+    int width = this->width();
+    captures.erase(std::remove_if(captures.begin(), captures.end(), [&](Move move) {
+        return std::find(kings.begin(), kings.end(), move.to.y * width + move.to.x) == kings.end();
+    }), captures.end());
+    return captures;
+}
+
+vector<Move> Board::get_legal_moves() {
+    bool was_tracked = attacks_tracked;
+    if (!was_tracked) {
+        set_attack_tracking(true);
+    }
+    Team mover = current_teams_turn;
+    vector<Move> moves = get_moves();
+    vector<Move> legal_moves;
+    for (Move move : moves) {
+        make_move(move);
+        if (!in_check(mover)) {
+            legal_moves.push_back(move);
+        }
+        undo_move();
+    }
+    if (!was_tracked) {
+        set_attack_tracking(false);
+    }
+    return legal_moves;
+}
+
+// This function represents how most classical chess ALL_CHESS_PIECES would move.
+// This also allows us to add support for more complex "moves", like a pawn
+// getting to the end of the board and turning into a queen or some other type
+// of piece.
+// If we allow the chess piece that's moving to define the move, then we can
+// add really interesting custom ALL_CHESS_PIECES that are nothing like normal ALL_CHESS_PIECES!
+void Board::make_classical_chess_move(Move move) {
+    set_piece(move.to, (*this)[move.from]);
+    set_piece(move.from, EMPTY_SPACE);
+    current_teams_turn = current_teams_turn == WHITE ? BLACK : WHITE;
+}
+
+void Board::make_move(Move move) {
+    TRACE_ZONE("Board::make_move");
+    if (!contains(move.to) || !contains(move.from)) {
+        stringstream err_msg;
+        err_msg << "Board::make_move called with a move that moves to or from a cell that is not on the board: " << move;
+        throw out_of_range(err_msg.str());
+    }
+    move_records.push_back(MoveRecord{ changes.size(), current_teams_turn, hash(), capture_free_plies });
+    bool capture = board2[move.to.y][move.to.x]->type != EMPTY;
+    board2[move.from.y][move.from.x]->make_move(*this, move);
+    capture_free_plies = capture ? 0 : capture_free_plies + 1;
+}
+
+void Board::undo_move() {
+    if (move_records.empty()) {
+        throw runtime_error("Board::undo_move called with no moves to undo");
+    }
+    MoveRecord record = move_records.back();
+    move_records.pop_back();
+    // Put the cells back in the reverse order they were changed in.
+    while (changes.size() > record.first_change) {
+        place_piece(changes.back().cell, *changes.back().before);
+        changes.pop_back();
+    }
+    current_teams_turn = record.teams_turn;
+    capture_free_plies = record.plies_since_capture;
+}
+
+bool Board::contains(Cell cell) const { // CHANGE THIS
+    return cell.x >= 0 && cell.x < board2[0].size() && cell.y >= 0 && cell.y < board2.size();
+}
+
+bool Board::is_attacked(Cell cell, Team team) const {
+    return attack_counts[team][cell.y * width() + cell.x] != 0;
+}
+
+int Board::attack_count(Cell cell, Team team) const {
+    return attack_counts[team][cell.y * width() + cell.x];
+}
+
+bool Board::in_check(Team team) const {
+    const vector<uint16_t>& enemy_attacks = attack_counts[team == WHITE ? BLACK : WHITE];
+    for (int king : king_cells[team]) {
+        if (enemy_attacks[king] != 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+Team Board::winner() const {
+    // Custom pieces of the king type are kings too.
+    bool found_kings[3] = { false, false, false };
+    for (uint8_t code : codes) {
+        if (code_type(code) == KING) {
+            found_kings[code_team(code)] = true;
+        }
+    }
+    if (!found_kings[WHITE]) {
+        return BLACK;
+    }
+    if (!found_kings[BLACK]) {
+        return WHITE;
+    }
+    return NONE;
+}
+
+int Board::plies_since_capture() const {
+    return capture_free_plies;
+}
+
+int Board::repetitions() const {
+    // Only positions since the last capture can be the same as this one, and
+    // only every other one has the same player to move.
+    uint64_t key = hash();
+    int count = 1;
+    int plies = std::min(capture_free_plies, static_cast<int>(move_records.size()));
+    for (int back = 2; back <= plies; back += 2) {
+        if (move_records[move_records.size() - back].position_hash == key) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+void Board::set_no_capture_limit(int plies) {
+    draw_plies = plies;
+}
+
+int Board::no_capture_limit() const {
+    return draw_plies;
+}
+
+bool Board::is_draw() const {
+    // The draw rules are checked first, since they're cheaper than winner.
+    bool drawn = (draw_plies > 0 && capture_free_plies >= draw_plies) || repetitions() >= 3;
+    return drawn && winner() == NONE;
+}
+
+bool Board::game_over() const {
+    return winner() != NONE || is_draw();
+}
+
+int Board::material(Team team) const {
+    return material_sums[team];
+}
+
+int Board::positional(Team team) const {
+    return positional_sums[team];
+}
+
+int Board::incremental_eval() const {
+    return material_sums[WHITE] + positional_sums[WHITE]
+        - material_sums[BLACK] - positional_sums[BLACK];
+}
+
+uint64_t Board::hash() const {
+    return current_teams_turn == BLACK ? piece_hash ^ BLACK_TO_MOVE_KEY : piece_hash;
+}
+
+uint64_t Board::pawn_hash() const {
+    return structure_hash;
+}
+
+void Board::set_network(const NnueNetwork* network) {
+    this->network = network;
+    if (network) {
+        nnue_accumulator.resize(NNUE_ACCUMULATOR_SIZE);
+        network->refresh(*this, nnue_accumulator.data());
+    }
+    else {
+        nnue_accumulator.clear();
+    }
+}
+
+int Board::nnue_eval() const {
+    int score = network->evaluate(nnue_accumulator.data(), current_teams_turn);
+    return current_teams_turn == WHITE ? score : -score;
+}
+
+ostream& operator<<(ostream& os, const Board& board) {
+    // Each thread keeps one renderer, so printing reuses its buffers.
+    thread_local BoardRenderer renderer;
+    renderer.write(os, board);
+    return os;
+}
+
+
+/*
+   abcdefg     h
+ 8 ♜♞♝♛♚♝♞♜ 8
+ 7 ♟♟♟♟♟♟♟♟ 7
+ 6 ........ 6
+ 5 ........ 5
+ 4 ........ 4
+ 3 ........ 3
+ 2 ♙♙♙♙♙♙♙♙ 2
+ 1 ♖♘♗♕♔♗♘♖ 1
+   abcdefgh
+
+
+*/
+
+/*
+
+   ab
+ 4 ♛♙ 4
+ 3 .. 3
+ 2 ♟. 2
+ 1 ♕♔ 1
+   ab
+
+*/
+
+istream& operator>>(istream& is, Board& board)
+{
+    // Reads the board starting at the stream's current position, without
+    // seeking, so this works on pipes too.
+    BoardReader reader(is);
+    if (!reader.read(board)) {
+        is.setstate(ios::failbit);
+    }
+    return is;
+}
+
@@ -1,81 +1,231 @@
-#ifndef _CHESS_BOARD_H_
-#define _CHESS_BOARD_H_
-
-#include <iostream>
-#include <map>
-#include <vector>
-
-#include "utf8_codepoint.h"
-
-using std::istream;
-using std::map;
-using std::ostream;
-using std::vector;
-
-class ChessPiece;
-
-enum Team {
-	NONE,
-	BLACK,
-	WHITE
-};
-
-const char* team_name(Team team);
-
-// A place on the board
-struct Cell {
-	int x;  // file -  1  (so we start at 0 instead of 1)
-	int y;  // rank - 'a' (so we start at 0 instead of 'a')
-
-	Cell() = default;
-	Cell(int x, int y) : x(x), y(y) {}
-	bool operator==(Cell other) const;
-	bool operator!=(Cell other) const;
-};
-
-ostream& operator<<(ostream& os, const Cell& cell);
-istream& operator>>(istream& is, Cell& cell);
-
-struct Move {
-	Cell from, to;
-
-	Move() = default;
-	Move(Cell from, Cell to) : from(from), to(to) {}
-	bool operator==(Move other) const;
-	bool operator!=(Move other) const;
-};
-
-ostream& operator<<(ostream& os, const Move& move);
-istream& operator>>(istream& is, Move& move);
-
-class Board {
-	vector<vector<const ChessPiece*>> board2;
-	Team current_teams_turn;
-
-public:
-	Board();
-	const ChessPiece& operator[](Cell cell) const;
-	// Reset all the pieces on the board (as if you're starting a new game).
-	void reset_board();
-	vector<Move> get_moves() const;
-	// This function represents how most classical chess pieces would move.
-	// This also allows us to add support for more complex "moves", like a pawn
-	// getting to the end of the board and turning into a queen or some other type
-	// of piece.
-	// If we allow the chess piece that's moving to define the move, then we can
-	// add really interesting custom pieces that are nothing like normal pieces!
-	void make_classical_chess_move(Move move);
-	// Makes a move on the board by calling make_move on the piece at move.from.
-	void make_move(Move move);
-	// Returns true if cell is on the board
-	bool contains(Cell cell) const;
-	// Returns the winner or NONE if there is no winner (yet).
-	Team winner() const;
-
-	friend ostream& operator<<(ostream& os, const Board& board);
-
-	friend istream& operator>>(istream& is,  Board& board);
-
-};
-
-#endif  // _CHESS_BOARD_H_#pragma once
+#ifndef _CHESS_BOARD_H_
+#define _CHESS_BOARD_H_
+
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <vector>
+
+#include "utf8_codepoint.h"
+
+using std::istream;
+using std::map;
+using std::ostream;
+using std::vector;
+
+class ChessPiece;
+class NnueNetwork;
+
+enum Team {
+	NONE,
+	BLACK,
+	WHITE
+};
+
+const char* team_name(Team team);
+
+// A game is drawn once this many plies (half moves) go by without a capture,
+// unless the board is given another limit (see Board::set_no_capture_limit).
+const int DEFAULT_NO_CAPTURE_LIMIT = 100;
+
+// A place on the board
+struct Cell {
+	int x;  // file -  1  (so we start at 0 instead of 1)
+	int y;  // rank - 'a' (so we start at 0 instead of 'a')
+
+	Cell() = default;
+	Cell(int x, int y) : x(x), y(y) {}
+	bool operator==(Cell other) const;
+	bool operator!=(Cell other) const;
+};
+
+ostream& operator<<(ostream& os, const Cell& cell);
+istream& operator>>(istream& is, Cell& cell);
+
+struct Move {
+	Cell from, to;
+
+	Move() = default;
+	Move(Cell from, Cell to) : from(from), to(to) {}
+	bool operator==(Move other) const;
+	bool operator!=(Move other) const;
+};
+
+ostream& operator<<(ostream& os, const Move& move);
+istream& operator>>(istream& is, Move& move);
+
+class Board {
+	vector<vector<const ChessPiece*>> board2;
+	// The ChessPiece::code of every cell, row by row starting at a1. This mirrors
+	// board2 so table-driven code (like evaluation) can scan the board as bytes.
+	vector<uint8_t> codes;
+	Team current_teams_turn;
+
+	// Material and piece-square sums of each team (indexed by Team), kept up
+	// to date by set_piece so evaluating a position doesn't need a board scan.
+	int material_sums[3];
+	int positional_sums[3];
+
+	// Zobrist hashes of every piece on the board, and of just the pawn
+	// structure pieces (see is_pawn_structure_piece in chess_eval.h).
+	uint64_t piece_hash;
+	uint64_t structure_hash;
+
+	// What undo_move needs to take back a move: every cell that set_piece
+	// changed while the move was being made, and whose turn it was before.
+	// The hash of the position before the move is kept too, so repeated
+	// positions can be found without replaying the game.
+	struct CellChange {
+		Cell cell;
+		const ChessPiece* before;
+	};
+	struct MoveRecord {
+		size_t first_change;
+		Team teams_turn;
+		uint64_t position_hash;
+		int plies_since_capture;
+	};
+	vector<CellChange> changes;
+	vector<MoveRecord> move_records;
+	// Plies since the last capture or since the board was set up, and how
+	// many of them end the game in a draw (0 for no limit).
+	int capture_free_plies;
+	int draw_plies;
+
+	// The network evaluating this board, if any, and its first layer
+	// accumulators (see chess_nnue.h), updated by set_piece like the sums.
+	const NnueNetwork* network;
+	vector<int16_t> nnue_accumulator;
+
+	// Attack maps (see set_attack_tracking), kept up to date by set_piece
+	// while tracked: how many times each team attacks every cell (indexed by
+	// Team, then like codes), the cells (as indexes) the piece on each cell
+	// attacks, how many sliding attacks reach each cell, and the cells
+	// holding pieces with sliding attacks or kings.
+	bool attacks_tracked;
+	vector<uint16_t> attack_counts[3];
+	vector<vector<uint16_t>> attacks_from;
+	vector<uint16_t> sliding_attack_counts;
+	vector<int> slider_cells;
+	vector<int> king_cells[3];
+	// Where get_attacks puts its cells before they are counted.
+	vector<Cell> attack_scratch;
+
+	// Adds or takes away the attacks of the piece on cell_index.
+	void add_attacks(int cell_index);
+	void remove_attacks(int cell_index);
+	// Updates the attack maps for before being replaced on cell_index.
+	void update_attacks(int cell_index, const ChessPiece& before);
+	// Empties the attack maps, and fills them in if attacks are tracked.
+	void rebuild_attacks();
+
+	// Makes the board width x height and fills it with EMPTY_SPACE.
+	void resize(int width, int height);
+	// set_piece without remembering the change for undo_move.
+	void place_piece(Cell cell, const ChessPiece& piece);
+
+public:
+	Board();
+	const ChessPiece& operator[](Cell cell) const;
+	int width() const;
+	int height() const;
+	// Whose turn it is.
+	Team teams_turn() const;
+	void set_teams_turn(Team team);
+	// The piece code of every cell, indexed by y * width() + x.
+	const uint8_t* piece_codes() const;
+	// Puts piece on cell, replacing whatever was there.
+	void set_piece(Cell cell, const ChessPiece& piece);
+	// Reset all the pieces on the board (as if you're starting a new game).
+	void reset_board();
+	// Makes the board width x height with no pieces on it, White to move.
+	void clear(int width, int height);
+	vector<Move> get_moves() const;
+	// Just the moves that capture a piece, or just the ones that don't. The
+	// pieces only generate the moves asked for (see
+	// ChessPiece::get_moves_of_kind), so these are cheaper than filtering
+	// get_moves.
+	vector<Move> get_captures() const;
+	vector<Move> get_quiet_moves() const;
+	// The captures of the other team's kings. Nothing is generated if the
+	// other team has no king, or, while attacks are tracked, if no king is
+	// attacked, and then only the attackers' captures are generated.
+	vector<Move> get_king_captures() const;
+	// The moves that don't leave any of the mover's kings attacked. The
+	// rules let a king be left in check (the game ends when one is
+	// captured), so this is for players and searches that want to know.
+	// Tracks attacks while it runs if they aren't tracked already.
+	vector<Move> get_legal_moves();
+	// This function represents how most classical chess pieces would move.
+	// This also allows us to add support for more complex "moves", like a pawn
+	// getting to the end of the board and turning into a queen or some other type
+	// of piece.
+	// If we allow the chess piece that's moving to define the move, then we can
+	// add really interesting custom pieces that are nothing like normal pieces!
+	void make_classical_chess_move(Move move);
+	// Makes a move on the board by calling make_move on the piece at move.from.
+	void make_move(Move move);
+	// Takes back the last move made with make_move, whatever the piece did.
+	void undo_move();
+	// Returns true if cell is on the board
+	bool contains(Cell cell) const;
+	// Makes this board keep attack maps up to date as pieces move, so
+	// is_attacked, attack_count and in_check can be used without generating
+	// any moves. Like the network accumulators this costs time on every
+	// move, so searches that never ask about attacks leave it off.
+	void set_attack_tracking(bool track);
+	bool attack_tracking() const;
+	// True if any of team's pieces attacks cell. Only valid while attacks
+	// are tracked, like the functions below.
+	bool is_attacked(Cell cell, Team team) const;
+	// How many times team's pieces attack cell.
+	int attack_count(Cell cell, Team team) const;
+	// True if any of team's kings is attacked by the other team.
+	bool in_check(Team team) const;
+	// Returns the winner or NONE if there is no winner (yet, or because the
+	// game is drawn; see is_draw). A team has lost once it has no pieces of
+	// the king type left.
+	Team winner() const;
+	// How many plies have gone by since the last capture (or since the board
+	// was set up).
+	int plies_since_capture() const;
+	// How many times the current position (the pieces and whose turn it is)
+	// has come up since the last capture, counting this time. Positions are
+	// compared by hash.
+	int repetitions() const;
+	// Draws the game once plies plies go by without a capture, or never if
+	// plies is 0. Boards start with DEFAULT_NO_CAPTURE_LIMIT.
+	void set_no_capture_limit(int plies);
+	int no_capture_limit() const;
+	// True if nobody has won but the game is drawn: the position has come up
+	// for the third time, or the no-capture limit has been reached.
+	bool is_draw() const;
+	// True once someone has won or the game is drawn, so the game is over.
+	bool game_over() const;
+	// The sum of the material values of team's pieces.
+	int material(Team team) const;
+	// The sum of the piece-square bonuses of team's pieces.
+	int positional(Team team) const;
+	// The same value as evaluate(board) in chess_eval.h, without looking at
+	// the cells: positive if White is ahead and negative if Black is ahead.
+	int incremental_eval() const;
+	// A 64 bit hash of the position (pieces and whose turn it is), updated as
+	// pieces move. Equal positions always have equal hashes.
+	uint64_t hash() const;
+	// A hash of only the pawns, BackBenchers and Mice on the board.
+	uint64_t pawn_hash() const;
+	// Makes this board keep network's accumulators up to date as pieces move,
+	// so nnue_eval can be used. Pass nullptr to stop. network has to outlive
+	// the board (and any copies of it).
+	void set_network(const NnueNetwork* network);
+	// The network's evaluation of the board: positive if White is ahead and
+	// negative if Black is ahead. Only valid after set_network.
+	int nnue_eval() const;
+
+	friend ostream& operator<<(ostream& os, const Board& board);
+
+	friend istream& operator>>(istream& is,  Board& board);
+
+};
+
+#endif  // _CHESS_BOARD_H_#pragma once
@@ -0,0 +1,488 @@
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "chess_board.h"
+#include "chess_pieces.h"
+#include "chess_eval.h"
+
+using std::getline;
+using std::ifstream;
+using std::ofstream;
+using std::runtime_error;
+using std::setw;
+using std::string;
+using std::vector;
+
+// The tables below are written the way White sees the board: rank 8 is the
+// first row and rank 1 is the last row. make_default_eval_params flips them
+// so that square 0 is a1.
+static const int DIAGRAM_PIECE_SQUARE[NUM_PIECE_TYPES][PST_SQUARES] = {
+    // EMPTY
+    {0},
+    // PAWN
+    {
+         0,   0,   0,   0,   0,   0,   0,   0,
+        50,  50,  50,  50,  50,  50,  50,  50,
+        10,  10,  20,  30,  30,  20,  10,  10,
+         5,   5,  10,  25,  25,  10,   5,   5,
+         0,   0,   0,  20,  20,   0,   0,   0,
+         5,  -5, -10,   0,   0, -10,  -5,   5,
+         5,  10,  10, -20, -20,  10,  10,   5,
+         0,   0,   0,   0,   0,   0,   0,   0,
+    },
+    // KNIGHT
+    {
+       -50, -40, -30, -30, -30, -30, -40, -50,
+       -40, -20,   0,   0,   0,   0, -20, -40,
+       -30,   0,  10,  15,  15,  10,   0, -30,
+       -30,   5,  15,  20,  20,  15,   5, -30,
+       -30,   0,  15,  20,  20,  15,   0, -30,
+       -30,   5,  10,  15,  15,  10,   5, -30,
+       -40, -20,   0,   5,   5,   0, -20, -40,
+       -50, -40, -30, -30, -30, -30, -40, -50,
+    },
+    // BISHOP
+    {
+       -20, -10, -10, -10, -10, -10, -10, -20,
+       -10,   0,   0,   0,   0,   0,   0, -10,
+       -10,   0,   5,  10,  10,   5,   0, -10,
+       -10,   5,   5,  10,  10,   5,   5, -10,
+       -10,   0,  10,  10,  10,  10,   0, -10,
+       -10,  10,  10,  10,  10,  10,  10, -10,
+       -10,   5,   0,   0,   0,   0,   5, -10,
+       -20, -10, -10, -10, -10, -10, -10, -20,
+    },
+    // ROOK
+    {
+         0,   0,   0,   0,   0,   0,   0,   0,
+         5,  10,  10,  10,  10,  10,  10,   5,
+        -5,   0,   0,   0,   0,   0,   0,  -5,
+        -5,   0,   0,   0,   0,   0,   0,  -5,
+        -5,   0,   0,   0,   0,   0,   0,  -5,
+        -5,   0,   0,   0,   0,   0,   0,  -5,
+        -5,   0,   0,   0,   0,   0,   0,  -5,
+         0,   0,   0,   5,   5,   0,   0,   0,
+    },
+    // QUEEN
+    {
+       -20, -10, -10,  -5,  -5, -10, -10, -20,
+       -10,   0,   0,   0,   0,   0,   0, -10,
+       -10,   0,   5,   5,   5,   5,   0, -10,
+        -5,   0,   5,   5,   5,   5,   0,  -5,
+         0,   0,   5,   5,   5,   5,   0,  -5,
+       -10,   5,   5,   5,   5,   5,   0, -10,
+       -10,   0,   5,   0,   0,   0,   0, -10,
+       -20, -10, -10,  -5,  -5, -10, -10, -20,
+    },
+    // KING
+    {
+       -30, -40, -40, -50, -50, -40, -40, -30,
+       -30, -40, -40, -50, -50, -40, -40, -30,
+       -30, -40, -40, -50, -50, -40, -40, -30,
+       -30, -40, -40, -50, -50, -40, -40, -30,
+       -20, -30, -30, -40, -40, -30, -30, -20,
+       -10, -20, -20, -20, -20, -20, -20, -10,
+        20,  20,   0,   0,   0,   0,  20,  20,
+        20,  30,  10,   0,   0,  10,  30,  20,
+    },
+    // BACKBENCHER: the further up the board it is, the more rows it can
+    // jump back to.
+    {
+         0,   0,   0,   0,   0,   0,   0,   0,
+        40,  40,  40,  40,  40,  40,  40,  40,
+        30,  30,  30,  30,  30,  30,  30,  30,
+        20,  20,  20,  20,  20,  20,  20,  20,
+        10,  10,  10,  10,  10,  10,  10,  10,
+         5,   5,   5,   5,   5,   5,   5,   5,
+         0,   0,   0,   0,   0,   0,   0,   0,
+         0,   0,   0,   0,   0,   0,   0,   0,
+    },
+    // MOUSE: it hides in the corners, so the edges are where it's happiest.
+    {
+         0,   0,   0,   0,   0,   0,   0,   0,
+        10,   5,   5,   5,   5,   5,   5,  10,
+        10,   5,   5,   5,   5,   5,   5,  10,
+         5,   0,   0,   0,   0,   0,   0,   5,
+         5,   0,   0,   0,   0,   0,   0,   5,
+         0,   0,   0,   0,   0,   0,   0,   0,
+         0,   0,   0,   0,   0,   0,   0,   0,
+         0,   0,   0,   0,   0,   0,   0,   0,
+    },
+};
+
+static EvalParams make_default_eval_params() {
+    EvalParams params = {};
+    params.material[EMPTY] = 0;
+    params.material[PAWN] = 100;
+    params.material[KNIGHT] = 320;
+    params.material[BISHOP] = 330;
+    params.material[ROOK] = 500;
+    params.material[QUEEN] = 900;
+    params.material[KING] = 100000;
+    params.material[BACKBENCHER] = 250;
+    params.material[MOUSE] = 200;
+    params.doubled_pawn = -10;
+    params.isolated_pawn = -15;
+    const int passed_pawn[8] = { 0, 5, 10, 20, 35, 60, 100, 0 };
+    for (int rank = 0; rank < 8; ++rank) {
+        params.passed_pawn[rank] = passed_pawn[rank];
+    }
+    for (int type = 0; type < NUM_PIECE_TYPES; ++type) {
+        for (int square = 0; square < PST_SQUARES; ++square) {
+            // Flip the diagram so rank 1 comes first.
+            params.piece_square[type][square] = DIAGRAM_PIECE_SQUARE[type][square ^ 56];
+        }
+    }
+    return params;
+}
+
+const EvalParams DEFAULT_EVAL_PARAMS = make_default_eval_params();
+
+static EvalParams current_eval_params;
+static uint64_t current_eval_params_generation = 0;
+
+int32_t PIECE_SQUARE_SCORES[MAX_PIECE_CODES * PST_SQUARES];
+int32_t MATERIAL_SCORES[NUM_PIECE_TYPES];
+int32_t POSITIONAL_SCORES[MAX_PIECE_CODES * PST_SQUARES];
+
+const EvalParams& eval_params() {
+    return current_eval_params;
+}
+
+uint64_t eval_params_generation() {
+    return current_eval_params_generation;
+}
+
+void update_piece_code_scores(int code) {
+    const EvalParams& params = current_eval_params;
+    int type = code_type(code);
+    bool black = code_team(code) == BLACK;
+    for (int square = 0; square < PST_SQUARES; ++square) {
+        // Black sees the board upside down, so it uses the square on the
+        // same file of the mirrored rank.
+        int positional = params.piece_square[type][black ? square ^ 56 : square];
+        int score = params.material[type] + positional;
+        POSITIONAL_SCORES[code * PST_SQUARES + square] = positional;
+        PIECE_SQUARE_SCORES[code * PST_SQUARES + square] = black ? -score : score;
+    }
+}
+
+void set_eval_params(const EvalParams& params) {
+    current_eval_params = params;
+    ++current_eval_params_generation;
+    for (int type = 0; type < NUM_PIECE_TYPES; ++type) {
+        MATERIAL_SCORES[type] = params.material[type];
+    }
+    for (int code = 0; code < MAX_PIECE_CODES; ++code) {
+        update_piece_code_scores(code);
+    }
+}
+
+static const char* const PIECE_TYPE_NAMES[NUM_PIECE_TYPES] = {
+    "EMPTY", "PAWN", "KNIGHT", "BISHOP", "ROOK", "QUEEN", "KING", "BACKBENCHER", "MOUSE",
+};
+
+void save_eval_params(const EvalParams& params, const string& path) {
+    ofstream out(path);
+    out << "# silly chess evaluation parameters, in centipawns\n";
+    out << "material";
+    for (int type = 0; type < NUM_PIECE_TYPES; ++type) {
+        out << ' ' << params.material[type];
+    }
+    out << '\n';
+    for (int type = 0; type < NUM_PIECE_TYPES; ++type) {
+        // Written like a board diagram, rank 8 first.
+        out << "piece_square " << PIECE_TYPE_NAMES[type] << '\n';
+        for (int rank = 7; rank >= 0; --rank) {
+            for (int file = 0; file < 8; ++file) {
+                out << (file == 0 ? "" : " ") << setw(4) << params.piece_square[type][rank * 8 + file];
+            }
+            out << '\n';
+        }
+    }
+    out << "doubled_pawn " << params.doubled_pawn << '\n';
+    out << "isolated_pawn " << params.isolated_pawn << '\n';
+    out << "passed_pawn";
+    for (int rank = 0; rank < 8; ++rank) {
+        out << ' ' << params.passed_pawn[rank];
+    }
+    out << '\n';
+    if (!out) {
+        throw runtime_error("save_eval_params: could not write " + path);
+    }
+}
+
+EvalParams load_eval_params(const string& path) {
+    ifstream in(path);
+    if (!in) {
+        throw runtime_error("load_eval_params: could not open " + path);
+    }
+    EvalParams params = DEFAULT_EVAL_PARAMS;
+    string name;
+    while (in >> name) {
+        if (name[0] == '#') {
+            getline(in, name);
+        }
+        else if (name == "material") {
+            for (int type = 0; type < NUM_PIECE_TYPES; ++type) {
+                in >> params.material[type];
+            }
+        }
+        else if (name == "piece_square") {
+            string type_name;
+            in >> type_name;
+            int type = 0;
+            while (type < NUM_PIECE_TYPES && type_name != PIECE_TYPE_NAMES[type]) {
+                ++type;
+            }
+            if (type == NUM_PIECE_TYPES) {
+                throw runtime_error("load_eval_params: unknown piece type " + type_name + " in " + path);
+            }
+            for (int rank = 7; rank >= 0; --rank) {
+                for (int file = 0; file < 8; ++file) {
+                    in >> params.piece_square[type][rank * 8 + file];
+                }
+            }
+        }
+        else if (name == "doubled_pawn") {
+            in >> params.doubled_pawn;
+        }
+        else if (name == "isolated_pawn") {
+            in >> params.isolated_pawn;
+        }
+        else if (name == "passed_pawn") {
+            for (int rank = 0; rank < 8; ++rank) {
+                in >> params.passed_pawn[rank];
+            }
+        }
+        else {
+            throw runtime_error("load_eval_params: unknown parameter " + name + " in " + path);
+        }
+        if (!in) {
+            throw runtime_error("load_eval_params: bad value for " + name + " in " + path);
+        }
+    }
+    return params;
+}
+
+// Fills the tables before main runs.
+static const bool EVAL_TABLES_INITIALIZED = (set_eval_params(DEFAULT_EVAL_PARAMS), true);
+
+// For each cell of a width x height board (indexed y * width + x), the square
+// of the piece-square tables that it uses.
+static const int32_t* pst_square_map(int width, int height) {
+    static const vector<int32_t> identity = [] {
+        vector<int32_t> squares(PST_SQUARES);
+        for (int square = 0; square < PST_SQUARES; ++square) {
+            squares[square] = square;
+        }
+        return squares;
+    }();
+    if (width == 8 && height == 8) {
+        return identity.data();
+    }
+
+    thread_local vector<int32_t> squares;
+    thread_local int squares_width = 0, squares_height = 0;
+    if (squares_width != width || squares_height != height) {
+        squares.resize(width * height);
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                squares[y * width + x] = pst_square(Cell(x, y), width, height);
+            }
+        }
+        squares_width = width;
+        squares_height = height;
+    }
+    return squares.data();
+}
+
+// Sums PIECE_SQUARE_SCORES[codes[i]][squares[i]] over the first num_cells
+// cells. With AVX2 this looks up 8 cells at a time with a gather.
+static int sum_piece_square_scores(const uint8_t* codes, const int32_t* squares, int num_cells) {
+    int sum = 0;
+    int i = 0;
+#if defined(__AVX2__)
+    __m256i sums = _mm256_setzero_si256();
+    for (; i + 8 <= num_cells; i += 8) {
+        __m256i cell_codes = _mm256_cvtepu8_epi32(
+            _mm_loadl_epi64(reinterpret_cast<const __m128i*>(codes + i)));
+        __m256i cell_squares = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(squares + i));
+        // index = code * PST_SQUARES + square
+        __m256i indices = _mm256_add_epi32(_mm256_slli_epi32(cell_codes, 6), cell_squares);
+        sums = _mm256_add_epi32(sums, _mm256_i32gather_epi32(PIECE_SQUARE_SCORES, indices, 4));
+    }
+    __m128i half = _mm_add_epi32(_mm256_castsi256_si128(sums), _mm256_extracti128_si256(sums, 1));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(1, 0, 3, 2)));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(2, 3, 0, 1)));
+    sum = _mm_cvtsi128_si32(half);
+#endif
+    for (; i < num_cells; ++i) {
+        sum += PIECE_SQUARE_SCORES[codes[i] * PST_SQUARES + squares[i]];
+    }
+    return sum;
+}
+
+int evaluate(const Board& board) {
+    int width = board.width(), height = board.height();
+    return sum_piece_square_scores(
+        board.piece_codes(), pst_square_map(width, height), width * height);
+}
+
+PawnStructureTerms pawn_structure_terms(const uint8_t* codes, int width, int height) {
+    // For each file: how many pawns each team has, White's lowest structure
+    // piece and Black's highest one (so we can see if anything is in front).
+    // Files are shifted by one so x - 1 and x + 1 are always valid.
+    vector<int> white_pawns(width + 2), black_pawns(width + 2);
+    vector<int> white_lowest(width + 2, height), black_highest(width + 2, -1);
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            int code = codes[y * width + x];
+            int type = code_type(code);
+            if (!is_pawn_structure_piece(type)) {
+                continue;
+            }
+            bool black = code_team(code) == BLACK;
+            if (black) {
+                black_highest[x + 1] = std::max(black_highest[x + 1], y);
+                black_pawns[x + 1] += type != MOUSE;
+            }
+            else {
+                white_lowest[x + 1] = std::min(white_lowest[x + 1], y);
+                white_pawns[x + 1] += type != MOUSE;
+            }
+        }
+    }
+
+    PawnStructureTerms terms = {};
+    for (int file = 1; file <= width; ++file) {
+        if (white_pawns[file] > 1) {
+            terms.doubled_pawns += white_pawns[file] - 1;
+        }
+        if (black_pawns[file] > 1) {
+            terms.doubled_pawns -= black_pawns[file] - 1;
+        }
+    }
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            int code = codes[y * width + x];
+            int type = code_type(code);
+            if (type != PAWN && type != BACKBENCHER) {
+                continue;
+            }
+            int file = x + 1;
+            if (code_team(code) == WHITE) {
+                if (white_pawns[file - 1] == 0 && white_pawns[file + 1] == 0) {
+                    ++terms.isolated_pawns;
+                }
+                if (black_highest[file - 1] <= y && black_highest[file] <= y && black_highest[file + 1] <= y) {
+                    ++terms.passed_pawns[y * 8 / height];
+                }
+            }
+            else {
+                if (black_pawns[file - 1] == 0 && black_pawns[file + 1] == 0) {
+                    --terms.isolated_pawns;
+                }
+                if (white_lowest[file - 1] >= y && white_lowest[file] >= y && white_lowest[file + 1] >= y) {
+                    --terms.passed_pawns[(height - 1 - y) * 8 / height];
+                }
+            }
+        }
+    }
+    return terms;
+}
+
+int pawn_structure_score(const PawnStructureTerms& terms) {
+    const EvalParams& params = eval_params();
+    int score = terms.doubled_pawns * params.doubled_pawn + terms.isolated_pawns * params.isolated_pawn;
+    for (int rank = 0; rank < 8; ++rank) {
+        score += terms.passed_pawns[rank] * params.passed_pawn[rank];
+    }
+    return score;
+}
+
+int pawn_structure_eval(const Board& board) {
+    return pawn_structure_score(pawn_structure_terms(board.piece_codes(), board.width(), board.height()));
+}
+
+double EvalCacheStats::hit_rate() const {
+    return probes == 0 ? 0 : static_cast<double>(hits) / probes;
+}
+
+EvalCacheStats& EvalCacheStats::operator+=(const EvalCacheStats& other) {
+    probes += other.probes;
+    hits += other.hits;
+    return *this;
+}
+
+EvalCacheStats EvalCacheStats::operator-(const EvalCacheStats& other) const {
+    EvalCacheStats difference;
+    difference.probes = probes - other.probes;
+    difference.hits = hits - other.hits;
+    return difference;
+}
+
+EvalCache::EvalCache(int size_log2)
+    : entries(size_t(1) << size_log2), mask((uint64_t(1) << size_log2) - 1) {
+    clear();
+}
+
+bool EvalCache::probe(uint64_t key, int& score) {
+    ++stats.probes;
+    const Entry& entry = entries[key & mask];
+    if (entry.key != key) {
+        return false;
+    }
+    ++stats.hits;
+    score = entry.score;
+    return true;
+}
+
+void EvalCache::store(uint64_t key, int score) {
+    Entry& entry = entries[key & mask];
+    entry.key = key;
+    entry.score = score;
+}
+
+void EvalCache::clear() {
+    // No position hashes to ~0, and if one did it would only cost a miss.
+    for (Entry& entry : entries) {
+        entry.key = ~uint64_t(0);
+        entry.score = 0;
+    }
+}
+
+// 64K entries (1 MB) for whole evaluations and 16K entries for pawn
+// structures, which repeat much more often.
+const int EVAL_CACHE_SIZE_LOG2 = 16;
+const int PAWN_CACHE_SIZE_LOG2 = 14;
+
+EvalCache& thread_eval_cache() {
+    thread_local EvalCache cache(EVAL_CACHE_SIZE_LOG2);
+    return cache;
+}
+
+EvalCache& thread_pawn_cache() {
+    thread_local EvalCache cache(PAWN_CACHE_SIZE_LOG2);
+    return cache;
+}
+
+int cached_pawn_structure_eval(const Board& board) {
+    // Mixing in the generation keeps results from older parameters out.
+    uint64_t key = board.pawn_hash() ^ eval_params_generation() * 0x9E3779B97F4A7C15ULL;
+    EvalCache& cache = thread_pawn_cache();
+    int score;
+    if (!cache.probe(key, score)) {
+        score = pawn_structure_eval(board);
+        cache.store(key, score);
+    }
+    return score;
+}
@@ -0,0 +1,150 @@
+#ifndef _CHESS_EVAL_H_
+#define _CHESS_EVAL_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "chess_board.h"
+#include "chess_pieces.h"
+
+// Piece-square tables are defined for an 8x8 board. Boards of other sizes
+// are scaled onto these 64 squares (see pst_square).
+const int PST_SQUARES = 64;
+
+// Everything the evaluation knows about, in centipawns (a pawn is 100).
+struct EvalParams {
+    int material[NUM_PIECE_TYPES];
+    // Bonus for a piece of each type standing on each square, from White's
+    // point of view. Square 0 is a1, square 7 is h1 and square 63 is h8.
+    int piece_square[NUM_PIECE_TYPES][PST_SQUARES];
+
+    // Pawn structure terms (see pawn_structure_eval).
+    int doubled_pawn;
+    int isolated_pawn;
+    // Bonus for a passed pawn on each rank, counted from its own side.
+    int passed_pawn[8];
+};
+
+extern const EvalParams DEFAULT_EVAL_PARAMS;
+
+const EvalParams& eval_params();
+// Replaces the evaluation parameters. This rebuilds the lookup tables used by
+// every evaluation, so only call it before any searches are started. Boards
+// that already exist keep their old incremental sums until they're reloaded.
+void set_eval_params(const EvalParams& params);
+
+// Writes params as text (piece-square tables are laid out like the board)
+// and reads them back. Parameters missing from the file keep their default
+// values. Throws runtime_error if the file can't be read or written.
+void save_eval_params(const EvalParams& params, const std::string& path);
+EvalParams load_eval_params(const std::string& path);
+
+// Fills in the evaluation tables for a code new_piece_code just gave out.
+void update_piece_code_scores(int code);
+
+// The evaluation table: for every piece code and square, the material plus
+// piece-square score of that piece on that square, positive for White and
+// negative for Black (black pieces use the mirrored square). Custom pieces
+// score like the built-in piece of their type.
+extern int32_t PIECE_SQUARE_SCORES[MAX_PIECE_CODES * PST_SQUARES];
+
+inline int piece_square_score(int code, int square) {
+    return PIECE_SQUARE_SCORES[code * PST_SQUARES + square];
+}
+
+// The same table split into its two parts, both from the point of view of
+// the piece's own team (so they are never negated for Black). Board uses
+// these to keep per-team sums up to date as pieces move.
+extern int32_t MATERIAL_SCORES[NUM_PIECE_TYPES];
+extern int32_t POSITIONAL_SCORES[MAX_PIECE_CODES * PST_SQUARES];
+
+inline int material_score(int type) {
+    return MATERIAL_SCORES[type];
+}
+
+inline int positional_score(int code, int square) {
+    return POSITIONAL_SCORES[code * PST_SQUARES + square];
+}
+
+// Maps a cell of a width x height board onto the 8x8 piece-square tables.
+inline int pst_square(Cell cell, int width, int height) {
+    if (width == 8 && height == 8) {
+        return cell.y * 8 + cell.x;
+    }
+    return (cell.y * 8 / height) * 8 + cell.x * 8 / width;
+}
+
+// Changes every time set_eval_params is called, so cached evaluations from
+// older parameters can be told apart.
+uint64_t eval_params_generation();
+
+// Returns the static evaluation of board: positive if White is ahead and
+// negative if Black is ahead.
+int evaluate(const Board& board);
+
+// Pawns and BackBenchers make up a team's pawn structure. Mice don't, but an
+// enemy Mouse in front of a pawn stops it from being passed, so all three
+// are part of Board::pawn_hash.
+inline bool is_pawn_structure_piece(int type) {
+    return type == PAWN || type == BACKBENCHER || type == MOUSE;
+}
+
+// How many of each pawn structure feature White has minus how many Black
+// has, for a board given as piece codes (see Board::piece_codes).
+struct PawnStructureTerms {
+    int doubled_pawns;
+    int isolated_pawns;
+    // Passed pawns on each rank, counted from their own side.
+    int passed_pawns[8];
+};
+
+PawnStructureTerms pawn_structure_terms(const uint8_t* codes, int width, int height);
+// The score of terms with the current evaluation parameters.
+int pawn_structure_score(const PawnStructureTerms& terms);
+
+// Scores doubled, isolated and passed pawns (and BackBenchers), positive if
+// White's structure is better. This only depends on the pieces in
+// Board::pawn_hash.
+int pawn_structure_eval(const Board& board);
+
+struct EvalCacheStats {
+    uint64_t probes = 0;
+    uint64_t hits = 0;
+
+    double hit_rate() const;
+    EvalCacheStats& operator+=(const EvalCacheStats& other);
+    EvalCacheStats operator-(const EvalCacheStats& other) const;
+};
+
+// A direct-mapped cache of scores, keyed by a position hash. A newer entry
+// always replaces whatever was in its slot.
+class EvalCache {
+    struct Entry {
+        uint64_t key;
+        int32_t score;
+    };
+    std::vector<Entry> entries;
+    uint64_t mask;
+
+public:
+    EvalCacheStats stats;
+
+    // A cache with 2^size_log2 entries.
+    explicit EvalCache(int size_log2);
+    // If key is in the cache, sets score and returns true.
+    bool probe(uint64_t key, int& score);
+    void store(uint64_t key, int score);
+    void clear();
+};
+
+// Each thread has its own caches, so searches on different threads never
+// share or lock them.
+EvalCache& thread_eval_cache();
+EvalCache& thread_pawn_cache();
+
+// pawn_structure_eval, looked up in thread_pawn_cache by Board::pawn_hash
+// so each structure is only analyzed once.
+int cached_pawn_structure_eval(const Board& board);
+
+#endif  // _CHESS_EVAL_H_
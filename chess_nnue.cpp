@@ -0,0 +1,244 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#if defined(__AVX2__) || defined(__SSE4_1__)
+#include <immintrin.h>
+#endif
+
+#include "chess_board.h"
+#include "chess_eval.h"
+#include "chess_nnue.h"
+#include "chess_pieces.h"
+
+using std::ifstream;
+using std::ofstream;
+using std::ios;
+using std::runtime_error;
+
+// Weights file layout (little endian):
+//   "SCNN", format version, NNUE_INPUTS, NNUE_HIDDEN (all uint32)
+//   input_weights (int16), input_biases (int16), output_weights (int8),
+//   output_bias (int32)
+static const char NNUE_MAGIC[4] = { 'S', 'C', 'N', 'N' };
+static const uint32_t NNUE_VERSION = 1;
+
+int nnue_input(int code, int square, Team perspective) {
+    int type = code_type(code);
+    bool black_piece = code_team(code) == BLACK;
+    bool own_piece = black_piece == (perspective == BLACK);
+    if (perspective == BLACK) {
+        square ^= 56;
+    }
+    int kind = (own_piece ? 0 : NUM_PIECE_TYPES - 1) + type - 1;
+    return kind * PST_SQUARES + square;
+}
+
+NnueFloatWeights::NnueFloatWeights()
+    : input_weights(NNUE_INPUTS * NNUE_HIDDEN),
+      input_biases(NNUE_HIDDEN),
+      output_weights(2 * NNUE_HIDDEN),
+      output_bias(0) {}
+
+NnueNetwork::NnueNetwork()
+    : input_weights(NNUE_INPUTS * NNUE_HIDDEN),
+      input_biases(NNUE_HIDDEN),
+      output_weights(2 * NNUE_HIDDEN),
+      output_bias(0) {}
+
+template <typename T>
+static T quantize(float value, float scale, int limit) {
+    long rounded = std::lround(value * scale);
+    return static_cast<T>(std::max<long>(-limit, std::min<long>(limit, rounded)));
+}
+
+NnueNetwork::NnueNetwork(const NnueFloatWeights& weights) : NnueNetwork() {
+    for (size_t i = 0; i < input_weights.size(); ++i) {
+        input_weights[i] = quantize<int16_t>(weights.input_weights[i], NNUE_QA, 32767);
+    }
+    for (size_t i = 0; i < input_biases.size(); ++i) {
+        input_biases[i] = quantize<int16_t>(weights.input_biases[i], NNUE_QA, 32767);
+    }
+    for (size_t i = 0; i < output_weights.size(); ++i) {
+        output_weights[i] = quantize<int8_t>(weights.output_weights[i], NNUE_QB, 127);
+    }
+    output_bias = quantize<int32_t>(weights.output_bias, NNUE_QA * NNUE_QB, 1 << 30);
+}
+
+void NnueNetwork::load(const string& path) {
+    ifstream in(path, ios::binary);
+    if (!in) {
+        throw runtime_error("NnueNetwork::load: could not open " + path);
+    }
+    char magic[4];
+    uint32_t header[3];
+    in.read(magic, sizeof(magic));
+    in.read(reinterpret_cast<char*>(header), sizeof(header));
+    if (!in || memcmp(magic, NNUE_MAGIC, sizeof(magic)) != 0 || header[0] != NNUE_VERSION
+        || header[1] != NNUE_INPUTS || header[2] != NNUE_HIDDEN) {
+        throw runtime_error("NnueNetwork::load: " + path + " is not a network of the expected shape");
+    }
+    in.read(reinterpret_cast<char*>(input_weights.data()), input_weights.size() * sizeof(int16_t));
+    in.read(reinterpret_cast<char*>(input_biases.data()), input_biases.size() * sizeof(int16_t));
+    in.read(reinterpret_cast<char*>(output_weights.data()), output_weights.size() * sizeof(int8_t));
+    in.read(reinterpret_cast<char*>(&output_bias), sizeof(output_bias));
+    if (!in) {
+        throw runtime_error("NnueNetwork::load: " + path + " is truncated");
+    }
+}
+
+void NnueNetwork::save(const string& path) const {
+    ofstream out(path, ios::binary);
+    uint32_t header[3] = { NNUE_VERSION, NNUE_INPUTS, NNUE_HIDDEN };
+    out.write(NNUE_MAGIC, sizeof(NNUE_MAGIC));
+    out.write(reinterpret_cast<const char*>(header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(input_weights.data()), input_weights.size() * sizeof(int16_t));
+    out.write(reinterpret_cast<const char*>(input_biases.data()), input_biases.size() * sizeof(int16_t));
+    out.write(reinterpret_cast<const char*>(output_weights.data()), output_weights.size() * sizeof(int8_t));
+    out.write(reinterpret_cast<const char*>(&output_bias), sizeof(output_bias));
+    if (!out) {
+        throw runtime_error("NnueNetwork::save: could not write " + path);
+    }
+}
+
+// FNV-1a over the bytes of values, continuing from hash.
+template <typename T>
+static uint64_t hash_values(const vector<T>& values, uint64_t hash) {
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(values.data());
+    for (size_t i = 0; i < values.size() * sizeof(T); ++i) {
+        hash = (hash ^ bytes[i]) * 0x100000001B3ull;
+    }
+    return hash;
+}
+
+uint64_t NnueNetwork::hash() const {
+    uint64_t hash = 0xCBF29CE484222325ull;
+    hash = hash_values(input_weights, hash);
+    hash = hash_values(input_biases, hash);
+    hash = hash_values(output_weights, hash);
+    return hash_values(vector<int32_t>{ output_bias }, hash);
+}
+
+// accumulator += row (NNUE_HIDDEN values)
+static void add_row(int16_t* accumulator, const int16_t* row) {
+    int i = 0;
+#if defined(__AVX2__)
+    for (; i + 16 <= NNUE_HIDDEN; i += 16) {
+        __m256i* acc = reinterpret_cast<__m256i*>(accumulator + i);
+        __m256i weights = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + i));
+        _mm256_storeu_si256(acc, _mm256_add_epi16(_mm256_loadu_si256(acc), weights));
+    }
+#elif defined(__SSE4_1__)
+    for (; i + 8 <= NNUE_HIDDEN; i += 8) {
+        __m128i* acc = reinterpret_cast<__m128i*>(accumulator + i);
+        __m128i weights = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i));
+        _mm_storeu_si128(acc, _mm_add_epi16(_mm_loadu_si128(acc), weights));
+    }
+#endif
+    for (; i < NNUE_HIDDEN; ++i) {
+        accumulator[i] += row[i];
+    }
+}
+
+// accumulator -= row (NNUE_HIDDEN values)
+static void sub_row(int16_t* accumulator, const int16_t* row) {
+    int i = 0;
+#if defined(__AVX2__)
+    for (; i + 16 <= NNUE_HIDDEN; i += 16) {
+        __m256i* acc = reinterpret_cast<__m256i*>(accumulator + i);
+        __m256i weights = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + i));
+        _mm256_storeu_si256(acc, _mm256_sub_epi16(_mm256_loadu_si256(acc), weights));
+    }
+#elif defined(__SSE4_1__)
+    for (; i + 8 <= NNUE_HIDDEN; i += 8) {
+        __m128i* acc = reinterpret_cast<__m128i*>(accumulator + i);
+        __m128i weights = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i));
+        _mm_storeu_si128(acc, _mm_sub_epi16(_mm_loadu_si128(acc), weights));
+    }
+#endif
+    for (; i < NNUE_HIDDEN; ++i) {
+        accumulator[i] -= row[i];
+    }
+}
+
+// Returns the sum over NNUE_HIDDEN values of clamp(accumulator, 0, NNUE_QA) * weights.
+static int32_t clipped_relu_dot(const int16_t* accumulator, const int8_t* weights) {
+    int32_t sum = 0;
+    int i = 0;
+#if defined(__AVX2__)
+    __m256i sums = _mm256_setzero_si256();
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i ones = _mm256_set1_epi16(1);
+    for (; i + 32 <= NNUE_HIDDEN; i += 32) {
+        __m256i low = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(accumulator + i));
+        __m256i high = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(accumulator + i + 16));
+        // Saturating to int8 clamps at NNUE_QA (127); max with 0 is the ReLU.
+        // packs works within 128-bit lanes, so put the 64-bit blocks back in order.
+        __m256i clipped = _mm256_max_epi8(_mm256_packs_epi16(low, high), zero);
+        clipped = _mm256_permute4x64_epi64(clipped, _MM_SHUFFLE(3, 1, 2, 0));
+        __m256i w = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(weights + i));
+        __m256i products = _mm256_maddubs_epi16(clipped, w);
+        sums = _mm256_add_epi32(sums, _mm256_madd_epi16(products, ones));
+    }
+    __m128i half = _mm_add_epi32(_mm256_castsi256_si128(sums), _mm256_extracti128_si256(sums, 1));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(1, 0, 3, 2)));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(2, 3, 0, 1)));
+    sum = _mm_cvtsi128_si32(half);
+#elif defined(__SSE4_1__)
+    __m128i sums = _mm_setzero_si128();
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ones = _mm_set1_epi16(1);
+    for (; i + 16 <= NNUE_HIDDEN; i += 16) {
+        __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(accumulator + i));
+        __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(accumulator + i + 8));
+        __m128i clipped = _mm_max_epi8(_mm_packs_epi16(low, high), zero);
+        __m128i w = _mm_loadu_si128(reinterpret_cast<const __m128i*>(weights + i));
+        __m128i products = _mm_maddubs_epi16(clipped, w);
+        sums = _mm_add_epi32(sums, _mm_madd_epi16(products, ones));
+    }
+    sums = _mm_add_epi32(sums, _mm_shuffle_epi32(sums, _MM_SHUFFLE(1, 0, 3, 2)));
+    sums = _mm_add_epi32(sums, _mm_shuffle_epi32(sums, _MM_SHUFFLE(2, 3, 0, 1)));
+    sum = _mm_cvtsi128_si32(sums);
+#endif
+    for (; i < NNUE_HIDDEN; ++i) {
+        int clipped = std::max(0, std::min(NNUE_QA, static_cast<int>(accumulator[i])));
+        sum += clipped * weights[i];
+    }
+    return sum;
+}
+
+void NnueNetwork::refresh(const Board& board, int16_t* accumulator) const {
+    memcpy(accumulator, input_biases.data(), NNUE_HIDDEN * sizeof(int16_t));
+    memcpy(accumulator + NNUE_HIDDEN, input_biases.data(), NNUE_HIDDEN * sizeof(int16_t));
+    for (int y = 0; y < board.height(); ++y) {
+        for (int x = 0; x < board.width(); ++x) {
+            Cell cell(x, y);
+            int code = board[cell].code;
+            if (code_type(code) != EMPTY) {
+                update(accumulator, EMPTY_SPACE.code, code, pst_square(cell, board.width(), board.height()));
+            }
+        }
+    }
+}
+
+void NnueNetwork::update(int16_t* accumulator, int removed_code, int added_code, int square) const {
+    if (code_type(removed_code) != EMPTY) {
+        sub_row(accumulator, &input_weights[nnue_input(removed_code, square, WHITE) * NNUE_HIDDEN]);
+        sub_row(accumulator + NNUE_HIDDEN, &input_weights[nnue_input(removed_code, square, BLACK) * NNUE_HIDDEN]);
+    }
+    if (code_type(added_code) != EMPTY) {
+        add_row(accumulator, &input_weights[nnue_input(added_code, square, WHITE) * NNUE_HIDDEN]);
+        add_row(accumulator + NNUE_HIDDEN, &input_weights[nnue_input(added_code, square, BLACK) * NNUE_HIDDEN]);
+    }
+}
+
+int NnueNetwork::evaluate(const int16_t* accumulator, Team side_to_move) const {
+    const int16_t* own = side_to_move == WHITE ? accumulator : accumulator + NNUE_HIDDEN;
+    const int16_t* other = side_to_move == WHITE ? accumulator + NNUE_HIDDEN : accumulator;
+    int64_t output = output_bias;
+    output += clipped_relu_dot(own, output_weights.data());
+    output += clipped_relu_dot(other, output_weights.data() + NNUE_HIDDEN);
+    return static_cast<int>(output * NNUE_OUTPUT_SCALE / (NNUE_QA * NNUE_QB));
+}
@@ -0,0 +1,86 @@
+#ifndef _CHESS_NNUE_H_
+#define _CHESS_NNUE_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "chess_board.h"
+#include "chess_eval.h"
+#include "chess_pieces.h"
+
+using std::string;
+using std::vector;
+
+// A small efficiently updatable neural network (NNUE) evaluation.
+//
+// Every (piece, square) pair on the board is an input, seen from each team's
+// perspective: "own" pieces come first, and Black's perspective flips the
+// board so both teams look at it the same way. The first layer sums the
+// weight rows of the active inputs into an accumulator for each perspective.
+// Since a move only turns a couple of inputs on or off, Board updates the
+// accumulators as pieces move instead of recomputing them (see
+// Board::set_network). The output layer reads both accumulators through a
+// clipped ReLU, side to move first.
+//
+// The network is quantized: the first layer is int16 and the output layer is
+// int8, so it runs with integer SIMD (AVX2 or SSE4.1, with a scalar fallback).
+const int NNUE_PIECE_KINDS = 2 * (NUM_PIECE_TYPES - 1);
+const int NNUE_INPUTS = NNUE_PIECE_KINDS * PST_SQUARES;
+const int NNUE_HIDDEN = 64;
+// Number of int16 values in a board's accumulator: White's perspective
+// followed by Black's.
+const int NNUE_ACCUMULATOR_SIZE = 2 * NNUE_HIDDEN;
+
+// Quantization scales. A first layer output of 1.0 is stored as NNUE_QA (so
+// the clipped ReLU clamps to [0, NNUE_QA]) and output weights are multiplied
+// by NNUE_QB. The network output is in units of NNUE_OUTPUT_SCALE centipawns.
+const int NNUE_QA = 127;
+const int NNUE_QB = 64;
+const int NNUE_OUTPUT_SCALE = 400;
+
+// Returns the input that a piece with the given code on square turns on, from
+// perspective's point of view (WHITE or BLACK). Custom pieces turn on the
+// input of the built-in piece of their type.
+int nnue_input(int code, int square, Team perspective);
+
+// Unquantized weights, as the trainer sees them.
+struct NnueFloatWeights {
+    vector<float> input_weights;    // NNUE_INPUTS rows of NNUE_HIDDEN
+    vector<float> input_biases;     // NNUE_HIDDEN
+    vector<float> output_weights;   // 2 * NNUE_HIDDEN, side to move first
+    float output_bias;
+
+    NnueFloatWeights();
+};
+
+class NnueNetwork {
+    vector<int16_t> input_weights;
+    vector<int16_t> input_biases;
+    vector<int8_t> output_weights;
+    int32_t output_bias;
+
+public:
+    // A network with all weights zero, which evaluates every position as 0.
+    NnueNetwork();
+    // Quantizes trained weights.
+    explicit NnueNetwork(const NnueFloatWeights& weights);
+
+    // Reads/writes the weights file. Throws runtime_error if the file can't be
+    // read or isn't a network of this shape.
+    void load(const string& path);
+    void save(const string& path) const;
+    // A hash of all the weights, to tell networks apart without comparing
+    // them.
+    uint64_t hash() const;
+
+    // Recomputes accumulator (NNUE_ACCUMULATOR_SIZE values) from scratch.
+    void refresh(const Board& board, int16_t* accumulator) const;
+    // Updates accumulator for the cell at square changing from the piece with
+    // code removed_code to the piece with code added_code.
+    void update(int16_t* accumulator, int removed_code, int added_code, int square) const;
+    // Returns the evaluation in centipawns from the side to move's point of view.
+    int evaluate(const int16_t* accumulator, Team side_to_move) const;
+};
+
+#endif  // _CHESS_NNUE_H_
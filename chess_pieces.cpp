@@ -1,322 +1,484 @@
-#include "utf8_codepoint.h"
-#include "chess_pieces.h"
-
-
-bool ChessPiece::is_opposite_team(const ChessPiece& other) const {
-    return (team == WHITE && other.team == BLACK) || (team == BLACK && other.team == WHITE);
-}
-
-bool ChessPiece::operator==(const ChessPiece& other) const {
-    return utf8_codepoint == other.utf8_codepoint;
-}
-bool ChessPiece::operator!=(const ChessPiece& other) const {
-    return utf8_codepoint != other.utf8_codepoint;
-}
-
-ostream& operator<<(ostream& os, const ChessPiece& p) {
-    return os << p.utf8_codepoint;
-}
-
-void SimpleChessPiece::make_move(Board& board, Move move) const {
-    board.make_classical_chess_move(move);
-}
-
-void King::get_moves(const Board& board, Cell from, vector<Move>& moves) const {
-    for (int x = from.x - 1; x < from.x + 2; ++x) {
-        for (int y = from.y - 1; y < from.y + 2; ++y) {
-            Cell to(x, y);
-            if (from != to && board.contains(to)
-                && (board[to] == EMPTY_SPACE || is_opposite_team(board[to]))) {
-                moves.emplace_back(from, to);
-            }
-        }
-    }
-}
-
-void Queen::get_moves(const Board& board, Cell from, vector<Move>& moves) const {
-    // The 8 directions a queen can go...
-    Cell directions[] = {
-      {-1,  1}, {0,  1}, {1,  1},
-      {-1,  0},          {1,  0},
-      {-1, -1}, {0, -1}, {1, -1},
-    };
-    for (Cell direction : directions) {
-        for (int steps = 1; ; ++steps) {
-            Cell to(from.x + steps * direction.x, from.y + steps * direction.y);
-            if (!board.contains(to)) {
-                break;
-            }
-            const ChessPiece& piece = board[to];
-            if (piece == EMPTY_SPACE) {
-                moves.emplace_back(from, to);
-            }
-            else if (is_opposite_team(piece)) {
-                moves.emplace_back(from, to);
-                break;
-            }
-            else {  // if (team == piece.team)
-                break;
-            }
-        }
-    }
-}
-
-void Bishop::get_moves(const Board& board, Cell from, vector<Move>& moves) const {
-    // The 4 directions a bishop can go...
-    Cell directions[] = {
-      {-1,  1}, {1,  1},
-      {-1, -1}, {1, -1},
-    };
-    for (Cell direction : directions) {
-        for (int steps = 1; ; ++steps) {
-            Cell to(from.x + steps * direction.x, from.y + steps * direction.y);
-            if (!board.contains(to)) {
-                break;
-            }
-            const ChessPiece& piece = board[to];
-            if (piece == EMPTY_SPACE) {
-                moves.emplace_back(from, to);
-            }
-            else if (is_opposite_team(piece)) {
-                moves.emplace_back(from, to);
-                break;
-            }
-            else {  // if (team == piece.team)
-                break;
-            }
-        }
-    }
-}
-
-void Knight::get_moves(const Board& board, Cell from, vector<Move>& moves) const {
-    Cell jumps[] = {
-           {-1,  2}, {1,  2},
-      {-2,  1},          {2,  1},
-      {-2, -1},          {2, -1},
-           {-1, -2}, {1, -2},
-    };
-    for (Cell jump : jumps) {
-        Cell to(from.x + jump.x, from.y + jump.y);
-        if (board.contains(to)) {
-            const ChessPiece& piece = board[to];
-            if (piece == EMPTY_SPACE || is_opposite_team(piece)) {
-                moves.emplace_back(from, to);
-            }
-        }
-    }
-}
-
-void Rook::get_moves(const Board& board, Cell from, vector<Move>& moves) const {
-    // The 4 directions a rook can go...
-    Cell directions[] = {
-                {0,  1},
-      {-1,  0},          {1,  0},
-                {0, -1},
-    };
-    for (Cell direction : directions) {
-        for (int steps = 1; ; ++steps) {
-            Cell to(from.x + steps * direction.x, from.y + steps * direction.y);
-            if (!board.contains(to)) {
-                break;
-            }
-            const ChessPiece& piece = board[to];
-            if (piece == EMPTY_SPACE) {
-                moves.emplace_back(from, to);
-            }
-            else if (is_opposite_team(piece)) {
-                moves.emplace_back(from, to);
-                break;
-            }
-            else {  // if (team == piece.team)
-                break;
-            }
-        }
-    }
-}
-
-void Pawn::get_moves(const Board& board, Cell from, vector<Move>& moves) const {
-    Cell to = Cell(from.x, from.y + y_move_steps);
-    if (board.contains(to) && board[to] == EMPTY_SPACE) {
-        moves.emplace_back(from, to);
-    }
-
-    to = Cell(from.x - 1, from.y + y_move_steps);
-    if (board.contains(to) && is_opposite_team(board[to])) {
-        moves.emplace_back(from, to);
-    }
-
-    to = Cell(from.x + 1, from.y + y_move_steps);
-    if (board.contains(to) && is_opposite_team(board[to])) {
-        moves.emplace_back(from, to);
-    }
-}
-
-/*
-*
-* A BackBencher can move to any cell in any of the rows behind it, and can
-* remove an opponent's piece in the process.
-* While moving forward, a BackBencher behaves exactly like a regular Pawn.
-*
-*/
-
-void BackBencher::get_moves(const Board& board, Cell from, vector<Move>& moves) const {
-   
-    Cell to = Cell(from.x, from.y + forward_steps);
-    if (board.contains(to) && board[to] == EMPTY_SPACE) {
-        moves.emplace_back(from, to);
-    }
-
-    to = Cell(from.x - 1, from.y + forward_steps);
-    if (board.contains(to) && is_opposite_team(board[to])) {
-        moves.emplace_back(from, to);
-    }
-
-    to = Cell(from.x + 1, from.y + forward_steps);
-    if (board.contains(to) && is_opposite_team(board[to])) {
-        moves.emplace_back(from, to);
-    }
-    // black is at   top  of the board
-    // white is at bottom of the board
-    if (team == WHITE)
-    {
-        if (from.y == 0) // the BackBencher is already all the way at the back of the board
-            return;
-        int y_value = from.y-1;
-        Cell to;
-        while (y_value >= 0)
-        {
-            for (int i = 0; i < 8; ++i)
-            {
-                to = Cell(i, y_value);
-                if (board.contains(to) && (board[to] == EMPTY_SPACE || is_opposite_team(board[to]))) // only a valid move if cell is empty/has opponent's piece
-                    moves.emplace_back(from, to);
-            }
-            --y_value;
-        }
-    }
-    if (team == BLACK)
-    {
-        if (from.y == 8)
-            return;
-        int y_value = from.y + 1;
-        Cell to;
-        while (y_value <= 8) // the BackBencher is already all the way at the back of the board
-        {
-            for (int i = 0; i < 8; ++i)
-            {
-                to = Cell(i, y_value);
-                if (board.contains(to) && (board[to] == EMPTY_SPACE || is_opposite_team(board[to])))
-                    moves.emplace_back(from, to);
-            }
-            ++y_value;
-        }
-    }
-    
-}
-
-/* A Mouse likes to hide: it can move to the two corners of the row its in and the
-* surrounding rows, and to the cells adjacent to those corners. It can also retreat
-to the safety of its team's corners at anytime. If you really want to trouble it, though, 
-it can also move forward, but only to the cell directly in front of it. If an opponent's
-piece is in front of a Mouse, or in any of the Cells the Mouse can move to, it gets nibbled to death!
-*/
-
-void Mouse::get_moves(const Board& board, Cell from, vector<Move>& moves) const
-{
-    int forward = 0;
-    if (team == WHITE)
-        forward = 1;
-    else if (team == BLACK)
-        forward = -1;
-    Cell to = Cell(from.x, from.y + forward);
-    if (board.contains(to)&& (board[to] == EMPTY_SPACE || is_opposite_team(board[to]))) {
-        moves.emplace_back(from, to);
-    }
-    // add corners and adjacent cells for the three rows
-
-    to = Cell(0, from.y);
-    if (board.contains(to) && (board[to] == EMPTY_SPACE || is_opposite_team(board[to])))       
-        moves.emplace_back(from, to);
-
-    to = Cell(7, from.y);
-    if (board.contains(to) && (board[to] == EMPTY_SPACE || is_opposite_team(board[to])))
-        moves.emplace_back(from, to);
-
-    to = Cell(0, from.y + 1);
-    if (board.contains(to) && (board[to] == EMPTY_SPACE || is_opposite_team(board[to])))
-        moves.emplace_back(from, to);
-
-    to = Cell(7, from.y + 1);
-    if (board.contains(to) && (board[to] == EMPTY_SPACE || is_opposite_team(board[to])))
-        moves.emplace_back(from, to);
-
-    to = Cell(0, from.y - 1);
-    if (board.contains(to) && (board[to] == EMPTY_SPACE || is_opposite_team(board[to])))
-        moves.emplace_back(from, to);
-
-    to = Cell(7, from.y - 1);
-    if (board.contains(to) && (board[to] == EMPTY_SPACE || is_opposite_team(board[to])))
-        moves.emplace_back(from, to);
-
-    Cell to2;
-    if (team == WHITE) {
-        to  = Cell(0, 0);
-        to2 = Cell(7, 0);
-       if((board[to] == EMPTY_SPACE || is_opposite_team(board[to])))
-        moves.emplace_back(from, to);
-       if(board[to2] == EMPTY_SPACE || is_opposite_team(board[to2]))
-        moves.emplace_back(from, to2);
-
-    }
-    if (team == BLACK)
-    {
-        to  = Cell(0, 7);
-        to2 = Cell(7, 7);
-        if ((board[to] == EMPTY_SPACE || is_opposite_team(board[to])))
-            moves.emplace_back(from, to);
-        if (board[to2] == EMPTY_SPACE || is_opposite_team(board[to2]))
-            moves.emplace_back(from, to2);
-    }
-}
-
-
-
-const EmptySpace EMPTY_SPACE;
-const King WHITE_KING(U'♔', WHITE);
-const King BLACK_KING(U'♚', BLACK);
-const Queen WHITE_QUEEN(U'♕', WHITE);
-const Queen BLACK_QUEEN(U'♛', BLACK);
-const Bishop WHITE_BISHOP(U'♗', WHITE);
-const Bishop BLACK_BISHOP(U'♝', BLACK);
-const Knight WHITE_KNIGHT(U'♘', WHITE);
-const Knight BLACK_KNIGHT(U'♞', BLACK);
-const Rook WHITE_ROOK(U'♖', WHITE);
-const Rook BLACK_ROOK(U'♜', BLACK);
-const Pawn WHITE_PAWN(U'♙', WHITE, 1);
-const Pawn BLACK_PAWN(U'♟', BLACK, -1);
-
-const BackBencher WHITE_BACKBENCHER(U'⛉', WHITE, 1);
-const BackBencher BLACK_BACKBENCHER(U'⛊', BLACK, -1);
-
-const Mouse WHITE_MOUSE(U'🐁', WHITE);
-const Mouse BLACK_MOUSE(U'🐀', BLACK);
-
-const map<UTF8CodePoint, const ChessPiece*> ALL_CHESS_PIECES = {
-  {EMPTY_SPACE.utf8_codepoint, &EMPTY_SPACE},
-  {WHITE_KING.utf8_codepoint, &WHITE_KING},
-  {BLACK_KING.utf8_codepoint, &BLACK_KING},
-  {WHITE_QUEEN.utf8_codepoint, &WHITE_QUEEN},
-  {BLACK_QUEEN.utf8_codepoint, &BLACK_QUEEN},
-  {WHITE_BISHOP.utf8_codepoint, &WHITE_BISHOP},
-  {BLACK_BISHOP.utf8_codepoint, &BLACK_BISHOP},
-  {WHITE_KNIGHT.utf8_codepoint, &WHITE_KNIGHT},
-  {BLACK_KNIGHT.utf8_codepoint, &BLACK_KNIGHT},
-  {WHITE_ROOK.utf8_codepoint, &WHITE_ROOK},
-  {BLACK_ROOK.utf8_codepoint, &BLACK_ROOK},
-  {WHITE_PAWN.utf8_codepoint, &WHITE_PAWN},
-  {BLACK_PAWN.utf8_codepoint, &BLACK_PAWN},
-    {WHITE_BACKBENCHER.utf8_codepoint, &WHITE_BACKBENCHER},
-    {BLACK_BACKBENCHER.utf8_codepoint, &BLACK_BACKBENCHER},
-    {WHITE_MOUSE.utf8_codepoint, &WHITE_MOUSE},
-    {BLACK_MOUSE.utf8_codepoint, &BLACK_MOUSE}
-};
\ No newline at end of file
+#include <algorithm>
+#include <initializer_list>
+#include <mutex>
+#include <stdexcept>
+
+#include "utf8_codepoint.h"
+#include "chess_eval.h"
+#include "chess_pieces.h"
+#include "piece_registry.h"
+
+using std::lock_guard;
+using std::mutex;
+using std::out_of_range;
+
+
+bool ChessPiece::is_opposite_team(const ChessPiece& other) const {
+    return (team == WHITE && other.team == BLACK) || (team == BLACK && other.team == WHITE);
+}
+
+bool ChessPiece::operator==(const ChessPiece& other) const {
+    return utf8_codepoint == other.utf8_codepoint;
+}
+bool ChessPiece::operator!=(const ChessPiece& other) const {
+    return utf8_codepoint != other.utf8_codepoint;
+}
+
+ostream& operator<<(ostream& os, const ChessPiece& p) {
+    return os << p.utf8_codepoint;
+}
+
+bool ChessPiece::can_move_onto(const ChessPiece& target, MoveKind kind) const {
+    if (target.type == EMPTY) {
+        return (kind & QUIET_MOVES) != 0;
+    }
+    return (kind & CAPTURES) != 0 && is_opposite_team(target);
+}
+
+void ChessPiece::get_moves_of_kind(const Board& board, Cell from, MoveKind kind, vector<Move>& moves) const {
+    size_t first = moves.size();
+    get_moves(board, from, moves);
+    if (kind == ALL_MOVES) {
+        return;
+    }
+    moves.erase(std::remove_if(moves.begin() + first, moves.end(), [&](Move move) {
+        return !can_move_onto(board[move.to], kind);
+    }), moves.end());
+}
+
+void SimpleChessPiece::make_move(Board& board, Move move) const {
+    board.make_classical_chess_move(move);
+}
+
+void King::get_moves_of_kind(const Board& board, Cell from, MoveKind kind, vector<Move>& moves) const {
+    for (int x = from.x - 1; x < from.x + 2; ++x) {
+        for (int y = from.y - 1; y < from.y + 2; ++y) {
+            Cell to(x, y);
+            if (from != to && board.contains(to)
+                && can_move_onto(board[to], kind)) {
+                moves.emplace_back(from, to);
+            }
+        }
+    }
+}
+
+void Queen::get_moves_of_kind(const Board& board, Cell from, MoveKind kind, vector<Move>& moves) const {
+    // The 8 directions a queen can go...
+    Cell directions[] = {
+      {-1,  1}, {0,  1}, {1,  1},
+      {-1,  0},          {1,  0},
+      {-1, -1}, {0, -1}, {1, -1},
+    };
+    for (Cell direction : directions) {
+        for (int steps = 1; ; ++steps) {
+            Cell to(from.x + steps * direction.x, from.y + steps * direction.y);
+            if (!board.contains(to)) {
+                break;
+            }
+            const ChessPiece& piece = board[to];
+            if (piece == EMPTY_SPACE) {
+                if (kind & QUIET_MOVES) {
+                    moves.emplace_back(from, to);
+                }
+            }
+            else if (is_opposite_team(piece)) {
+                if (kind & CAPTURES) {
+                    moves.emplace_back(from, to);
+                }
+                break;
+            }
+            else {  // if (team == piece.team)
+                break;
+            }
+        }
+    }
+}
+
+void Bishop::get_moves_of_kind(const Board& board, Cell from, MoveKind kind, vector<Move>& moves) const {
+    // The 4 directions a bishop can go...
+    Cell directions[] = {
+      {-1,  1}, {1,  1},
+      {-1, -1}, {1, -1},
+    };
+    for (Cell direction : directions) {
+        for (int steps = 1; ; ++steps) {
+            Cell to(from.x + steps * direction.x, from.y + steps * direction.y);
+            if (!board.contains(to)) {
+                break;
+            }
+            const ChessPiece& piece = board[to];
+            if (piece == EMPTY_SPACE) {
+                if (kind & QUIET_MOVES) {
+                    moves.emplace_back(from, to);
+                }
+            }
+            else if (is_opposite_team(piece)) {
+                if (kind & CAPTURES) {
+                    moves.emplace_back(from, to);
+                }
+                break;
+            }
+            else {  // if (team == piece.team)
+                break;
+            }
+        }
+    }
+}
+
+void Knight::get_moves_of_kind(const Board& board, Cell from, MoveKind kind, vector<Move>& moves) const {
+    Cell jumps[] = {
+           {-1,  2}, {1,  2},
+      {-2,  1},          {2,  1},
+      {-2, -1},          {2, -1},
+           {-1, -2}, {1, -2},
+    };
+    for (Cell jump : jumps) {
+        Cell to(from.x + jump.x, from.y + jump.y);
+        if (board.contains(to)) {
+            const ChessPiece& piece = board[to];
+            if (can_move_onto(piece, kind)) {
+                moves.emplace_back(from, to);
+            }
+        }
+    }
+}
+
+void Rook::get_moves_of_kind(const Board& board, Cell from, MoveKind kind, vector<Move>& moves) const {
+    // The 4 directions a rook can go...
+    Cell directions[] = {
+                {0,  1},
+      {-1,  0},          {1,  0},
+                {0, -1},
+    };
+    for (Cell direction : directions) {
+        for (int steps = 1; ; ++steps) {
+            Cell to(from.x + steps * direction.x, from.y + steps * direction.y);
+            if (!board.contains(to)) {
+                break;
+            }
+            const ChessPiece& piece = board[to];
+            if (piece == EMPTY_SPACE) {
+                if (kind & QUIET_MOVES) {
+                    moves.emplace_back(from, to);
+                }
+            }
+            else if (is_opposite_team(piece)) {
+                if (kind & CAPTURES) {
+                    moves.emplace_back(from, to);
+                }
+                break;
+            }
+            else {  // if (team == piece.team)
+                break;
+            }
+        }
+    }
+}
+
+void Pawn::get_moves_of_kind(const Board& board, Cell from, MoveKind kind, vector<Move>& moves) const {
+    Cell to = Cell(from.x, from.y + y_move_steps);
+    if ((kind & QUIET_MOVES) && board.contains(to) && board[to] == EMPTY_SPACE) {
+        moves.emplace_back(from, to);
+    }
+
+    to = Cell(from.x - 1, from.y + y_move_steps);
+    if ((kind & CAPTURES) && board.contains(to) && is_opposite_team(board[to])) {
+        moves.emplace_back(from, to);
+    }
+
+    to = Cell(from.x + 1, from.y + y_move_steps);
+    if ((kind & CAPTURES) && board.contains(to) && is_opposite_team(board[to])) {
+        moves.emplace_back(from, to);
+    }
+}
+
+/*
+*
+* A BackBencher can move to any cell in any of the rows behind it, and can
+* remove an opponent's piece in the process.
+* While moving forward, a BackBencher behaves exactly like a regular Pawn.
+*
+*/
+
+void BackBencher::get_moves_of_kind(const Board& board, Cell from, MoveKind kind, vector<Move>& moves) const {
+   
+    Cell to = Cell(from.x, from.y + forward_steps);
+    if ((kind & QUIET_MOVES) && board.contains(to) && board[to] == EMPTY_SPACE) {
+        moves.emplace_back(from, to);
+    }
+
+    to = Cell(from.x - 1, from.y + forward_steps);
+    if ((kind & CAPTURES) && board.contains(to) && is_opposite_team(board[to])) {
+        moves.emplace_back(from, to);
+    }
+
+    to = Cell(from.x + 1, from.y + forward_steps);
+    if ((kind & CAPTURES) && board.contains(to) && is_opposite_team(board[to])) {
+        moves.emplace_back(from, to);
+    }
+    // black is at   top  of the board
+    // white is at bottom of the board
+    if (team == WHITE)
+    {
+        if (from.y == 0) // the BackBencher is already all the way at the back of the board
+            return;
+        int y_value = from.y-1;
+        Cell to;
+        while (y_value >= 0)
+        {
+            for (int i = 0; i < 8; ++i)
+            {
+                to = Cell(i, y_value);
+                if (board.contains(to) && can_move_onto(board[to], kind)) // only a valid move if cell is empty/has opponent's piece
+                    moves.emplace_back(from, to);
+            }
+            --y_value;
+        }
+    }
+    if (team == BLACK)
+    {
+        if (from.y == 8)
+            return;
+        int y_value = from.y + 1;
+        Cell to;
+        while (y_value <= 8) // the BackBencher is already all the way at the back of the board
+        {
+            for (int i = 0; i < 8; ++i)
+            {
+                to = Cell(i, y_value);
+                if (board.contains(to) && can_move_onto(board[to], kind))
+                    moves.emplace_back(from, to);
+            }
+            ++y_value;
+        }
+    }
+    
+}
+
+/* A Mouse likes to hide: it can move to the two corners of the row its in and the
+* surrounding rows, and to the cells adjacent to those corners. It can also retreat
+to the safety of its team's corners at anytime. If you really want to trouble it, though, 
+it can also move forward, but only to the cell directly in front of it. If an opponent's
+piece is in front of a Mouse, or in any of the Cells the Mouse can move to, it gets nibbled to death!
+*/
+
+void Mouse::get_moves_of_kind(const Board& board, Cell from, MoveKind kind, vector<Move>& moves) const
+{
+    int forward = 0;
+    if (team == WHITE)
+        forward = 1;
+    else if (team == BLACK)
+        forward = -1;
+    Cell to = Cell(from.x, from.y + forward);
+    if (board.contains(to)&& can_move_onto(board[to], kind)) {
+        moves.emplace_back(from, to);
+    }
+    // add corners and adjacent cells for the three rows
+
+    to = Cell(0, from.y);
+    if (board.contains(to) && can_move_onto(board[to], kind))       
+        moves.emplace_back(from, to);
+
+    to = Cell(7, from.y);
+    if (board.contains(to) && can_move_onto(board[to], kind))
+        moves.emplace_back(from, to);
+
+    to = Cell(0, from.y + 1);
+    if (board.contains(to) && can_move_onto(board[to], kind))
+        moves.emplace_back(from, to);
+
+    to = Cell(7, from.y + 1);
+    if (board.contains(to) && can_move_onto(board[to], kind))
+        moves.emplace_back(from, to);
+
+    to = Cell(0, from.y - 1);
+    if (board.contains(to) && can_move_onto(board[to], kind))
+        moves.emplace_back(from, to);
+
+    to = Cell(7, from.y - 1);
+    if (board.contains(to) && can_move_onto(board[to], kind))
+        moves.emplace_back(from, to);
+
+    Cell to2;
+    if (team == WHITE) {
+        to  = Cell(0, 0);
+        to2 = Cell(7, 0);
+       if(can_move_onto(board[to], kind))
+        moves.emplace_back(from, to);
+       if(can_move_onto(board[to2], kind))
+        moves.emplace_back(from, to2);
+
+    }
+    if (team == BLACK)
+    {
+        to  = Cell(0, 7);
+        to2 = Cell(7, 7);
+        if (can_move_onto(board[to], kind))
+            moves.emplace_back(from, to);
+        if (can_move_onto(board[to2], kind))
+            moves.emplace_back(from, to2);
+    }
+}
+
+// The attacks of a piece that slides in each of directions until it hits
+// a piece (which it attacks, whichever team it's on) or the edge.
+static void add_sliding_attacks(const Board& board, Cell from, const Cell* directions, int num_directions, vector<Cell>& attacks) {
+    int width = board.width(), height = board.height();
+    const uint8_t* codes = board.piece_codes();
+    for (int i = 0; i < num_directions; ++i) {
+        Cell to(from.x + directions[i].x, from.y + directions[i].y);
+        for (; to.x >= 0 && to.x < width && to.y >= 0 && to.y < height; to.x += directions[i].x, to.y += directions[i].y) {
+            attacks.push_back(to);
+            if (codes[to.y * width + to.x] != EMPTY_SPACE.code) {
+                break;
+            }
+        }
+    }
+}
+
+// Adds each of cells that is on the board and isn't from.
+static void add_attacks(const Board& board, Cell from, std::initializer_list<Cell> cells, vector<Cell>& attacks) {
+    for (Cell to : cells) {
+        if (to != from && board.contains(to)) {
+            attacks.push_back(to);
+        }
+    }
+}
+
+void King::get_attacks(const Board& board, Cell from, vector<Cell>& attacks) const {
+    for (int x = from.x - 1; x < from.x + 2; ++x) {
+        for (int y = from.y - 1; y < from.y + 2; ++y) {
+            add_attacks(board, from, { Cell(x, y) }, attacks);
+        }
+    }
+}
+
+void Queen::get_attacks(const Board& board, Cell from, vector<Cell>& attacks) const {
+    static const Cell directions[] = {
+      {-1,  1}, {0,  1}, {1,  1},
+      {-1,  0},          {1,  0},
+      {-1, -1}, {0, -1}, {1, -1},
+    };
+    add_sliding_attacks(board, from, directions, 8, attacks);
+}
+
+void Bishop::get_attacks(const Board& board, Cell from, vector<Cell>& attacks) const {
+    static const Cell directions[] = {
+      {-1,  1}, {1,  1},
+      {-1, -1}, {1, -1},
+    };
+    add_sliding_attacks(board, from, directions, 4, attacks);
+}
+
+void Knight::get_attacks(const Board& board, Cell from, vector<Cell>& attacks) const {
+    add_attacks(board, from, {
+        Cell(from.x - 1, from.y + 2), Cell(from.x + 1, from.y + 2),
+        Cell(from.x - 2, from.y + 1), Cell(from.x + 2, from.y + 1),
+        Cell(from.x - 2, from.y - 1), Cell(from.x + 2, from.y - 1),
+        Cell(from.x - 1, from.y - 2), Cell(from.x + 1, from.y - 2),
+    }, attacks);
+}
+
+void Rook::get_attacks(const Board& board, Cell from, vector<Cell>& attacks) const {
+    static const Cell directions[] = {
+                {0,  1},
+      {-1,  0},          {1,  0},
+                {0, -1},
+    };
+    add_sliding_attacks(board, from, directions, 4, attacks);
+}
+
+void Pawn::get_attacks(const Board& board, Cell from, vector<Cell>& attacks) const {
+    add_attacks(board, from, { Cell(from.x - 1, from.y + y_move_steps), Cell(from.x + 1, from.y + y_move_steps) }, attacks);
+}
+
+void BackBencher::get_attacks(const Board& board, Cell from, vector<Cell>& attacks) const {
+    add_attacks(board, from, { Cell(from.x - 1, from.y + forward_steps), Cell(from.x + 1, from.y + forward_steps) }, attacks);
+    // Every cell of the rows behind it, as far as get_moves looks.
+    for (int y = from.y - forward_steps; y >= 0 && y < board.height(); y -= forward_steps) {
+        for (int x = 0; x < 8; ++x) {
+            add_attacks(board, from, { Cell(x, y) }, attacks);
+        }
+    }
+}
+
+void Mouse::get_attacks(const Board& board, Cell from, vector<Cell>& attacks) const {
+    int forward = team == WHITE ? 1 : -1;
+    int home_row = team == WHITE ? 0 : 7;
+    Cell targets[] = {
+        Cell(from.x, from.y + forward),
+        Cell(0, from.y), Cell(7, from.y),
+        Cell(0, from.y + 1), Cell(7, from.y + 1),
+        Cell(0, from.y - 1), Cell(7, from.y - 1),
+        Cell(0, home_row), Cell(7, home_row),
+    };
+    // Near its home row the corners come up more than once, but each cell
+    // is only attacked once.
+    size_t first = attacks.size();
+    for (Cell to : targets) {
+        if (std::find(attacks.begin() + first, attacks.end(), to) == attacks.end()) {
+            add_attacks(board, from, { to }, attacks);
+        }
+    }
+}
+
+
+const EmptySpace EMPTY_SPACE;
+const King WHITE_KING(PIECE_GLYPHS[KING], WHITE);
+const King BLACK_KING(PIECE_GLYPHS[NUM_PIECE_TYPES + KING], BLACK);
+const Queen WHITE_QUEEN(PIECE_GLYPHS[QUEEN], WHITE);
+const Queen BLACK_QUEEN(PIECE_GLYPHS[NUM_PIECE_TYPES + QUEEN], BLACK);
+const Bishop WHITE_BISHOP(PIECE_GLYPHS[BISHOP], WHITE);
+const Bishop BLACK_BISHOP(PIECE_GLYPHS[NUM_PIECE_TYPES + BISHOP], BLACK);
+const Knight WHITE_KNIGHT(PIECE_GLYPHS[KNIGHT], WHITE);
+const Knight BLACK_KNIGHT(PIECE_GLYPHS[NUM_PIECE_TYPES + KNIGHT], BLACK);
+const Rook WHITE_ROOK(PIECE_GLYPHS[ROOK], WHITE);
+const Rook BLACK_ROOK(PIECE_GLYPHS[NUM_PIECE_TYPES + ROOK], BLACK);
+const Pawn WHITE_PAWN(PIECE_GLYPHS[PAWN], WHITE, 1);
+const Pawn BLACK_PAWN(PIECE_GLYPHS[NUM_PIECE_TYPES + PAWN], BLACK, -1);
+
+const BackBencher WHITE_BACKBENCHER(PIECE_GLYPHS[BACKBENCHER], WHITE, 1);
+const BackBencher BLACK_BACKBENCHER(PIECE_GLYPHS[NUM_PIECE_TYPES + BACKBENCHER], BLACK, -1);
+
+const Mouse WHITE_MOUSE(PIECE_GLYPHS[MOUSE], WHITE);
+const Mouse BLACK_MOUSE(PIECE_GLYPHS[NUM_PIECE_TYPES + MOUSE], BLACK);
+
+const ChessPiece* const BUILT_IN_PIECES[NUM_PIECE_CODES] = {
+    &EMPTY_SPACE, &WHITE_PAWN, &WHITE_KNIGHT, &WHITE_BISHOP, &WHITE_ROOK,
+    &WHITE_QUEEN, &WHITE_KING, &WHITE_BACKBENCHER, &WHITE_MOUSE,
+    nullptr, &BLACK_PAWN, &BLACK_KNIGHT, &BLACK_BISHOP, &BLACK_ROOK,
+    &BLACK_QUEEN, &BLACK_KING, &BLACK_BACKBENCHER, &BLACK_MOUSE,
+};
+
+uint8_t PIECE_CODE_TYPES[MAX_PIECE_CODES] = {
+    EMPTY, PAWN, KNIGHT, BISHOP, ROOK, QUEEN, KING, BACKBENCHER, MOUSE,
+    EMPTY, PAWN, KNIGHT, BISHOP, ROOK, QUEEN, KING, BACKBENCHER, MOUSE,
+};
+uint8_t PIECE_CODE_TEAMS[MAX_PIECE_CODES] = {
+    NONE, WHITE, WHITE, WHITE, WHITE, WHITE, WHITE, WHITE, WHITE,
+    NONE, BLACK, BLACK, BLACK, BLACK, BLACK, BLACK, BLACK, BLACK,
+};
+
+uint8_t new_piece_code(PieceType type, Team team) {
+    static mutex codes_mutex;
+    static int next_code = NUM_PIECE_CODES;
+    lock_guard<mutex> lock(codes_mutex);
+    if (next_code == MAX_PIECE_CODES) {
+        throw out_of_range("new_piece_code: every piece code is taken");
+    }
+    int code = next_code++;
+    PIECE_CODE_TYPES[code] = static_cast<uint8_t>(type);
+    PIECE_CODE_TEAMS[code] = static_cast<uint8_t>(team);
+    update_piece_code_scores(code);
+    return static_cast<uint8_t>(code);
+}
+
+const ChessPiece* piece_with_code(int code) {
+    if (code < 0 || code >= MAX_PIECE_CODES) {
+        return nullptr;
+    }
+    if (code < NUM_PIECE_CODES) {
+        return BUILT_IN_PIECES[code];
+    }
+    return piece_registry().piece(code);
+}
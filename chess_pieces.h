@@ -1,141 +1,272 @@
-#ifndef _CHESS_PIECES_H_
-#define _CHESS_PIECES_H_
-
-#include <iostream>
-#include <map>
-#include <vector>
-
-#include "utf8_codepoint.h"
-#include "chess_board.h"
-
-using std::istream;
-using std::map;
-using std::ostream;
-using std::vector;
-
-class ChessPiece {
-public:
-    const UTF8CodePoint utf8_codepoint;
-    const Team team;
-
-    ChessPiece(UTF8CodePoint cp, Team team) : utf8_codepoint(cp), team(team) {}
-
-    virtual ~ChessPiece() {}
-
-    virtual void get_moves(const Board& board, Cell from, vector<Move>& moves) const = 0;
-    virtual void make_move(Board& board, Move move) const = 0;
-
-    bool is_opposite_team(const ChessPiece& other) const;
-
-    bool operator==(const ChessPiece& other) const;
-    bool operator!=(const ChessPiece& other) const;
-
-    friend ostream& operator<<(ostream& os, const ChessPiece& p);
-};
-
-ostream& operator<<(ostream& os, const ChessPiece& p);
-
-class EmptySpace : public ChessPiece {
-public:
-    EmptySpace() : ChessPiece('.', NONE) {}
-    void get_moves(const Board& board, Cell from, vector<Move>& moves) const override {}
-    void make_move(Board& board, Move move) const override {}
-};
-
-
-class SimpleChessPiece : public ChessPiece {
-public:
-    SimpleChessPiece(UTF8CodePoint cp, Team team) : ChessPiece(cp, team) {}
-    void make_move(Board& board, Move move) const;
-};
-
-class King : public SimpleChessPiece {
-public:
-    King(UTF8CodePoint cp, Team team) : SimpleChessPiece(cp, team) {}
-    void get_moves(const Board& board, Cell from, vector<Move>& moves) const override;
-};
-
-class Queen : public SimpleChessPiece {
-public:
-    Queen(UTF8CodePoint cp, Team team) : SimpleChessPiece(cp, team) {}
-    void get_moves(const Board& board, Cell from, vector<Move>& moves) const override;
-};
-
-class Bishop : public SimpleChessPiece {
-public:
-    Bishop(UTF8CodePoint cp, Team team) : SimpleChessPiece(cp, team) {}
-    void get_moves(const Board& board, Cell from, vector<Move>& moves) const override;
-};
-
-class Knight : public SimpleChessPiece {
-public:
-    Knight(UTF8CodePoint cp, Team team) : SimpleChessPiece(cp, team) {}
-    void get_moves(const Board& board, Cell from, vector<Move>& moves) const override;
-};
-
-class Rook : public SimpleChessPiece {
-public:
-    Rook(UTF8CodePoint cp, Team team) : SimpleChessPiece(cp, team) {}
-    void get_moves(const Board& board, Cell from, vector<Move>& moves) const override;
-};
-
-class Pawn : public SimpleChessPiece {
-    int y_move_steps;
-public:
-    Pawn(UTF8CodePoint cp, Team team, int y_move_steps)
-        : SimpleChessPiece(cp, team), y_move_steps(y_move_steps) {}
-    void get_moves(const Board& board, Cell from, vector<Move>& moves) const override;
-};
-
-/*
-*
-* A BackBencher can move to any cell in any of the rows behind it, and can 
-* remove an opponent's piece in the process.
-* While moving forward, a BackBencher behaves exactly like a regular Pawn.
-*
-*/
-
-class BackBencher : public SimpleChessPiece {
-    int forward_steps;
-public:
-    BackBencher(UTF8CodePoint cp, Team team, int forward_steps) : SimpleChessPiece(cp, team), forward_steps(forward_steps) {}
-    void get_moves(const Board& board, Cell from, vector<Move>& moves) const override;
-};
-
-/* A Mouse likes to hide: it can move to the two corners of the row its in and the
-* surrounding rows, and to the cells adjacent to those corners. It can also retreat
-to the safety of its team's corners at anytime. If you really want to trouble it, though,
-it can also move forward, but only to the cell directly in front of it. If an opponent's
-piece is in front of a Mouse, or in any of the Cells the Mouse can move to, it gets nibbled to death!
-*/
-class Mouse : public SimpleChessPiece {
-public:
-    Mouse(UTF8CodePoint cp, Team team) : SimpleChessPiece(cp, team) {}
-    void get_moves(const Board& board, Cell from, vector<Move>& moves) const override;
-};
-
-// `extern` is used to declare the variables here, without defining them
-// The actual variables/objects are defined in the corresponding .cpp file.
-extern const EmptySpace EMPTY_SPACE;
-extern const King WHITE_KING;
-extern const King BLACK_KING;
-extern const Queen WHITE_QUEEN;
-extern const Queen BLACK_QUEEN;
-extern const Bishop WHITE_BISHOP;
-extern const Bishop BLACK_BISHOP;
-extern const Knight WHITE_KNIGHT;
-extern const Knight BLACK_KNIGHT;
-extern const Rook WHITE_ROOK;
-extern const Rook BLACK_ROOK;
-extern const Pawn WHITE_PAWN;
-extern const Pawn BLACK_PAWN;
-
-extern const BackBencher WHITE_BACKBENCHER;
-extern const BackBencher BLACK_BACKBENCHER;
-
-extern const Mouse WHITE_MOUSE;
-extern const Mouse BLACK_MOUSE;
-
-extern const map<UTF8CodePoint, const ChessPiece*> ALL_CHESS_PIECES;
-
-#endif  // _CHESS_PIECES_H_#pragma once
+#ifndef _CHESS_PIECES_H_
+#define _CHESS_PIECES_H_
+
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "utf8_codepoint.h"
+#include "chess_board.h"
+
+using std::istream;
+using std::ostream;
+using std::vector;
+
+// The kind of a piece, independent of its team. Evaluation tables are indexed
+// by this (see chess_eval.h), so custom pieces need their own entry here.
+enum PieceType {
+    EMPTY,
+    PAWN,
+    KNIGHT,
+    BISHOP,
+    ROOK,
+    QUEEN,
+    KING,
+    BACKBENCHER,
+    MOUSE,
+    NUM_PIECE_TYPES
+};
+
+// A piece code combines the type and the team into one small integer, so a
+// board can be stored as an array of bytes: white pieces use their type and
+// black pieces use their type + NUM_PIECE_TYPES.
+const int NUM_PIECE_CODES = 2 * NUM_PIECE_TYPES;
+
+// Custom pieces (like DefinedPiece) get codes of their own from
+// NUM_PIECE_CODES up (see new_piece_code), so every piece on a board can be
+// told apart by its code. Codes are stored in bytes, so there are at most
+// MAX_PIECE_CODES of them, and that's how big tables indexed by code are.
+const int MAX_PIECE_CODES = 256;
+
+// The type and team of every piece code. Codes no piece has yet are EMPTY
+// and NONE.
+extern uint8_t PIECE_CODE_TYPES[MAX_PIECE_CODES];
+extern uint8_t PIECE_CODE_TEAMS[MAX_PIECE_CODES];
+
+inline PieceType code_type(int code) {
+    return static_cast<PieceType>(PIECE_CODE_TYPES[code]);
+}
+
+inline Team code_team(int code) {
+    return static_cast<Team>(PIECE_CODE_TEAMS[code]);
+}
+
+// The code of the built-in piece with code's type and team. Custom pieces
+// are evaluated as the built-in piece of their type, so tables that only
+// know the built-in pieces (like the network's inputs) look them up by this.
+inline int type_code(int code) {
+    return code_team(code) == BLACK ? code_type(code) + NUM_PIECE_TYPES : code_type(code);
+}
+
+// Gives a custom piece of type and team the next unused code, and fills in
+// that code's entries in the tables indexed by code (including the
+// evaluation tables). Codes are never given back, so make custom pieces once,
+// before other threads start using those tables. Throws out_of_range once
+// every code has been given out.
+uint8_t new_piece_code(PieceType type, Team team);
+
+// The glyph of each built-in piece, by piece code. Black has no empty space,
+// so that code has no glyph.
+constexpr char32_t PIECE_GLYPHS[NUM_PIECE_CODES] = {
+    U'.', U'♙', U'♘', U'♗', U'♖', U'♕', U'♔', U'⛉', U'🐁',
+    0, U'♟', U'♞', U'♝', U'♜', U'♛', U'♚', U'⛊', U'🐀',
+};
+
+// Which moves to generate: quiet moves go to empty cells and captures take
+// a piece of the other team.
+enum MoveKind {
+    QUIET_MOVES = 1,
+    CAPTURES = 2,
+    ALL_MOVES = QUIET_MOVES | CAPTURES,
+};
+
+class ChessPiece {
+public:
+    const UTF8CodePoint utf8_codepoint;
+    const Team team;
+    const PieceType type;
+    const uint8_t code;
+
+    ChessPiece(UTF8CodePoint cp, Team team, PieceType type)
+        : utf8_codepoint(cp), team(team), type(type),
+          code(static_cast<uint8_t>(team == BLACK ? type + NUM_PIECE_TYPES : type)) {}
+    // A custom piece, with a code from new_piece_code.
+    ChessPiece(UTF8CodePoint cp, Team team, PieceType type, uint8_t code)
+        : utf8_codepoint(cp), team(team), type(type), code(code) {}
+
+    virtual ~ChessPiece() {}
+
+    virtual void get_moves(const Board& board, Cell from, vector<Move>& moves) const = 0;
+    virtual void make_move(Board& board, Move move) const = 0;
+    // Just the moves of kind, for callers like capture searches that would
+    // throw the rest away. By default this filters get_moves; the built-in
+    // pieces only generate the moves asked for.
+    virtual void get_moves_of_kind(const Board& board, Cell from, MoveKind kind, vector<Move>& moves) const;
+    // The cells this piece attacks from `from`: every cell it could capture on
+    // if the other team had a piece there, including cells its own team holds.
+    virtual void get_attacks(const Board& board, Cell from, vector<Cell>& attacks) const = 0;
+    // True if get_attacks depends on which cells are occupied, like a rook's
+    // attacks stopping at the first piece in the way. Board's attack maps only
+    // recompute these pieces' attacks when a cell fills up or empties.
+    virtual bool has_sliding_attacks() const { return false; }
+
+    bool is_opposite_team(const ChessPiece& other) const;
+    // True if a move of kind can end on a cell holding target.
+    bool can_move_onto(const ChessPiece& target, MoveKind kind) const;
+
+    bool operator==(const ChessPiece& other) const;
+    bool operator!=(const ChessPiece& other) const;
+
+    friend ostream& operator<<(ostream& os, const ChessPiece& p);
+};
+
+ostream& operator<<(ostream& os, const ChessPiece& p);
+
+class EmptySpace : public ChessPiece {
+public:
+    EmptySpace() : ChessPiece(PIECE_GLYPHS[EMPTY], NONE, EMPTY) {}
+    void get_moves(const Board& board, Cell from, vector<Move>& moves) const override {}
+    void get_moves_of_kind(const Board& board, Cell from, MoveKind kind, vector<Move>& moves) const override {}
+    void make_move(Board& board, Move move) const override {}
+    void get_attacks(const Board& board, Cell from, vector<Cell>& attacks) const override {}
+};
+
+
+class SimpleChessPiece : public ChessPiece {
+public:
+    SimpleChessPiece(UTF8CodePoint cp, Team team, PieceType type) : ChessPiece(cp, team, type) {}
+    SimpleChessPiece(UTF8CodePoint cp, Team team, PieceType type, uint8_t code) : ChessPiece(cp, team, type, code) {}
+    void make_move(Board& board, Move move) const;
+};
+
+class King : public SimpleChessPiece {
+public:
+    King(UTF8CodePoint cp, Team team) : SimpleChessPiece(cp, team, KING) {}
+    void get_moves(const Board& board, Cell from, vector<Move>& moves) const override {
+        get_moves_of_kind(board, from, ALL_MOVES, moves);
+    }
+    void get_moves_of_kind(const Board& board, Cell from, MoveKind kind, vector<Move>& moves) const override;
+    void get_attacks(const Board& board, Cell from, vector<Cell>& attacks) const override;
+};
+
+class Queen : public SimpleChessPiece {
+public:
+    Queen(UTF8CodePoint cp, Team team) : SimpleChessPiece(cp, team, QUEEN) {}
+    void get_moves(const Board& board, Cell from, vector<Move>& moves) const override {
+        get_moves_of_kind(board, from, ALL_MOVES, moves);
+    }
+    void get_moves_of_kind(const Board& board, Cell from, MoveKind kind, vector<Move>& moves) const override;
+    void get_attacks(const Board& board, Cell from, vector<Cell>& attacks) const override;
+    bool has_sliding_attacks() const override { return true; }
+};
+
+class Bishop : public SimpleChessPiece {
+public:
+    Bishop(UTF8CodePoint cp, Team team) : SimpleChessPiece(cp, team, BISHOP) {}
+    void get_moves(const Board& board, Cell from, vector<Move>& moves) const override {
+        get_moves_of_kind(board, from, ALL_MOVES, moves);
+    }
+    void get_moves_of_kind(const Board& board, Cell from, MoveKind kind, vector<Move>& moves) const override;
+    void get_attacks(const Board& board, Cell from, vector<Cell>& attacks) const override;
+    bool has_sliding_attacks() const override { return true; }
+};
+
+class Knight : public SimpleChessPiece {
+public:
+    Knight(UTF8CodePoint cp, Team team) : SimpleChessPiece(cp, team, KNIGHT) {}
+    void get_moves(const Board& board, Cell from, vector<Move>& moves) const override {
+        get_moves_of_kind(board, from, ALL_MOVES, moves);
+    }
+    void get_moves_of_kind(const Board& board, Cell from, MoveKind kind, vector<Move>& moves) const override;
+    void get_attacks(const Board& board, Cell from, vector<Cell>& attacks) const override;
+};
+
+class Rook : public SimpleChessPiece {
+public:
+    Rook(UTF8CodePoint cp, Team team) : SimpleChessPiece(cp, team, ROOK) {}
+    void get_moves(const Board& board, Cell from, vector<Move>& moves) const override {
+        get_moves_of_kind(board, from, ALL_MOVES, moves);
+    }
+    void get_moves_of_kind(const Board& board, Cell from, MoveKind kind, vector<Move>& moves) const override;
+    void get_attacks(const Board& board, Cell from, vector<Cell>& attacks) const override;
+    bool has_sliding_attacks() const override { return true; }
+};
+
+class Pawn : public SimpleChessPiece {
+    int y_move_steps;
+public:
+    Pawn(UTF8CodePoint cp, Team team, int y_move_steps)
+        : SimpleChessPiece(cp, team, PAWN), y_move_steps(y_move_steps) {}
+    void get_moves(const Board& board, Cell from, vector<Move>& moves) const override {
+        get_moves_of_kind(board, from, ALL_MOVES, moves);
+    }
+    void get_moves_of_kind(const Board& board, Cell from, MoveKind kind, vector<Move>& moves) const override;
+    void get_attacks(const Board& board, Cell from, vector<Cell>& attacks) const override;
+};
+
+/*
+*
+* A BackBencher can move to any cell in any of the rows behind it, and can 
+* remove an opponent's piece in the process.
+* While moving forward, a BackBencher behaves exactly like a regular Pawn.
+*
+*/
+
+class BackBencher : public SimpleChessPiece {
+    int forward_steps;
+public:
+    BackBencher(UTF8CodePoint cp, Team team, int forward_steps) : SimpleChessPiece(cp, team, BACKBENCHER), forward_steps(forward_steps) {}
+    void get_moves(const Board& board, Cell from, vector<Move>& moves) const override {
+        get_moves_of_kind(board, from, ALL_MOVES, moves);
+    }
+    void get_moves_of_kind(const Board& board, Cell from, MoveKind kind, vector<Move>& moves) const override;
+    void get_attacks(const Board& board, Cell from, vector<Cell>& attacks) const override;
+};
+
+/* A Mouse likes to hide: it can move to the two corners of the row its in and the
+* surrounding rows, and to the cells adjacent to those corners. It can also retreat
+to the safety of its team's corners at anytime. If you really want to trouble it, though,
+it can also move forward, but only to the cell directly in front of it. If an opponent's
+piece is in front of a Mouse, or in any of the Cells the Mouse can move to, it gets nibbled to death!
+*/
+class Mouse : public SimpleChessPiece {
+public:
+    Mouse(UTF8CodePoint cp, Team team) : SimpleChessPiece(cp, team, MOUSE) {}
+    void get_moves(const Board& board, Cell from, vector<Move>& moves) const override {
+        get_moves_of_kind(board, from, ALL_MOVES, moves);
+    }
+    void get_moves_of_kind(const Board& board, Cell from, MoveKind kind, vector<Move>& moves) const override;
+    void get_attacks(const Board& board, Cell from, vector<Cell>& attacks) const override;
+};
+
+// `extern` is used to declare the variables here, without defining them
+// The actual variables/objects are defined in the corresponding .cpp file.
+extern const EmptySpace EMPTY_SPACE;
+extern const King WHITE_KING;
+extern const King BLACK_KING;
+extern const Queen WHITE_QUEEN;
+extern const Queen BLACK_QUEEN;
+extern const Bishop WHITE_BISHOP;
+extern const Bishop BLACK_BISHOP;
+extern const Knight WHITE_KNIGHT;
+extern const Knight BLACK_KNIGHT;
+extern const Rook WHITE_ROOK;
+extern const Rook BLACK_ROOK;
+extern const Pawn WHITE_PAWN;
+extern const Pawn BLACK_PAWN;
+
+extern const BackBencher WHITE_BACKBENCHER;
+extern const BackBencher BLACK_BACKBENCHER;
+
+extern const Mouse WHITE_MOUSE;
+extern const Mouse BLACK_MOUSE;
+
+// Every built-in piece, by ChessPiece::code (nullptr for codes no piece has).
+// To find pieces by glyph, or to add custom pieces, see piece_registry.h.
+extern const ChessPiece* const BUILT_IN_PIECES[NUM_PIECE_CODES];
+
+// The piece with this ChessPiece::code: a built-in piece, or a custom piece
+// added to piece_registry(). nullptr if there isn't one.
+const ChessPiece* piece_with_code(int code);
+
+#endif  // _CHESS_PIECES_H_#pragma once
@@ -1,300 +1,452 @@
-#include <algorithm>
-#include <chrono>
-#include <iostream>
-#include <random>
-
-#include "chess_board.h"
-#include "chess_pieces.h"
-#include "chess_player.h"
-
-using std::cin;
-using std::cout;
-using std::endl;
-using std::shuffle;
-using std::vector;
-
-const int POS_INF = 99999999;
-const int NEG_INF = -99999999;
-const char* Player::name() const {
-    return team_name(team);
-}
-
-
-RandomPlayer::RandomPlayer(Team team) : Player(team) {
-    // Initialize the pseudo-random number generator based on the current time,
-    // so it chooses different numbers when you run the code at different times.
-    random_number_generator.seed(
-        std::chrono::system_clock::now().time_since_epoch().count());
-}
-
-Move RandomPlayer::get_move(const Board& board, const vector<Move>& moves) const {
-    return moves[random_number_generator() % moves.size()];
-}
-
-AIPlayer::AIPlayer(Team team) : Player(team) {
-    // Initialize the pseudo-random number generator based on the current time,
-    // so it chooses different numbers when you run the code at different times.
-    random_number_generator.seed(
-        std::chrono::system_clock::now().time_since_epoch().count());
-}
-HumanPlayer::HumanPlayer(Team team) : Player(team) {}
-
-Move HumanPlayer::get_move(const Board& board, const vector<Move>& moves) const {
-    Move move;
-    while (true) {
-        cout << "What's your move?: ";
-        cin >> move;
-        cout << endl;
-        if (find(moves.begin(), moves.end(), move) != moves.end()) {
-            break;
-        }
-        cout << move << " is not a valid move! Please choose one of the following moves: \n";
-        for (Move valid_move : moves) {
-            cout << valid_move << ' ';
-        }
-        cout << endl;
-    }
-    return move;
-}
-
-CapturePlayer::CapturePlayer(Team team) : Player(team) {
-    // Initialize the pseudo-random number generator based on the current time,
-    // so it chooses different numbers when you run the code at different times.
-    random_number_generator.seed(
-        std::chrono::system_clock::now().time_since_epoch().count());
-}
-
-Move CapturePlayer::get_move(const Board& board, const vector<Move>& moves) const {
-    vector<Move> shuffled_moves = moves;
-    shuffle(shuffled_moves.begin(), shuffled_moves.end(), random_number_generator);
-    for (Move move : shuffled_moves) {
-        if (board[move.from].is_opposite_team(board[move.to])) {
-            return move;
-        }
-    }
-    return shuffled_moves[0];
-}
-
-CheckMateCapturePlayer::CheckMateCapturePlayer(Team team) : Player(team) {
-    // Initialize the pseudo-random number generator based on the current time,
-    // so it chooses different numbers when you run the code at different times.
-    random_number_generator.seed(
-        std::chrono::system_clock::now().time_since_epoch().count());
-}
-
-Move CheckMateCapturePlayer::get_move(const Board& board, const vector<Move>& moves) const {
-    vector<Move> shuffled_moves = moves;
-    shuffle(shuffled_moves.begin(), shuffled_moves.end(), random_number_generator);
-    for (Move move : shuffled_moves) {
-        if (board[move.from].is_opposite_team(board[move.to]) && (board[move.to] == WHITE_KING || board[move.to] == BLACK_KING)) {
-            return move;
-        }
-    }
-    for (Move move : shuffled_moves) {
-        if (board[move.from].is_opposite_team(board[move.to])) {
-            return move;
-        }
-    }
-    return shuffled_moves[0];
-}
-
-Move AIPlayer::get_move(const Board& board, const vector<Move>& moves) const
-{   
- 
-    vector<Move> shuffled_moves = moves;
-
-    if (shuffled_moves.size() > 0) {
-        Move best_move = shuffled_moves[0];
-        int best_score = team == WHITE ? NEG_INF : POS_INF;
-        for (Move move : shuffled_moves)
-        {
-            if (team == WHITE)
-            {
-                int x = minimax(board, move, 4, NEG_INF, POS_INF, false);
-              
-                if (x > best_score)
-                {
-                    best_move = move;
-                    best_score = x;
-                }
-            }
-            else
-            {
-                int x = minimax(board, move, 4, NEG_INF, POS_INF, true);
-                if (x < best_score)
-                {
-                    best_move = move;
-                    best_score = x;
-
-                }
-            }
-        }
-        return best_move;
-    }
-    return shuffled_moves[0];
-}
-
-
-
-int AIPlayer::minimax(const Board& b, Move move, int depth, int alpha, int beta, bool white) const
-{
-    Board b2 = b;
-    b2.make_move(move);
- 
-    if (depth == 1)
-    {
-     return eval(b2);
-    }
-
-    int eval;
-
-    if (white)
-    {
-        int maxEval = NEG_INF; // representative of - infinity
-
-            for (Move m : b2.get_moves())
-            {
-                eval = 0;
-                eval = minimax(b2, m, depth - 1, alpha, beta, false);       
-                maxEval = maxEval > eval ? maxEval : eval;
-                alpha = alpha > eval ? alpha : eval;
-              if (beta <= alpha)
-                   break;
-            }
-        
-        return maxEval;
-    }
-    else
-    {
-        int minEval = POS_INF; // representative of + infinity
-  
-            for (Move m : b2.get_moves())
-            {
-                eval = minimax(b2, m, depth - 1, alpha, beta, true);
-
-                minEval = minEval < eval ? minEval : eval;
-                beta = beta < eval ? beta : eval;
-               if (beta <= alpha)
-                   break;
-            }
-        return minEval;
-    }
-}
-
-int AIPlayer::eval(const Board& b) const
-{
-    int evaluation = 0;
-
-    Cell c;
-    int sign = 0;
-
-
-    for(int j = 0; j < 8; ++j)
-    {
-        for (int i = 0; i < 8; ++i)
-        {
-
-            c = Cell(i, j);
-
-            sign = (b[c].team == WHITE) ? 1 : -1; // for empty spaces, it will be -1 but it doesn't matter since their value is 0
-
-            evaluation = evaluation + value(b[c]) * sign;
-
-        }
-    }
-     
-    return evaluation;
-}
-
-int AIPlayer::value(const ChessPiece& p) const
-{
-    if (p == EMPTY_SPACE)  
-        return 0;
-    if (p == BLACK_PAWN || p == WHITE_PAWN)
-        return 1;
-    if (p == BLACK_KNIGHT || p == WHITE_KNIGHT || p == BLACK_BISHOP || p == WHITE_BISHOP)
-        return 3;
-    if (p == BLACK_ROOK || p == WHITE_ROOK)
-        return 5;
-    if (p == BLACK_QUEEN || p == WHITE_QUEEN)
-        return 9;
-    if (p == WHITE_KING || p == BLACK_KING)
-        return 1000;
-    return 0;
-}
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-/*
-bool AIPlayer::good_move(const Move move, const Board& board) const
-{
-    if (team == WHITE) // defending tactics
-    {
-        if (move.to.y < 4 && board[move.from].is_opposite_team(board[move.to]))
-            return true;
-    }
-    else if (team == BLACK)
-    {
-        if (move.to.y >= 4 && board[move.from].is_opposite_team(board[move.to]))
-            return true;
-    }
-    if (board[move.from].is_opposite_team(board[move.to]) && (board[move.to] == WHITE_KING || board[move.to] == BLACK_KING))
-        return true;
-
-    if (board[move.from].is_opposite_team(board[move.to]) && is_more_value(board[move.to], board[move.from]))
-        return true;
-
-    return false;
-}
-bool AIPlayer::is_more_value(const ChessPiece& p1, const ChessPiece& p2) const {
-
-    if (p2 == WHITE_KING || p2 == BLACK_KING || p2 == WHITE_QUEEN || p2 == BLACK_QUEEN)
-        return true;
-    if ((p1 == WHITE_PAWN || p1 == BLACK_PAWN) && (p2 != WHITE_PAWN && p2 != BLACK_PAWN))
-        return true;
-    if ((p1 == WHITE_KNIGHT || p1 == BLACK_KNIGHT) && (p2 == WHITE_ROOK || p2 == BLACK_ROOK))
-        return true;
-    if ((p1 == WHITE_BISHOP || p1 == BLACK_BISHOP) && (p2 == WHITE_ROOK || p2 == BLACK_ROOK))
-        return true;
-    if ((p1 == WHITE_BISHOP || p1 == BLACK_BISHOP) && (p2 == WHITE_KNIGHT || p2 == BLACK_KNIGHT))
-        return true;
-
-
-    return false;
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+
+#include "chess_board.h"
+#include "chess_eval.h"
+#include "chess_nnue.h"
+#include "chess_pieces.h"
+#include "chess_player.h"
+#include "move_picker.h"
+#include "trace.h"
+
+using std::cin;
+using std::cout;
+using std::endl;
+using std::function;
+using std::invalid_argument;
+using std::runtime_error;
+using std::string;
+using std::stringstream;
+using std::unique_ptr;
+using std::vector;
+
+const int POS_INF = 99999999;
+const int NEG_INF = -99999999;
+// What the search scores a drawn position as.
+const int DRAW_SCORE = 0;
+const char* Player::name() const {
+    return team_name(team);
+}
+
+unsigned clock_seed() {
+    return static_cast<unsigned>(std::chrono::system_clock::now().time_since_epoch().count());
+}
+
+unique_ptr<Player> make_player(const string& kind, Team team, unsigned seed, const NnueNetwork* network) {
+    if (kind == "random") {
+        return unique_ptr<Player>(new RandomPlayer(team, seed));
+    }
+    if (kind == "capture") {
+        return unique_ptr<Player>(new CapturePlayer(team, seed));
+    }
+    if (kind == "checkmate") {
+        return unique_ptr<Player>(new CheckMateCapturePlayer(team, seed));
+    }
+    if (kind == "ai") {
+        return unique_ptr<Player>(new AIPlayer(team, nullptr, seed));
+    }
+    if (kind == "nnue" && network) {
+        return unique_ptr<Player>(new AIPlayer(team, network, seed));
+    }
+    throw invalid_argument("make_player: unknown player kind " + kind);
+}
+
+
+RandomPlayer::RandomPlayer(Team team, unsigned seed) : Player(team) {
+    random_number_generator.seed(seed);
+}
+
+Move RandomPlayer::get_move(const Board& board, const vector<Move>& moves) const {
+    return moves[random_number_generator() % moves.size()];
+}
+
+AIPlayer::AIPlayer(Team team, const NnueNetwork* network, unsigned seed)
+    : Player(team), network(network),
+      eval_cache_salt(network ? network->hash() : 0) {
+    random_number_generator.seed(seed);
+}
+HumanPlayer::HumanPlayer(Team team) : Player(team) {}
+
+Move HumanPlayer::get_move(const Board& board, const vector<Move>& moves) const {
+    Move move;
+    while (true) {
+        cout << "What's your move?: ";
+        cin >> move;
+        cout << endl;
+        if (find(moves.begin(), moves.end(), move) != moves.end()) {
+            break;
+        }
+        cout << move << " is not a valid move! Please choose one of the following moves: \n";
+        for (Move valid_move : moves) {
+            cout << valid_move << ' ';
+        }
+        cout << endl;
+    }
+    return move;
+}
+
+CapturePlayer::CapturePlayer(Team team, unsigned seed) : Player(team) {
+    random_number_generator.seed(seed);
+}
+
+Move CapturePlayer::get_move(const Board& board, const vector<Move>& moves) const {
+    // A random capture if there is one, or else a random move.
+    vector<Move> captures = board.get_captures();
+    if (!captures.empty()) {
+        return captures[random_number_generator() % captures.size()];
+    }
+    return moves[random_number_generator() % moves.size()];
+}
+
+CheckMateCapturePlayer::CheckMateCapturePlayer(Team team, unsigned seed) : Player(team) {
+    random_number_generator.seed(seed);
+}
+
+Move CheckMateCapturePlayer::get_move(const Board& board, const vector<Move>& moves) const {
+    // A random king capture if there is one, or else a random capture, or
+    // else a random move.
+    vector<Move> captures = board.get_king_captures();
+    if (captures.empty()) {
+        captures = board.get_captures();
+    }
+    if (!captures.empty()) {
+        return captures[random_number_generator() % captures.size()];
+    }
+    return moves[random_number_generator() % moves.size()];
+}
+
+Move AIPlayer::get_move(const Board& board, const vector<Move>& moves) const
+{
+    SearchLimits limits;
+    limits.depth = 4;
+    return search(board, moves, team, limits, nullptr);
+}
+
+Move AIPlayer::search(const Board& board, const SearchLimits& limits, const function<void(const SearchProgress&)>& report) const
+{
+    return search(board, board.get_moves(), board.teams_turn(), limits, report);
+}
+
+Move AIPlayer::search(
+    const Board& board, const vector<Move>& moves, Team side, const SearchLimits& limits,
+    const function<void(const SearchProgress&)>& report) const
+{
+    if (moves.empty()) {
+        throw invalid_argument("AIPlayer::search: there are no moves to choose from");
+    }
+    // minimax makes and undoes moves on this copy instead of copying the
+    // board at every node.
+    Board b = board;
+    if (network) {
+        b.set_network(network);
+    }
+    EvalCacheStats eval_cache_before = thread_eval_cache().stats;
+    EvalCacheStats pawn_cache_before = thread_pawn_cache().stats;
+    auto start = std::chrono::steady_clock::now();
+    active_limits = &limits;
+    search_start = start;
+    search_start_nodes = search_stats.nodes;
+    aborted = false;
+    // Hash moves and killers from another search could belong to another
+    // player or position, so every search starts over.
+    thread_move_table().new_search();
+    killers.clear();
+
+    // Without a time, node or stop limit the search can't be cut short, so
+    // go straight to the full depth.
+    bool can_stop = limits.nodes > 0 || limits.movetime > 0 || limits.stop;
+    Move best_move = moves[0];
+    for (int depth = can_stop ? 1 : limits.depth; depth <= limits.depth; ++depth) {
+        Move depth_best_move = moves[0];
+        int best_score = side == WHITE ? NEG_INF : POS_INF;
+        for (Move move : moves)
+        {
+            if (side == WHITE)
+            {
+                int x = minimax(b, move, depth, NEG_INF, POS_INF, false);
+
+                if (x > best_score && !aborted)
+                {
+                    depth_best_move = move;
+                    best_score = x;
+                }
+            }
+            else
+            {
+                int x = minimax(b, move, depth, NEG_INF, POS_INF, true);
+                if (x < best_score && !aborted)
+                {
+                    depth_best_move = move;
+                    best_score = x;
+
+                }
+            }
+            if (aborted) {
+                break;
+            }
+        }
+        // An unfinished depth only looked at some of the moves, so keep the
+        // move from the last depth that finished.
+        if (aborted) {
+            break;
+        }
+        best_move = depth_best_move;
+        if (report) {
+            SearchProgress progress;
+            progress.depth = depth;
+            progress.score = best_score;
+            progress.nodes = search_stats.nodes - search_start_nodes;
+            progress.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            progress.best_move = best_move;
+            report(progress);
+        }
+    }
+    active_limits = nullptr;
+    search_stats.eval_cache += thread_eval_cache().stats - eval_cache_before;
+    search_stats.pawn_cache += thread_pawn_cache().stats - pawn_cache_before;
+    return best_move;
+}
+
+bool AIPlayer::out_of_time() const
+{
+    if (!active_limits) {
+        return false;
+    }
+    if (active_limits->stop && active_limits->stop->load(std::memory_order_relaxed)) {
+        return true;
+    }
+    uint64_t nodes = search_stats.nodes - search_start_nodes;
+    if (active_limits->nodes > 0 && nodes >= static_cast<uint64_t>(active_limits->nodes)) {
+        return true;
+    }
+    // Reading the clock is slower than a node, so only look every 1024 nodes.
+    if (active_limits->movetime > 0 && nodes % 1024 == 0) {
+        auto elapsed = std::chrono::steady_clock::now() - search_start;
+        return elapsed >= std::chrono::milliseconds(active_limits->movetime);
+    }
+    return false;
+}
+
+int AIPlayer::minimax(Board& b, Move move, int depth, int alpha, int beta, bool white) const
+{
+    TRACE_ZONE("AIPlayer::minimax");
+    if (aborted || out_of_time()) {
+        aborted = true;
+        return 0;
+    }
+    ++search_stats.nodes;
+    b.make_move(move);
+
+    // A position seen before (in the game or earlier in this line) can be
+    // repeated until it's a draw, so it's scored as one instead of searching
+    // the cycle again. The same goes for reaching the no-capture limit.
+    if (b.repetitions() > 1 || (b.no_capture_limit() > 0 && b.plies_since_capture() >= b.no_capture_limit()))
+    {
+     b.undo_move();
+     return DRAW_SCORE;
+    }
+ 
+    if (depth == 1)
+    {
+     int leaf_eval = eval(b);
+     b.undo_move();
+     return leaf_eval;
+    }
+
+    // The moves come from a MovePicker, which only generates the captures
+    // and quiet moves if the search gets that far without a cutoff.
+    MoveTable& move_table = thread_move_table();
+    uint64_t key = b.hash();
+    Move hash_move;
+    bool has_hash_move = move_table.probe(key, hash_move);
+    int num_killers;
+    const Move* depth_killers = killers.at(depth, num_killers);
+    MovePicker picker(b, has_hash_move ? &hash_move : nullptr, depth_killers, num_killers);
+    Move m, best_move;
+    bool has_best_move = false;
+    int eval;
+
+    if (white)
+    {
+        int maxEval = NEG_INF; // representative of - infinity
+
+            while (picker.next(m))
+            {
+                eval = 0;
+                eval = minimax(b, m, depth - 1, alpha, beta, false);       
+                if (eval > maxEval || !has_best_move) {
+                    best_move = m;
+                    has_best_move = true;
+                }
+                maxEval = maxEval > eval ? maxEval : eval;
+                alpha = alpha > eval ? alpha : eval;
+              if (beta <= alpha || aborted)
+              {
+                   if (!aborted && b[m.to].type == EMPTY)
+                       killers.add(depth, m);
+                   break;
+              }
+            }
+        
+        if (has_best_move && !aborted)
+            move_table.store(key, best_move);
+        b.undo_move();
+        return maxEval;
+    }
+    else
+    {
+        int minEval = POS_INF; // representative of + infinity
+  
+            while (picker.next(m))
+            {
+                eval = minimax(b, m, depth - 1, alpha, beta, true);
+
+                if (eval < minEval || !has_best_move) {
+                    best_move = m;
+                    has_best_move = true;
+                }
+                minEval = minEval < eval ? minEval : eval;
+                beta = beta < eval ? beta : eval;
+               if (beta <= alpha || aborted)
+               {
+                   if (!aborted && b[m.to].type == EMPTY)
+                       killers.add(depth, m);
+                   break;
+               }
+            }
+        if (has_best_move && !aborted)
+            move_table.store(key, best_move);
+        b.undo_move();
+        return minEval;
+    }
+}
+
+int AIPlayer::eval(const Board& b) const
+{
+    TRACE_ZONE("AIPlayer::eval");
+    uint64_t key = b.hash() ^ eval_cache_salt ^ eval_params_generation() * 0x9E3779B97F4A7C15ULL;
+    EvalCache& cache = thread_eval_cache();
+    int score;
+    if (cache.probe(key, score)) {
+        return score;
+    }
+
+    if (network) {
+        score = b.nnue_eval();
+    }
+    else {
+#if defined(_DEBUG) || defined(SILLY_CHESS_CHECK_EVAL)
+        // Debug builds (and builds with SILLY_CHESS_CHECK_EVAL) check the
+        // board's incremental sums against a full scan.
+        int full_eval = evaluate(b);
+        if (b.incremental_eval() != full_eval) {
+            stringstream err_msg;
+            err_msg << "AIPlayer::eval: incremental evaluation " << b.incremental_eval()
+                << " does not match full evaluation " << full_eval;
+            throw runtime_error(err_msg.str());
+        }
+#endif
+        score = b.incremental_eval() + cached_pawn_structure_eval(b);
+    }
+    cache.store(key, score);
+    return score;
+}
+
+const SearchStats& AIPlayer::stats() const
+{
+    return search_stats;
+}
+
+ostream& operator<<(ostream& os, const SearchStats& stats)
+{
+    return os << "nodes " << stats.nodes
+        << ", eval cache hits " << stats.eval_cache.hits << "/" << stats.eval_cache.probes
+        << " (" << 100 * stats.eval_cache.hit_rate() << "%)"
+        << ", pawn cache hits " << stats.pawn_cache.hits << "/" << stats.pawn_cache.probes
+        << " (" << 100 * stats.pawn_cache.hit_rate() << "%)";
+}
+
+int AIPlayer::value(const ChessPiece& p) const
+{
+    return eval_params().material[p.type];
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+/*
+bool AIPlayer::good_move(const Move move, const Board& board) const
+{
+    if (team == WHITE) // defending tactics
+    {
+        if (move.to.y < 4 && board[move.from].is_opposite_team(board[move.to]))
+            return true;
+    }
+    else if (team == BLACK)
+    {
+        if (move.to.y >= 4 && board[move.from].is_opposite_team(board[move.to]))
+            return true;
+    }
+    if (board[move.from].is_opposite_team(board[move.to]) && board[move.to].type == KING)
+        return true;
+
+    if (board[move.from].is_opposite_team(board[move.to]) && is_more_value(board[move.to], board[move.from]))
+        return true;
+
+    return false;
+}
+bool AIPlayer::is_more_value(const ChessPiece& p1, const ChessPiece& p2) const {
+
+    if (p2 == WHITE_KING || p2 == BLACK_KING || p2 == WHITE_QUEEN || p2 == BLACK_QUEEN)
+        return true;
+    if ((p1 == WHITE_PAWN || p1 == BLACK_PAWN) && (p2 != WHITE_PAWN && p2 != BLACK_PAWN))
+        return true;
+    if ((p1 == WHITE_KNIGHT || p1 == BLACK_KNIGHT) && (p2 == WHITE_ROOK || p2 == BLACK_ROOK))
+        return true;
+    if ((p1 == WHITE_BISHOP || p1 == BLACK_BISHOP) && (p2 == WHITE_ROOK || p2 == BLACK_ROOK))
+        return true;
+    if ((p1 == WHITE_BISHOP || p1 == BLACK_BISHOP) && (p2 == WHITE_KNIGHT || p2 == BLACK_KNIGHT))
+        return true;
+
+
+    return false;
 }*/
\ No newline at end of file
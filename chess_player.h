@@ -1,63 +1,150 @@
-#ifndef _CHESS_PLAYER_H_
-#define _CHESS_PLAYER_H_
-
-#include <random>
-#include <vector>
-
-#include "chess_board.h"
-
-using std::vector;
-
-class Player {
-public:
-	const Team team;
-
-	Player(Team team) : team(team) {}
-
-	virtual Move get_move(const Board& board, const vector<Move>& moves) const = 0;
-	virtual const char* name() const;
-};
-
-class RandomPlayer : public Player {
-	mutable std::default_random_engine random_number_generator;
-public:
-	RandomPlayer(Team team);
-
-	Move get_move(const Board& board, const vector<Move>& moves) const override;
-};
-
-class HumanPlayer : public Player {
-public:
-	HumanPlayer(Team team);
-	Move get_move(const Board& board, const vector<Move>& moves) const override;
-};
-
-class AIPlayer : public Player {
-	mutable std::default_random_engine random_number_generator;
-	bool good_move(const Move move, const Board& board) const;
-	bool is_more_value(const ChessPiece& p1, const ChessPiece& p2) const;
-	int minimax(const Board& b, Move move, int depth, int alpha, int beta, bool white) const;
-	int value(const ChessPiece& p) const;
-public:
-	AIPlayer(Team team);
-	int eval(const Board& b) const;
-	Move get_move(const Board& board, const vector<Move>& moves) const override;
-};
-
-// CapturePlayer plays a random move that captures an opponents piece.
-// If there is no such move, then it plays a random move.
-class CapturePlayer : public Player {
-	mutable std::default_random_engine random_number_generator;
-public:
-	CapturePlayer(Team team);
-	Move get_move(const Board& board, const vector<Move>& moves) const override;
-};
-
-class CheckMateCapturePlayer : public Player {
-	mutable std::default_random_engine random_number_generator;
-public:
-	CheckMateCapturePlayer(Team team);
-	Move get_move(const Board& board, const vector<Move>& moves) const override;
-};
-
-#endif  // _CHESS_PLAYER_H_#pragma once
+#ifndef _CHESS_PLAYER_H_
+#define _CHESS_PLAYER_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "chess_board.h"
+#include "chess_eval.h"
+#include "move_picker.h"
+
+using std::function;
+using std::ostream;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+// Counters AIPlayer keeps about its searches.
+struct SearchStats {
+	uint64_t nodes = 0;
+	EvalCacheStats eval_cache;
+	EvalCacheStats pawn_cache;
+};
+
+ostream& operator<<(ostream& os, const SearchStats& stats);
+
+// When an AIPlayer::search should stop. Searches go one ply deeper at a time
+// until they reach depth or hit one of the other limits (0 means no limit),
+// and then play the best move from the deepest search they finished.
+struct SearchLimits {
+	int depth = 4;
+	long nodes = 0;
+	// Milliseconds.
+	long movetime = 0;
+	// Another thread can set this to stop the search.
+	const std::atomic<bool>* stop = nullptr;
+};
+
+// What a search found at one depth.
+struct SearchProgress {
+	int depth;
+	// Positive if White is ahead, like AIPlayer::eval.
+	int score;
+	uint64_t nodes;
+	double seconds;
+	Move best_move;
+};
+
+// A seed based on the current time, so players with random number generators
+// choose different numbers when you run the code at different times. Pass
+// a fixed seed instead to make games repeatable.
+unsigned clock_seed();
+
+class Player {
+public:
+	const Team team;
+
+	Player(Team team) : team(team) {}
+	virtual ~Player() {}
+
+	virtual Move get_move(const Board& board, const vector<Move>& moves) const = 0;
+	virtual const char* name() const;
+	// True if get_move waits on something outside the program, like a person
+	// typing, instead of working out a move. Schedulers ask these players
+	// for moves on threads of their own (see game_scheduler.h).
+	virtual bool blocks() const { return false; }
+};
+
+class RandomPlayer : public Player {
+	mutable std::default_random_engine random_number_generator;
+public:
+	RandomPlayer(Team team, unsigned seed = clock_seed());
+
+	Move get_move(const Board& board, const vector<Move>& moves) const override;
+};
+
+class HumanPlayer : public Player {
+public:
+	HumanPlayer(Team team);
+	Move get_move(const Board& board, const vector<Move>& moves) const override;
+	bool blocks() const override { return true; }
+};
+
+class AIPlayer : public Player {
+	mutable std::default_random_engine random_number_generator;
+	// If set, positions are evaluated by this network instead of the tables
+	// in chess_eval.h.
+	const NnueNetwork* network;
+	// Mixed into eval cache keys so this player never reads scores that a
+	// player with a different evaluation stored. It's the hash of the
+	// network's weights, since another network can end up at the same
+	// address.
+	uint64_t eval_cache_salt;
+	mutable SearchStats search_stats;
+	// The limits of the search in progress, if any.
+	mutable const SearchLimits* active_limits = nullptr;
+	mutable std::chrono::steady_clock::time_point search_start;
+	mutable uint64_t search_start_nodes = 0;
+	// Set once the search has hit a limit; minimax then returns right away.
+	mutable bool aborted = false;
+	// Quiet moves that caused cutoffs in the search in progress, which its
+	// MovePickers try right after the captures (see move_picker.h).
+	mutable KillerMoves killers;
+	bool out_of_time() const;
+	Move search(
+		const Board& board, const vector<Move>& moves, Team side, const SearchLimits& limits,
+		const function<void(const SearchProgress&)>& report) const;
+	bool good_move(const Move move, const Board& board) const;
+	bool is_more_value(const ChessPiece& p1, const ChessPiece& p2) const;
+	int minimax(Board& b, Move move, int depth, int alpha, int beta, bool white) const;
+	int value(const ChessPiece& p) const;
+public:
+	AIPlayer(Team team, const NnueNetwork* network = nullptr, unsigned seed = clock_seed());
+	int eval(const Board& b) const;
+	// Totals over every get_move call so far.
+	const SearchStats& stats() const;
+	Move get_move(const Board& board, const vector<Move>& moves) const override;
+	// Searches for the best move for whoever's turn it is on board, within
+	// limits, calling report (if set) each time a depth is finished. Throws
+	// invalid_argument if there are no moves.
+	Move search(const Board& board, const SearchLimits& limits, const function<void(const SearchProgress&)>& report = nullptr) const;
+};
+
+// CapturePlayer plays a random move that captures an opponents piece.
+// If there is no such move, then it plays a random move.
+class CapturePlayer : public Player {
+	mutable std::default_random_engine random_number_generator;
+public:
+	CapturePlayer(Team team, unsigned seed = clock_seed());
+	Move get_move(const Board& board, const vector<Move>& moves) const override;
+};
+
+class CheckMateCapturePlayer : public Player {
+	mutable std::default_random_engine random_number_generator;
+public:
+	CheckMateCapturePlayer(Team team, unsigned seed = clock_seed());
+	Move get_move(const Board& board, const vector<Move>& moves) const override;
+};
+
+// Makes a player by name: "random", "capture", "checkmate", "ai", or "nnue"
+// (an AIPlayer using network). Throws invalid_argument for anything else.
+unique_ptr<Player> make_player(const string& kind, Team team, unsigned seed, const NnueNetwork* network = nullptr);
+
+#endif  // _CHESS_PLAYER_H_#pragma once
@@ -0,0 +1,358 @@
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include "chess_board.h"
+#include "chess_pieces.h"
+#include "defined_pieces.h"
+#include "piece_registry.h"
+#include "utf8_codepoint.h"
+
+using std::ifstream;
+using std::istringstream;
+using std::lock_guard;
+using std::mutex;
+using std::pair;
+using std::runtime_error;
+using std::stringstream;
+
+static const char* const PIECE_TYPE_NAMES[NUM_PIECE_TYPES] = {
+    "", "pawn", "knight", "bishop", "rook", "queen", "king", "backbencher", "mouse",
+};
+
+static char32_t read_glyph(const string& token) {
+    char32_t glyphs[4];
+    size_t bytes_used;
+    if (token.size() > 4 || utf8_decode(token.data(), token.size(), glyphs, &bytes_used) != 1 || bytes_used != token.size()) {
+        return 0;
+    }
+    return glyphs[0];
+}
+
+vector<PieceDefinition> read_piece_definitions(istream& in) {
+    vector<PieceDefinition> definitions;
+    bool in_piece = false;
+    string line;
+    int line_number = 0;
+    auto error = [&line_number](const string& message) {
+        stringstream err_msg;
+        err_msg << "read_piece_definitions: line " << line_number << ": " << message;
+        throw runtime_error(err_msg.str());
+    };
+    while (getline(in, line)) {
+        ++line_number;
+        istringstream words(line);
+        string keyword;
+        if (!(words >> keyword) || keyword[0] == '#') {
+            continue;
+        }
+        if (keyword == "piece") {
+            if (in_piece) {
+                error("expected \"end\" before the next piece");
+            }
+            PieceDefinition definition;
+            string white_glyph, black_glyph, type;
+            if (!(words >> definition.name >> white_glyph >> black_glyph >> type)) {
+                error("expected: piece <name> <white glyph> <black glyph> <type>");
+            }
+            definition.white_glyph = read_glyph(white_glyph);
+            definition.black_glyph = read_glyph(black_glyph);
+            if (!definition.white_glyph || !definition.black_glyph) {
+                error("a glyph should be a single character");
+            }
+            const char* const* type_name = std::find(PIECE_TYPE_NAMES + 1, PIECE_TYPE_NAMES + NUM_PIECE_TYPES, type);
+            if (type_name == PIECE_TYPE_NAMES + NUM_PIECE_TYPES) {
+                error("unknown piece type " + type);
+            }
+            definition.type = static_cast<PieceType>(type_name - PIECE_TYPE_NAMES);
+            definitions.push_back(definition);
+            in_piece = true;
+            continue;
+        }
+        if (!in_piece) {
+            error("expected \"piece\"");
+        }
+        vector<PieceRule>& rules = definitions.back().rules;
+        PieceRule rule;
+        if (keyword == "end") {
+            in_piece = false;
+        }
+        else if (keyword == "leap" || keyword == "ride") {
+            rule.kind = keyword == "leap" ? PieceRule::LEAP : PieceRule::RIDE;
+            if (!(words >> rule.dx >> rule.dy)) {
+                error("expected: " + keyword + " <dx> <dy>");
+            }
+            if (rule.kind == PieceRule::RIDE && rule.dx == 0 && rule.dy == 0) {
+                error("a ride needs a direction");
+            }
+            string option;
+            while (words >> option) {
+                if (option == "move") {
+                    rule.mode = MOVE_ONLY;
+                }
+                else if (option == "capture") {
+                    rule.mode = CAPTURE_ONLY;
+                }
+                else if (option == "mirror") {
+                    rule.mirror = true;
+                }
+                else if (option == "all") {
+                    rule.all = true;
+                }
+                else {
+                    error("unknown option " + option);
+                }
+            }
+            rules.push_back(rule);
+        }
+        else if (keyword == "rows-behind") {
+            rule.kind = PieceRule::ROWS_BEHIND;
+            rules.push_back(rule);
+        }
+        else if (keyword == "home-corners") {
+            rule.kind = PieceRule::HOME_CORNERS;
+            rules.push_back(rule);
+        }
+        else if (keyword == "row-ends") {
+            rule.kind = PieceRule::ROW_ENDS;
+            int num_rows = 0;
+            while (words >> rule.dy) {
+                rules.push_back(rule);
+                ++num_rows;
+            }
+            if (num_rows == 0 || !words.eof()) {
+                error("expected: row-ends <dy> [<dy> ...]");
+            }
+        }
+        else {
+            error("unknown rule " + keyword);
+        }
+    }
+    if (in_piece) {
+        error("the last piece has no \"end\"");
+    }
+    return definitions;
+}
+
+DefinedPiece::DefinedPiece(const PieceDefinition& definition, Team team)
+    : SimpleChessPiece(team == WHITE ? definition.white_glyph : definition.black_glyph, team, definition.type,
+          new_piece_code(definition.type, team)),
+      definition(definition), sliding_attacks(false), last_tables(nullptr) {
+    for (const PieceRule& rule : definition.rules) {
+        sliding_attacks = sliding_attacks || (rule.kind == PieceRule::RIDE && (rule.mode & CAPTURE_ONLY));
+    }
+    // Almost every game is on an 8x8 board.
+    tables_for(8, 8);
+}
+
+const string& DefinedPiece::name() const {
+    return definition.name;
+}
+
+// The offsets a leap or ride rule covers.
+static vector<pair<int, int>> rule_offsets(const PieceRule& rule) {
+    vector<pair<int, int>> offsets = { { rule.dx, rule.dy } };
+    if (rule.mirror) {
+        offsets.emplace_back(-rule.dx, rule.dy);
+    }
+    if (rule.all) {
+        for (int sx : { 1, -1 }) {
+            for (int sy : { 1, -1 }) {
+                offsets.emplace_back(sx * rule.dx, sy * rule.dy);
+                offsets.emplace_back(sx * rule.dy, sy * rule.dx);
+            }
+        }
+    }
+    std::sort(offsets.begin(), offsets.end());
+    offsets.erase(std::unique(offsets.begin(), offsets.end()), offsets.end());
+    return offsets;
+}
+
+unique_ptr<DefinedPiece::MoveTables> DefinedPiece::compile(int width, int height) const {
+    unique_ptr<MoveTables> compiled(new MoveTables);
+    compiled->width = width;
+    compiled->height = height;
+    int forward = team == BLACK ? -1 : 1;
+    int back_row = team == BLACK ? height - 1 : 0;
+    vector<MoveTables::Target> jumps;
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            MoveTables::CellMoves cell_moves;
+            cell_moves.first_ray = static_cast<uint32_t>(compiled->rays.size());
+            // Several rules can reach the same cell, so jumps are merged.
+            jumps.clear();
+            auto add_jump = [&](int to_x, int to_y, uint8_t mode) {
+                if (to_x < 0 || to_x >= width || to_y < 0 || to_y >= height || (to_x == x && to_y == y)) {
+                    return;
+                }
+                uint16_t cell = static_cast<uint16_t>(to_y * width + to_x);
+                for (MoveTables::Target& jump : jumps) {
+                    if (jump.cell == cell) {
+                        jump.mode |= mode;
+                        return;
+                    }
+                }
+                jumps.push_back(MoveTables::Target{ cell, mode });
+            };
+            for (const PieceRule& rule : definition.rules) {
+                switch (rule.kind) {
+                case PieceRule::LEAP:
+                    for (pair<int, int> offset : rule_offsets(rule)) {
+                        add_jump(x + offset.first, y + forward * offset.second, rule.mode);
+                    }
+                    break;
+                case PieceRule::RIDE:
+                    for (pair<int, int> offset : rule_offsets(rule)) {
+                        MoveTables::Ray ray{ static_cast<uint32_t>(compiled->ray_cells.size()), 0, rule.mode };
+                        for (int to_x = x + offset.first, to_y = y + forward * offset.second;
+                             to_x >= 0 && to_x < width && to_y >= 0 && to_y < height;
+                             to_x += offset.first, to_y += forward * offset.second) {
+                            compiled->ray_cells.push_back(static_cast<uint16_t>(to_y * width + to_x));
+                            ++ray.length;
+                        }
+                        if (ray.length > 0) {
+                            compiled->rays.push_back(ray);
+                        }
+                    }
+                    break;
+                case PieceRule::ROWS_BEHIND:
+                    for (int to_y = y - forward; to_y >= 0 && to_y < height; to_y -= forward) {
+                        for (int to_x = 0; to_x < width; ++to_x) {
+                            add_jump(to_x, to_y, rule.mode);
+                        }
+                    }
+                    break;
+                case PieceRule::ROW_ENDS:
+                    add_jump(0, y + forward * rule.dy, rule.mode);
+                    add_jump(width - 1, y + forward * rule.dy, rule.mode);
+                    break;
+                case PieceRule::HOME_CORNERS:
+                    add_jump(0, back_row, rule.mode);
+                    add_jump(width - 1, back_row, rule.mode);
+                    break;
+                }
+            }
+            cell_moves.first_jump = static_cast<uint32_t>(compiled->jumps.size());
+            cell_moves.num_jumps = static_cast<uint32_t>(jumps.size());
+            compiled->jumps.insert(compiled->jumps.end(), jumps.begin(), jumps.end());
+            cell_moves.num_rays = static_cast<uint32_t>(compiled->rays.size()) - cell_moves.first_ray;
+            compiled->cells.push_back(cell_moves);
+        }
+    }
+    return compiled;
+}
+
+const DefinedPiece::MoveTables& DefinedPiece::tables_for(int width, int height) const {
+    const MoveTables* last = last_tables.load(std::memory_order_acquire);
+    if (last && last->width == width && last->height == height) {
+        return *last;
+    }
+    lock_guard<mutex> lock(tables_mutex);
+    for (const unique_ptr<MoveTables>& existing : tables) {
+        if (existing->width == width && existing->height == height) {
+            last_tables.store(existing.get(), std::memory_order_release);
+            return *existing;
+        }
+    }
+    tables.push_back(compile(width, height));
+    last_tables.store(tables.back().get(), std::memory_order_release);
+    return *tables.back();
+}
+
+void DefinedPiece::get_moves(const Board& board, Cell from, vector<Move>& moves) const {
+    get_moves_of_kind(board, from, ALL_MOVES, moves);
+}
+
+void DefinedPiece::get_moves_of_kind(const Board& board, Cell from, MoveKind kind, vector<Move>& moves) const {
+    // MOVE_ONLY and CAPTURE_ONLY are the same bits as QUIET_MOVES and
+    // CAPTURES, so masking a mode by kind leaves the moves wanted.
+    static_assert(static_cast<int>(MOVE_ONLY) == QUIET_MOVES && static_cast<int>(CAPTURE_ONLY) == CAPTURES, "Move modes and kinds should share bits");
+    const MoveTables& compiled = tables_for(board.width(), board.height());
+    const uint8_t* codes = board.piece_codes();
+    int width = compiled.width;
+    Team enemy = team == WHITE ? BLACK : WHITE;
+    auto add = [&](int cell) {
+        moves.emplace_back(from, Cell(cell % width, cell / width));
+    };
+    const MoveTables::CellMoves& cell_moves = compiled.cells[from.y * width + from.x];
+    const MoveTables::Target* jumps = compiled.jumps.data() + cell_moves.first_jump;
+    for (uint32_t i = 0; i < cell_moves.num_jumps; ++i) {
+        int code = codes[jumps[i].cell];
+        int mode = jumps[i].mode & kind;
+        if (code == EMPTY_SPACE.code ? (mode & MOVE_ONLY) != 0
+                : (mode & CAPTURE_ONLY) != 0 && code_team(code) == enemy) {
+            add(jumps[i].cell);
+        }
+    }
+    const MoveTables::Ray* rays = compiled.rays.data() + cell_moves.first_ray;
+    for (uint32_t i = 0; i < cell_moves.num_rays; ++i) {
+        int mode = rays[i].mode & kind;
+        if (mode == 0) {
+            continue;
+        }
+        const uint16_t* cells = compiled.ray_cells.data() + rays[i].first;
+        for (uint16_t step = 0; step < rays[i].length; ++step) {
+            int code = codes[cells[step]];
+            if (code == EMPTY_SPACE.code) {
+                if (mode & MOVE_ONLY) {
+                    add(cells[step]);
+                }
+                continue;
+            }
+            if ((mode & CAPTURE_ONLY) && code_team(code) == enemy) {
+                add(cells[step]);
+            }
+            break;
+        }
+    }
+}
+
+void DefinedPiece::get_attacks(const Board& board, Cell from, vector<Cell>& attacks) const {
+    const MoveTables& compiled = tables_for(board.width(), board.height());
+    const uint8_t* codes = board.piece_codes();
+    int width = compiled.width;
+    const MoveTables::CellMoves& cell_moves = compiled.cells[from.y * width + from.x];
+    const MoveTables::Target* jumps = compiled.jumps.data() + cell_moves.first_jump;
+    for (uint32_t i = 0; i < cell_moves.num_jumps; ++i) {
+        if (jumps[i].mode & CAPTURE_ONLY) {
+            attacks.emplace_back(jumps[i].cell % width, jumps[i].cell / width);
+        }
+    }
+    const MoveTables::Ray* rays = compiled.rays.data() + cell_moves.first_ray;
+    for (uint32_t i = 0; i < cell_moves.num_rays; ++i) {
+        if (!(rays[i].mode & CAPTURE_ONLY)) {
+            continue;
+        }
+        const uint16_t* cells = compiled.ray_cells.data() + rays[i].first;
+        for (uint16_t step = 0; step < rays[i].length; ++step) {
+            attacks.emplace_back(cells[step] % width, cells[step] / width);
+            if (codes[cells[step]] != EMPTY_SPACE.code) {
+                break;
+            }
+        }
+    }
+}
+
+bool DefinedPiece::has_sliding_attacks() const {
+    return sliding_attacks;
+}
+
+vector<const DefinedPiece*> load_piece_definitions(const string& path) {
+    // Every loaded piece, kept alive for the rest of the program because
+    // boards and the registry point at them.
+    static vector<unique_ptr<DefinedPiece>> loaded_pieces;
+    ifstream in(path);
+    if (!in) {
+        throw runtime_error("load_piece_definitions: could not open " + path);
+    }
+    vector<const DefinedPiece*> pieces;
+    for (const PieceDefinition& definition : read_piece_definitions(in)) {
+        for (Team team : { WHITE, BLACK }) {
+            loaded_pieces.emplace_back(new DefinedPiece(definition, team));
+            piece_registry().add(*loaded_pieces.back());
+            pieces.push_back(loaded_pieces.back().get());
+        }
+    }
+    return pieces;
+}
@@ -0,0 +1,133 @@
+#ifndef _DEFINED_PIECES_H_
+#define _DEFINED_PIECES_H_
+
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "chess_board.h"
+#include "chess_pieces.h"
+
+using std::istream;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+// Custom pieces described by a definitions file instead of code. A file
+// holds any number of pieces, each written as
+//
+//   piece <name> <white glyph> <black glyph> <type>
+//   <rule>
+//   ...
+//   end
+//
+// where <type> is the built-in piece type it is evaluated as (pawn, knight,
+// bishop, rook, queen, king, backbencher or mouse) and each rule is one of
+//
+//   leap <dx> <dy> [move|capture] [mirror|all]
+//       jump to the cell dx across and dy forward
+//   ride <dx> <dy> [move|capture] [mirror|all]
+//       keep jumping by dx, dy until blocked, like a rook or bishop
+//   rows-behind
+//       move to any cell in any row behind the piece
+//   row-ends <dy> [<dy> ...]
+//       move to the first or last cell of the row dy ahead
+//   home-corners
+//       move to a corner of the team's back row
+//
+// "Forward" is towards the opponent, so one definition works for both
+// teams. Moves can capture unless they say "move" (move to an empty cell
+// only) or "capture" (capture only). "mirror" adds the move with dx
+// negated and "all" adds all 8 reflections and rotations, like a knight's
+// jumps. Blank lines and lines starting with '#' are ignored.
+//
+// Pieces are compiled into per-cell move tables for each board size they
+// are used on, so generating their moves is a table walk. Every DefinedPiece
+// gets its own piece code (see new_piece_code), so boards, hashes and saved
+// games tell it apart from the built-in piece of its type.
+
+enum MoveMode : uint8_t {
+    MOVE_ONLY = 1,
+    CAPTURE_ONLY = 2,
+    MOVE_OR_CAPTURE = 3,
+};
+
+struct PieceRule {
+    enum Kind { LEAP, RIDE, ROWS_BEHIND, ROW_ENDS, HOME_CORNERS };
+    Kind kind;
+    int dx = 0;
+    int dy = 0;
+    MoveMode mode = MOVE_OR_CAPTURE;
+    bool mirror = false;
+    bool all = false;
+};
+
+struct PieceDefinition {
+    string name;
+    char32_t white_glyph;
+    char32_t black_glyph;
+    PieceType type;
+    vector<PieceRule> rules;
+};
+
+// Reads every piece definition in. Throws runtime_error, with the line
+// number, if the input isn't valid.
+vector<PieceDefinition> read_piece_definitions(istream& in);
+
+class DefinedPiece : public SimpleChessPiece {
+    // The moves from every cell of one board size.
+    struct MoveTables {
+        struct Target {
+            uint16_t cell;
+            uint8_t mode;
+        };
+        // Cells along a ride, in order, which stop at the first piece.
+        struct Ray {
+            uint32_t first;
+            uint16_t length;
+            uint8_t mode;
+        };
+        struct CellMoves {
+            uint32_t first_jump, num_jumps;
+            uint32_t first_ray, num_rays;
+        };
+        int width;
+        int height;
+        vector<CellMoves> cells;
+        vector<Target> jumps;
+        vector<Ray> rays;
+        vector<uint16_t> ray_cells;
+    };
+
+    const PieceDefinition definition;
+    // True if a ride can capture, so the piece's attacks depend on the board.
+    bool sliding_attacks;
+    // Tables for each board size seen so far. They are only ever added, so
+    // last_tables can be read without taking the lock.
+    mutable std::mutex tables_mutex;
+    mutable vector<unique_ptr<MoveTables>> tables;
+    mutable std::atomic<const MoveTables*> last_tables;
+
+    unique_ptr<MoveTables> compile(int width, int height) const;
+    const MoveTables& tables_for(int width, int height) const;
+public:
+    DefinedPiece(const PieceDefinition& definition, Team team);
+    const string& name() const;
+    void get_moves(const Board& board, Cell from, vector<Move>& moves) const override;
+    void get_moves_of_kind(const Board& board, Cell from, MoveKind kind, vector<Move>& moves) const override;
+    void get_attacks(const Board& board, Cell from, vector<Cell>& attacks) const override;
+    bool has_sliding_attacks() const override;
+};
+
+// Reads the definitions in the file at path, makes a white and a black
+// DefinedPiece for each, and adds them to piece_registry() so boards can
+// use them. The pieces live until the program ends. Throws runtime_error if
+// the file can't be read or isn't valid, and invalid_argument if a glyph is
+// already taken.
+vector<const DefinedPiece*> load_piece_definitions(const string& path);
+
+#endif  // _DEFINED_PIECES_H_
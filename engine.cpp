@@ -0,0 +1,253 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#include "chess_board.h"
+#include "chess_pieces.h"
+#include "chess_player.h"
+#include "engine.h"
+#include "piece_registry.h"
+#include "notation.h"
+#include "utf8_codepoint.h"
+
+using std::getline;
+using std::invalid_argument;
+using std::lock_guard;
+using std::stringstream;
+using std::vector;
+
+// Searches given no limits go as deep as AIPlayer::get_move does, and
+// "go infinite" searches go until they are stopped.
+const int DEFAULT_DEPTH = 4;
+const int INFINITE_DEPTH = 1000;
+// With a clock, spend this fraction of the remaining time on a move.
+const int MOVES_TO_GO = 30;
+
+EngineServer::EngineServer(istream& in, ostream& out, const NnueNetwork* network)
+    : in(in), out(out), network(network), player(WHITE, network), stop_flag(false) {
+}
+
+EngineServer::~EngineServer() {
+    stop_search();
+}
+
+void EngineServer::send(const string& line) {
+    lock_guard<mutex> lock(out_mutex);
+    out << line << std::endl;
+}
+
+void EngineServer::stop_search() {
+    if (search_thread.joinable()) {
+        stop_flag = true;
+        search_thread.join();
+    }
+}
+
+void EngineServer::run() {
+    string line;
+    while (getline(in, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (!handle(line)) {
+            break;
+        }
+    }
+    stop_search();
+}
+
+bool EngineServer::handle(const string& line) {
+    istringstream args(line);
+    string command;
+    args >> command;
+    if (command == "uci") {
+        send("id name sillychess");
+        send("uciok");
+    }
+    else if (command == "isready") {
+        send("readyok");
+    }
+    else if (command == "ucinewgame") {
+        stop_search();
+        board = Board();
+    }
+    else if (command == "position") {
+        stop_search();
+        try {
+            position(args);
+        }
+        catch (const std::exception& error) {
+            send(string("info string ") + error.what());
+        }
+    }
+    else if (command == "go") {
+        stop_search();
+        go(args);
+    }
+    else if (command == "stop") {
+        stop_search();
+    }
+    else if (command == "quit") {
+        stop_search();
+        return false;
+    }
+    return true;
+}
+
+// Reads a board written as rows of piece characters separated by '/'.
+static void read_pieces(const string& rows, Board& board) {
+    vector<vector<const ChessPiece*>> cells(1);
+    vector<char32_t> code_points(rows.size());
+    size_t bytes_used;
+    code_points.resize(utf8_decode(rows.data(), rows.size(), code_points.data(), &bytes_used));
+    if (bytes_used != rows.size()) {
+        throw invalid_argument("position: invalid UTF-8");
+    }
+    for (char32_t cp : code_points) {
+        if (cp == U'/') {
+            cells.emplace_back();
+            continue;
+        }
+        const ChessPiece* piece = piece_registry().find(cp);
+        if (!piece) {
+            stringstream err_msg;
+            err_msg << "position: unknown piece " << UTF8CodePoint(cp);
+            throw invalid_argument(err_msg.str());
+        }
+        cells.back().push_back(piece);
+    }
+    size_t width = cells[0].size();
+    for (const vector<const ChessPiece*>& row : cells) {
+        if (row.size() != width || width == 0) {
+            throw invalid_argument("position: rows must all be the same length");
+        }
+    }
+    int height = static_cast<int>(cells.size());
+    board.clear(static_cast<int>(width), height);
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < static_cast<int>(width); ++x) {
+            // The first row given is the top of the board.
+            board.set_piece(Cell(x, y), *cells[height - 1 - y][x]);
+        }
+    }
+}
+
+void read_position(istream& args, Board& board) {
+    Board new_board;
+    string token;
+    args >> token;
+    if (token == "pieces") {
+        string rows;
+        args >> rows;
+        read_pieces(rows, new_board);
+        args >> token;
+        if (token == "w" || token == "b") {
+            new_board.set_teams_turn(token == "w" ? WHITE : BLACK);
+            args >> token;
+        }
+    }
+    else if (token == "fen") {
+        string rows, turn;
+        args >> rows >> turn;
+        new_board = board_from_notation(rows + ' ' + turn);
+        args >> token;
+    }
+    else if (token == "startpos") {
+        args >> token;
+    }
+    else {
+        throw invalid_argument("position: expected startpos, fen or pieces");
+    }
+    if (args && token == "moves") {
+        while (args >> token) {
+            istringstream move_text(token);
+            Move move;
+            move_text >> move;
+            vector<Move> moves = new_board.get_moves();
+            if (!move_text || std::find(moves.begin(), moves.end(), move) == moves.end()) {
+                throw invalid_argument("position: illegal move " + token);
+            }
+            new_board.make_move(move);
+        }
+    }
+    board = new_board;
+}
+
+void EngineServer::position(istringstream& args) {
+    read_position(args, board);
+}
+
+void EngineServer::go(istringstream& args) {
+    SearchLimits limits;
+    limits.depth = DEFAULT_DEPTH;
+    long white_time = 0, black_time = 0, white_increment = 0, black_increment = 0;
+    bool limited = false;
+    string token;
+    while (args >> token) {
+        long value = 0;
+        if (token == "infinite") {
+            limits.depth = INFINITE_DEPTH;
+            limited = true;
+            continue;
+        }
+        if (!(args >> value)) {
+            break;
+        }
+        if (token == "depth") {
+            limits.depth = static_cast<int>(value);
+            limited = true;
+        }
+        else if (token == "nodes") {
+            limits.nodes = value;
+        }
+        else if (token == "movetime") {
+            limits.movetime = value;
+        }
+        else if (token == "wtime") {
+            white_time = value;
+        }
+        else if (token == "btime") {
+            black_time = value;
+        }
+        else if (token == "winc") {
+            white_increment = value;
+        }
+        else if (token == "binc") {
+            black_increment = value;
+        }
+    }
+    long time_left = board.teams_turn() == WHITE ? white_time : black_time;
+    long increment = board.teams_turn() == WHITE ? white_increment : black_increment;
+    if (limits.movetime == 0 && time_left > 0) {
+        limits.movetime = std::max(1L, time_left / MOVES_TO_GO + increment / 2);
+    }
+    // A time or node limit on its own lets the search go as deep as it can.
+    if (!limited && (limits.movetime > 0 || limits.nodes > 0)) {
+        limits.depth = INFINITE_DEPTH;
+    }
+
+    stop_flag = false;
+    search_thread = thread([this, limits]() mutable {
+        limits.stop = &stop_flag;
+        vector<Move> moves = board.get_moves();
+        if (moves.empty() || board.game_over()) {
+            send("bestmove (none)");
+            return;
+        }
+        int sign = board.teams_turn() == WHITE ? 1 : -1;
+        Move best_move = player.search(board, limits, [&](const SearchProgress& progress) {
+            stringstream info;
+            info
+                << "info depth " << progress.depth << " score cp " << sign * progress.score
+                << " nodes " << progress.nodes << " time " << static_cast<long>(progress.seconds * 1000)
+                << " pv " << progress.best_move;
+            send(info.str());
+        });
+        stringstream reply;
+        reply << "bestmove " << best_move;
+        send(reply.str());
+    });
+}
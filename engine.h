@@ -0,0 +1,79 @@
+#ifndef _ENGINE_H_
+#define _ENGINE_H_
+
+#include <atomic>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "chess_board.h"
+#include "chess_nnue.h"
+#include "chess_player.h"
+
+using std::atomic;
+using std::istream;
+using std::istringstream;
+using std::mutex;
+using std::ostream;
+using std::string;
+using std::thread;
+
+// Lets another program (a GUI or a match harness) drive an AIPlayer with a
+// line based protocol modeled on UCI. Commands:
+//
+//   uci                  replies "id name ..." and "uciok"
+//   isready              replies "readyok", even while searching
+//   ucinewgame           forgets the current game
+//   position startpos [moves <move> ...]
+//   position fen <rows> <w|b> [moves <move> ...]
+//                        a position in one line notation (see notation.h)
+//   position pieces <rows> [w|b] [moves <move> ...]
+//                        a board of any size: its rows from the top down,
+//                        separated by '/', one piece character per cell as
+//                        the board is printed ('.' is an empty cell)
+//   go [depth <plies>] [nodes <n>] [movetime <ms>] [wtime <ms>] [btime <ms>]
+//      [winc <ms>] [binc <ms>] [infinite]
+//                        starts searching in the background, replying
+//                        "info depth <d> score cp <s> nodes <n> time <ms> pv <move>"
+//                        after each depth and "bestmove <move>" at the end
+//   stop                 ends the search now (it still replies bestmove)
+//   quit
+//
+// Moves are written like e2e4. Scores are from the side to move's point of
+// view. Unknown commands are ignored and bad arguments get "info string"
+// replies, so a confused GUI doesn't take the engine down.
+class EngineServer {
+    istream& in;
+    ostream& out;
+    // Replies come from both the command loop and the search thread.
+    mutex out_mutex;
+    const NnueNetwork* network;
+    AIPlayer player;
+    Board board;
+    thread search_thread;
+    atomic<bool> stop_flag;
+
+    void send(const string& line);
+    // Stops the search, if there is one, and waits for it to reply.
+    void stop_search();
+    void position(istringstream& args);
+    void go(istringstream& args);
+public:
+    EngineServer(istream& in, ostream& out, const NnueNetwork* network = nullptr);
+    ~EngineServer();
+    EngineServer(const EngineServer&) = delete;
+    EngineServer& operator=(const EngineServer&) = delete;
+    // Handles commands until quit or the end of the input.
+    void run();
+    // Handles one command. Returns false for quit.
+    bool handle(const string& line);
+};
+
+// Reads the arguments of a position command ("startpos ...", "fen ..." or
+// "pieces ...") into board. Throws invalid_argument if they don't make sense,
+// leaving board as it was.
+void read_position(istream& args, Board& board);
+
+#endif  // _ENGINE_H_
@@ -0,0 +1,383 @@
+#include <algorithm>
+#include <stdexcept>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+#include "chess_eval.h"
+#include "chess_pieces.h"
+#include "eval_batch.h"
+
+using std::invalid_argument;
+
+const size_t EVAL_BATCH_PADDING = 32;
+
+EvalBatch::EvalBatch(size_t capacity) : count(0), stride(0) {
+    while (stride < capacity) {
+        grow();
+    }
+}
+
+void EvalBatch::grow() {
+    size_t new_stride = std::max(EVAL_BATCH_PADDING, stride * 2);
+    vector<uint8_t> new_codes(PST_SQUARES * new_stride, EMPTY);
+    for (int square = 0; square < PST_SQUARES; ++square) {
+        std::copy(codes.begin() + square * stride, codes.begin() + square * stride + count,
+            new_codes.begin() + square * new_stride);
+    }
+    codes.swap(new_codes);
+    stride = new_stride;
+}
+
+void EvalBatch::add(const Board& board) {
+    if (board.width() != 8 || board.height() != 8) {
+        throw invalid_argument("EvalBatch::add: only 8x8 boards can be batched");
+    }
+    add_codes(board.piece_codes());
+}
+
+void EvalBatch::add_codes(const uint8_t* position_codes) {
+    if (count == stride) {
+        grow();
+    }
+    for (int square = 0; square < PST_SQUARES; ++square) {
+        codes[square * stride + count] = static_cast<uint8_t>(type_code(position_codes[square]));
+    }
+    ++count;
+}
+
+void EvalBatch::clear() {
+    std::fill(codes.begin(), codes.begin() + PST_SQUARES * stride, EMPTY);
+    count = 0;
+}
+
+size_t EvalBatch::size() const {
+    return count;
+}
+
+const uint8_t* EvalBatch::square_codes(int square) const {
+    return codes.data() + square * stride;
+}
+
+#if defined(__AVX2__)
+
+// All ones in the bytes whose code is a or b.
+static __m256i is_either(__m256i codes, int a, int b) {
+    return _mm256_or_si256(
+        _mm256_cmpeq_epi8(codes, _mm256_set1_epi8(static_cast<char>(a))),
+        _mm256_cmpeq_epi8(codes, _mm256_set1_epi8(static_cast<char>(b))));
+}
+
+// PIECE_SQUARE_SCORES split into bytes for _mm256_shuffle_epi8 lookups:
+// for each square, the low, middle and (signed) high byte of the score of
+// each piece code. A shuffle looks up 16 entries, so the codes are numbered
+// without EMPTY (which scores 0) and the unused code 9 (black's empty space):
+// 1-8 are entries 0-7 and 10-17 are entries 8-15.
+struct PieceSquareBytes {
+    uint64_t generation = ~uint64_t(0);
+    // False if some score needs more than 24 bits, and then the scores are
+    // gathered from PIECE_SQUARE_SCORES instead.
+    bool fits = false;
+    alignas(16) uint8_t bytes[PST_SQUARES][3][16];
+};
+
+static const PieceSquareBytes& piece_square_bytes() {
+    thread_local PieceSquareBytes table;
+    if (table.generation != eval_params_generation()) {
+        table.generation = eval_params_generation();
+        table.fits = true;
+        for (int square = 0; square < PST_SQUARES; ++square) {
+            for (int entry = 0; entry < 16; ++entry) {
+                int code = entry < 8 ? entry + 1 : entry + 2;
+                int32_t score = PIECE_SQUARE_SCORES[code * PST_SQUARES + square];
+                table.fits = table.fits && score >= -(1 << 23) && score < (1 << 23);
+                table.bytes[square][0][entry] = static_cast<uint8_t>(score);
+                table.bytes[square][1][entry] = static_cast<uint8_t>(score >> 8);
+                table.bytes[square][2][entry] = static_cast<uint8_t>(score >> 16);
+            }
+        }
+    }
+    return table;
+}
+
+// The low (0) or high (1) 128 bits of v.
+static __m128i half_of(__m256i v, int half) {
+    return half == 0 ? _mm256_castsi256_si128(v) : _mm256_extracti128_si256(v, 1);
+}
+
+// Lanes 8 * part to 8 * part + 7 of the 32 bytes in bytes, sign extended.
+static __m256i widen_part(__m256i bytes, int part) {
+    alignas(32) int8_t lanes[32];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), bytes);
+    return _mm256_cvtepi8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(lanes + 8 * part)));
+}
+
+// Evaluates the 32 positions from first on, following evaluate and
+// pawn_structure_terms with one position per byte. Everything about pawns
+// fits in a byte (counts, rows and the feature counts), so the pawn
+// structure is worked out 32 positions per instruction and only turned into
+// 32 bit scores at the end. The piece-square scores are looked up a byte at
+// a time with shuffles (see PieceSquareBytes).
+static void evaluate_32_positions(const EvalBatch& batch, size_t first, int* scores) {
+    const EvalParams& params = eval_params();
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one = _mm256_set1_epi8(1);
+    const int B = NUM_PIECE_TYPES;
+    auto load_codes = [&batch, first](int square) {
+        return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(batch.square_codes(square) + first));
+    };
+
+    // Per file, shifted by one so x - 1 and x + 1 are always valid: how many
+    // pawns and BackBenchers each team has, White's lowest structure piece
+    // and Black's highest.
+    __m256i white_pawns[10], black_pawns[10], white_lowest[10], black_highest[10];
+    for (int file = 0; file < 10; ++file) {
+        white_pawns[file] = zero;
+        black_pawns[file] = zero;
+        white_lowest[file] = _mm256_set1_epi8(8);
+        black_highest[file] = _mm256_set1_epi8(-1);
+    }
+
+    const PieceSquareBytes& table = piece_square_bytes();
+    const __m256i nine = _mm256_set1_epi8(9);
+    __m256i piece_square[4] = { zero, zero, zero, zero };
+    __m256i byte_sums[3][2] = { { zero, zero }, { zero, zero }, { zero, zero } };
+    for (int y = 0; y < 8; ++y) {
+        __m256i row = _mm256_set1_epi8(static_cast<char>(y));
+        for (int x = 0; x < 8; ++x) {
+            int square = y * 8 + x;
+            __m256i codes = load_codes(square);
+            if (table.fits) {
+                // Each byte of the scores is summed in 16 bit lanes, which
+                // can't overflow over 64 squares: positions 0-7 and 16-23
+                // end up in byte_sums[byte][0] and 8-15 and 24-31 in
+                // byte_sums[byte][1].
+                __m256i entries = _mm256_add_epi8(_mm256_sub_epi8(codes, one), _mm256_cmpgt_epi8(codes, nine));
+                for (int byte = 0; byte < 3; ++byte) {
+                    __m256i lookup = _mm256_broadcastsi128_si256(
+                        _mm_load_si128(reinterpret_cast<const __m128i*>(table.bytes[square][byte])));
+                    __m256i bytes = _mm256_shuffle_epi8(lookup, entries);
+                    __m256i extension = byte == 2 ? _mm256_cmpgt_epi8(zero, bytes) : zero;
+                    byte_sums[byte][0] = _mm256_add_epi16(byte_sums[byte][0], _mm256_unpacklo_epi8(bytes, extension));
+                    byte_sums[byte][1] = _mm256_add_epi16(byte_sums[byte][1], _mm256_unpackhi_epi8(bytes, extension));
+                }
+            }
+            else {
+                for (int part = 0; part < 4; ++part) {
+                    __m256i part_codes = _mm256_cvtepu8_epi32(_mm_loadl_epi64(
+                        reinterpret_cast<const __m128i*>(batch.square_codes(square) + first + 8 * part)));
+                    // index = code * PST_SQUARES + square
+                    __m256i indices = _mm256_add_epi32(_mm256_slli_epi32(part_codes, 6), _mm256_set1_epi32(square));
+                    piece_square[part] = _mm256_add_epi32(piece_square[part], _mm256_i32gather_epi32(PIECE_SQUARE_SCORES, indices, 4));
+                }
+            }
+
+            __m256i white_pawn = is_either(codes, PAWN, BACKBENCHER);
+            __m256i black_pawn = is_either(codes, PAWN + B, BACKBENCHER + B);
+            __m256i white_structure = _mm256_or_si256(white_pawn, _mm256_cmpeq_epi8(codes, _mm256_set1_epi8(MOUSE)));
+            __m256i black_structure = _mm256_or_si256(black_pawn, _mm256_cmpeq_epi8(codes, _mm256_set1_epi8(MOUSE + B)));
+            // The masks are -1 where set, so subtracting them counts.
+            white_pawns[x + 1] = _mm256_sub_epi8(white_pawns[x + 1], white_pawn);
+            black_pawns[x + 1] = _mm256_sub_epi8(black_pawns[x + 1], black_pawn);
+            white_lowest[x + 1] = _mm256_min_epi8(white_lowest[x + 1], _mm256_blendv_epi8(white_lowest[x + 1], row, white_structure));
+            black_highest[x + 1] = _mm256_max_epi8(black_highest[x + 1], _mm256_blendv_epi8(black_highest[x + 1], row, black_structure));
+        }
+    }
+
+    if (table.fits) {
+        for (int part = 0; part < 4; ++part) {
+            // Part 0 is positions 0-7, which are in the low half of
+            // byte_sums[byte][0], part 1 is 8-15 in the low half of
+            // byte_sums[byte][1], and so on.
+            int half = part / 2, sums = part % 2;
+            __m256i low = _mm256_cvtepu16_epi32(half_of(byte_sums[0][sums], half));
+            __m256i middle = _mm256_cvtepu16_epi32(half_of(byte_sums[1][sums], half));
+            __m256i high = _mm256_cvtepi16_epi32(half_of(byte_sums[2][sums], half));
+            piece_square[part] = _mm256_add_epi32(low, _mm256_add_epi32(
+                _mm256_slli_epi32(middle, 8), _mm256_slli_epi32(high, 16)));
+        }
+    }
+
+    // White's count minus Black's of each feature, per position.
+    __m256i doubled = zero, isolated = zero, passed[8];
+    for (int file = 1; file <= 8; ++file) {
+        doubled = _mm256_add_epi8(doubled, _mm256_max_epi8(_mm256_sub_epi8(white_pawns[file], one), zero));
+        doubled = _mm256_sub_epi8(doubled, _mm256_max_epi8(_mm256_sub_epi8(black_pawns[file], one), zero));
+    }
+    for (int rank = 0; rank < 8; ++rank) {
+        passed[rank] = zero;
+    }
+    for (int y = 0; y < 8; ++y) {
+        __m256i row = _mm256_set1_epi8(static_cast<char>(y));
+        for (int x = 0; x < 8; ++x) {
+            int file = x + 1;
+            __m256i codes = load_codes(y * 8 + x);
+            __m256i white_pawn = is_either(codes, PAWN, BACKBENCHER);
+            __m256i black_pawn = is_either(codes, PAWN + B, BACKBENCHER + B);
+
+            isolated = _mm256_sub_epi8(isolated, _mm256_and_si256(white_pawn, _mm256_and_si256(
+                _mm256_cmpeq_epi8(white_pawns[file - 1], zero), _mm256_cmpeq_epi8(white_pawns[file + 1], zero))));
+            // Passed if Black's highest structure piece on this and the
+            // neighbouring files is no higher than the pawn.
+            __m256i blocked = _mm256_or_si256(_mm256_cmpgt_epi8(black_highest[file - 1], row), _mm256_or_si256(
+                _mm256_cmpgt_epi8(black_highest[file], row), _mm256_cmpgt_epi8(black_highest[file + 1], row)));
+            passed[y] = _mm256_sub_epi8(passed[y], _mm256_andnot_si256(blocked, white_pawn));
+
+            isolated = _mm256_add_epi8(isolated, _mm256_and_si256(black_pawn, _mm256_and_si256(
+                _mm256_cmpeq_epi8(black_pawns[file - 1], zero), _mm256_cmpeq_epi8(black_pawns[file + 1], zero))));
+            blocked = _mm256_or_si256(_mm256_cmpgt_epi8(row, white_lowest[file - 1]), _mm256_or_si256(
+                _mm256_cmpgt_epi8(row, white_lowest[file]), _mm256_cmpgt_epi8(row, white_lowest[file + 1])));
+            passed[7 - y] = _mm256_add_epi8(passed[7 - y], _mm256_andnot_si256(blocked, black_pawn));
+        }
+    }
+
+    for (int part = 0; part < 4; ++part) {
+        __m256i score = piece_square[part];
+        score = _mm256_add_epi32(score, _mm256_mullo_epi32(widen_part(doubled, part), _mm256_set1_epi32(params.doubled_pawn)));
+        score = _mm256_add_epi32(score, _mm256_mullo_epi32(widen_part(isolated, part), _mm256_set1_epi32(params.isolated_pawn)));
+        for (int rank = 0; rank < 8; ++rank) {
+            score = _mm256_add_epi32(score, _mm256_mullo_epi32(widen_part(passed[rank], part), _mm256_set1_epi32(params.passed_pawn[rank])));
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(scores + 8 * part), score);
+    }
+}
+
+#elif defined(__SSE2__) || defined(_M_X64)
+
+// All ones in the bytes whose code is a or b.
+static __m128i is_either(__m128i codes, int a, int b) {
+    return _mm_or_si128(
+        _mm_cmpeq_epi8(codes, _mm_set1_epi8(static_cast<char>(a))),
+        _mm_cmpeq_epi8(codes, _mm_set1_epi8(static_cast<char>(b))));
+}
+
+// Evaluates the 16 positions from first on like the AVX2 kernel does, with
+// only the instructions every x86-64 processor has. SSE2 can't shuffle
+// bytes, so the piece-square scores are added up one position at a time,
+// but the pawn structure (most of the work) is still worked out 16
+// positions per instruction.
+static void evaluate_16_positions(const EvalBatch& batch, size_t first, int* scores) {
+    const EvalParams& params = eval_params();
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi8(1);
+    const int B = NUM_PIECE_TYPES;
+    auto load_codes = [&batch, first](int square) {
+        return _mm_loadu_si128(reinterpret_cast<const __m128i*>(batch.square_codes(square) + first));
+    };
+
+    // Like the AVX2 kernel, but rows are counted from 1 so they're never
+    // negative and SSE2's unsigned byte min and max work on them: White's
+    // lowest starts at 9 and Black's highest at 0.
+    __m128i white_pawns[10], black_pawns[10], white_lowest[10], black_highest[10];
+    for (int file = 0; file < 10; ++file) {
+        white_pawns[file] = zero;
+        black_pawns[file] = zero;
+        white_lowest[file] = _mm_set1_epi8(9);
+        black_highest[file] = zero;
+    }
+
+    int piece_square[16] = {};
+    for (int y = 0; y < 8; ++y) {
+        __m128i row = _mm_set1_epi8(static_cast<char>(y + 1));
+        for (int x = 0; x < 8; ++x) {
+            int square = y * 8 + x;
+            const uint8_t* square_codes = batch.square_codes(square) + first;
+            for (int position = 0; position < 16; ++position) {
+                piece_square[position] += piece_square_score(square_codes[position], square);
+            }
+
+            __m128i codes = load_codes(square);
+            __m128i white_pawn = is_either(codes, PAWN, BACKBENCHER);
+            __m128i black_pawn = is_either(codes, PAWN + B, BACKBENCHER + B);
+            __m128i white_structure = _mm_or_si128(white_pawn, _mm_cmpeq_epi8(codes, _mm_set1_epi8(MOUSE)));
+            __m128i black_structure = _mm_or_si128(black_pawn, _mm_cmpeq_epi8(codes, _mm_set1_epi8(MOUSE + B)));
+            white_pawns[x + 1] = _mm_sub_epi8(white_pawns[x + 1], white_pawn);
+            black_pawns[x + 1] = _mm_sub_epi8(black_pawns[x + 1], black_pawn);
+            // Cells without a structure piece offer 255 to the minimum and
+            // 0 to the maximum, so they change nothing.
+            white_lowest[x + 1] = _mm_min_epu8(white_lowest[x + 1], _mm_or_si128(row, _mm_andnot_si128(white_structure, _mm_set1_epi8(-1))));
+            black_highest[x + 1] = _mm_max_epu8(black_highest[x + 1], _mm_and_si128(row, black_structure));
+        }
+    }
+
+    __m128i doubled = zero, isolated = zero, passed[8];
+    for (int file = 1; file <= 8; ++file) {
+        doubled = _mm_add_epi8(doubled, _mm_subs_epu8(white_pawns[file], one));
+        doubled = _mm_sub_epi8(doubled, _mm_subs_epu8(black_pawns[file], one));
+    }
+    for (int rank = 0; rank < 8; ++rank) {
+        passed[rank] = zero;
+    }
+    for (int y = 0; y < 8; ++y) {
+        __m128i row = _mm_set1_epi8(static_cast<char>(y + 1));
+        for (int x = 0; x < 8; ++x) {
+            int file = x + 1;
+            __m128i codes = load_codes(y * 8 + x);
+            __m128i white_pawn = is_either(codes, PAWN, BACKBENCHER);
+            __m128i black_pawn = is_either(codes, PAWN + B, BACKBENCHER + B);
+
+            isolated = _mm_sub_epi8(isolated, _mm_and_si128(white_pawn, _mm_and_si128(
+                _mm_cmpeq_epi8(white_pawns[file - 1], zero), _mm_cmpeq_epi8(white_pawns[file + 1], zero))));
+            __m128i blocked = _mm_or_si128(_mm_cmpgt_epi8(black_highest[file - 1], row), _mm_or_si128(
+                _mm_cmpgt_epi8(black_highest[file], row), _mm_cmpgt_epi8(black_highest[file + 1], row)));
+            passed[y] = _mm_sub_epi8(passed[y], _mm_andnot_si128(blocked, white_pawn));
+
+            isolated = _mm_add_epi8(isolated, _mm_and_si128(black_pawn, _mm_and_si128(
+                _mm_cmpeq_epi8(black_pawns[file - 1], zero), _mm_cmpeq_epi8(black_pawns[file + 1], zero))));
+            blocked = _mm_or_si128(_mm_cmpgt_epi8(row, white_lowest[file - 1]), _mm_or_si128(
+                _mm_cmpgt_epi8(row, white_lowest[file]), _mm_cmpgt_epi8(row, white_lowest[file + 1])));
+            passed[7 - y] = _mm_add_epi8(passed[7 - y], _mm_andnot_si128(blocked, black_pawn));
+        }
+    }
+
+    // SSE2 can't multiply 32 bit lanes, so the counts are weighted one
+    // position at a time.
+    int8_t doubled_counts[16], isolated_counts[16], passed_counts[8][16];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(doubled_counts), doubled);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(isolated_counts), isolated);
+    for (int rank = 0; rank < 8; ++rank) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(passed_counts[rank]), passed[rank]);
+    }
+    for (int position = 0; position < 16; ++position) {
+        int score = piece_square[position] + doubled_counts[position] * params.doubled_pawn
+            + isolated_counts[position] * params.isolated_pawn;
+        for (int rank = 0; rank < 8; ++rank) {
+            score += passed_counts[rank][position] * params.passed_pawn[rank];
+        }
+        scores[position] = score;
+    }
+}
+
+#endif
+
+void evaluate_batch(const EvalBatch& batch, int* scores) {
+    size_t i = 0;
+#if defined(__AVX2__)
+    for (; i < batch.size(); i += EVAL_BATCH_PADDING) {
+        // The batch is padded, so the last group can run past size() and
+        // only its real scores are kept.
+        int group_scores[EVAL_BATCH_PADDING];
+        evaluate_32_positions(batch, i, group_scores);
+        std::copy(group_scores, group_scores + std::min(EVAL_BATCH_PADDING, batch.size() - i), scores + i);
+    }
+#elif defined(__SSE2__) || defined(_M_X64)
+    // The batch is padded to 32 positions, so 16 at a time never runs past it.
+    for (; i < batch.size(); i += 16) {
+        int group_scores[16];
+        evaluate_16_positions(batch, i, group_scores);
+        std::copy(group_scores, group_scores + std::min<size_t>(16, batch.size() - i), scores + i);
+    }
+#endif
+    uint8_t codes[PST_SQUARES];
+    for (; i < batch.size(); ++i) {
+        int score = 0;
+        for (int square = 0; square < PST_SQUARES; ++square) {
+            codes[square] = batch.square_codes(square)[i];
+            score += piece_square_score(codes[square], square);
+        }
+        scores[i] = score + pawn_structure_score(pawn_structure_terms(codes, 8, 8));
+    }
+}
@@ -0,0 +1,52 @@
+#ifndef _EVAL_BATCH_H_
+#define _EVAL_BATCH_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "chess_board.h"
+
+using std::vector;
+
+// A batch of 8x8 positions to evaluate together, stored square by square:
+// the piece codes (see Board::piece_codes) of square 0 of every position,
+// then of square 1, and so on. Evaluating the batch then works on many
+// positions at once, one square at a time, instead of one board at a time,
+// which is what searches that collect leaves (like MCTS) and dataset
+// labeling want.
+class EvalBatch {
+public:
+    // Room for capacity positions before the batch has to grow.
+    explicit EvalBatch(size_t capacity = 0);
+
+    // Adds board to the batch. Throws invalid_argument if it isn't 8x8.
+    void add(const Board& board);
+    // Adds the position with these 64 piece codes (like unpack_codes writes).
+    void add_codes(const uint8_t* codes);
+    void clear();
+    size_t size() const;
+    // The code of square in every position, indexed by position. Custom
+    // pieces are stored as the built-in piece of their type (see type_code),
+    // which is how they're evaluated. Positions past size() are padding and
+    // hold EMPTY.
+    const uint8_t* square_codes(int square) const;
+
+private:
+    size_t count;
+    // The room per square, a multiple of 32 so kernels can always read
+    // whole vectors.
+    size_t stride;
+    vector<uint8_t> codes;
+
+    void grow();
+};
+
+// Writes the static evaluation of every position in batch to scores (which
+// needs room for batch.size() scores): the material, piece-square and pawn
+// structure score that AIPlayer::eval gives without a network, positive if
+// White is ahead. With AVX2 this evaluates 32 positions at a time, and
+// otherwise (on x86-64) 16 at a time with SSE2.
+void evaluate_batch(const EvalBatch& batch, int* scores);
+
+#endif  // _EVAL_BATCH_H_
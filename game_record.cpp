@@ -0,0 +1,294 @@
+#include <cstring>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "chess_board.h"
+#include "chess_pieces.h"
+#include "game_record.h"
+
+using std::ifstream;
+using std::invalid_argument;
+using std::ios;
+using std::runtime_error;
+
+static const char GAME_RECORD_MAGIC[4] = { 'S', 'C', 'G', 'R' };
+// Bytes in a game after the names and before the starting position.
+const size_t GAME_HEADER_SIZE = 8;
+// The writer flushes its buffer to the file once it gets this big.
+const size_t WRITE_BUFFER_SIZE = 1 << 16;
+
+static uint32_t read_u32(const uint8_t* bytes) {
+    return bytes[0] | bytes[1] << 8 | bytes[2] << 16 | static_cast<uint32_t>(bytes[3]) << 24;
+}
+
+static void append_u32(vector<uint8_t>& bytes, uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        bytes.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+}
+
+static void append_name(vector<uint8_t>& bytes, const string& name) {
+    if (name.size() > 255) {
+        throw invalid_argument("GameRecordWriter: player name longer than 255 bytes: " + name);
+    }
+    bytes.push_back(static_cast<uint8_t>(name.size()));
+    bytes.insert(bytes.end(), name.begin(), name.end());
+}
+
+GameRecord::GameRecord(const Board& board, const string& white_player, const string& black_player)
+    : white_player(white_player), black_player(black_player),
+      width(board.width()), height(board.height()), first_to_move(board.teams_turn()),
+      initial_codes(board.piece_codes(), board.piece_codes() + board.width() * board.height()) {
+}
+
+GameRecordWriter::GameRecordWriter(const string& path) {
+    bool exists = static_cast<bool>(ifstream(path));
+    out.open(path, ios::binary | ios::app);
+    if (!out) {
+        throw runtime_error("GameRecordWriter: could not open " + path);
+    }
+    if (!exists) {
+        out.write(GAME_RECORD_MAGIC, sizeof(GAME_RECORD_MAGIC));
+    }
+}
+
+void GameRecordWriter::write(const GameRecord& game) {
+    int cells = game.width * game.height;
+    // The width and height are stored in a byte each.
+    if (game.width <= 0 || game.height <= 0 || game.width > 255 || game.height > 255 || cells > 256) {
+        throw invalid_argument("GameRecordWriter: boards must be 1 to 255 cells on a side, with at most 256 cells");
+    }
+    if (static_cast<int>(game.initial_codes.size()) != cells) {
+        throw invalid_argument("GameRecordWriter: initial_codes doesn't match the board size");
+    }
+    size_t start = buffer.size();
+    append_u32(buffer, 0);
+    append_name(buffer, game.white_player);
+    append_name(buffer, game.black_player);
+    buffer.push_back(static_cast<uint8_t>(game.width));
+    buffer.push_back(static_cast<uint8_t>(game.height));
+    buffer.push_back(static_cast<uint8_t>(game.first_to_move));
+    buffer.push_back(static_cast<uint8_t>(game.winner));
+    append_u32(buffer, static_cast<uint32_t>(game.moves.size()));
+    buffer.insert(buffer.end(), game.initial_codes.begin(), game.initial_codes.end());
+    for (Move move : game.moves) {
+        buffer.push_back(static_cast<uint8_t>(move.from.y * game.width + move.from.x));
+        buffer.push_back(static_cast<uint8_t>(move.to.y * game.width + move.to.x));
+    }
+    uint32_t size = static_cast<uint32_t>(buffer.size() - start);
+    for (int i = 0; i < 4; ++i) {
+        buffer[start + i] = static_cast<uint8_t>(size >> (8 * i));
+    }
+    if (buffer.size() >= WRITE_BUFFER_SIZE) {
+        flush();
+    }
+}
+
+void GameRecordWriter::flush() {
+    out.write(reinterpret_cast<const char*>(buffer.data()), buffer.size());
+    out.flush();
+    buffer.clear();
+    if (!out) {
+        throw runtime_error("GameRecordWriter: could not write the games");
+    }
+}
+
+GameRecordWriter::~GameRecordWriter() {
+    // A destructor can't throw; call flush first to find out if the last
+    // games were written.
+    try {
+        flush();
+    }
+    catch (const runtime_error&) {
+    }
+}
+
+// Checks that the game at data fits in the size bytes left in the file and
+// that its size agrees with what's in it, so GameViews never read past it.
+static bool valid_game(const uint8_t* data, size_t size) {
+    if (size < 6) {
+        return false;
+    }
+    uint32_t game_size = read_u32(data);
+    if (game_size > size) {
+        return false;
+    }
+    size_t header = 4 + 1 + data[4];
+    if (header + 1 > game_size) {
+        return false;
+    }
+    header += 1 + data[header];
+    if (header + GAME_HEADER_SIZE > game_size) {
+        return false;
+    }
+    const uint8_t* rest = data + header;
+    size_t cells = static_cast<size_t>(rest[0]) * rest[1];
+    return header + GAME_HEADER_SIZE + cells + 2 * static_cast<size_t>(read_u32(rest + 4)) == game_size;
+}
+
+GameView::GameView(const uint8_t* data, size_t available) : data(data), names(data + 4) {
+    if (!valid_game(data, available)) {
+        throw runtime_error("GameView: damaged or cut short game");
+    }
+    rest = names + 1 + names[0];
+    rest += 1 + rest[0];
+}
+
+uint32_t GameView::size() const {
+    return read_u32(data);
+}
+
+string GameView::white_player() const {
+    return string(reinterpret_cast<const char*>(names + 1), names[0]);
+}
+
+string GameView::black_player() const {
+    const uint8_t* name = names + 1 + names[0];
+    return string(reinterpret_cast<const char*>(name + 1), name[0]);
+}
+
+int GameView::width() const {
+    return rest[0];
+}
+
+int GameView::height() const {
+    return rest[1];
+}
+
+Team GameView::first_to_move() const {
+    return static_cast<Team>(rest[2]);
+}
+
+Team GameView::winner() const {
+    return static_cast<Team>(rest[3]);
+}
+
+int GameView::num_moves() const {
+    return static_cast<int>(read_u32(rest + 4));
+}
+
+Move GameView::move(int index) const {
+    const uint8_t* bytes = rest + GAME_HEADER_SIZE + width() * height() + 2 * index;
+    int w = width();
+    return Move(Cell(bytes[0] % w, bytes[0] / w), Cell(bytes[1] % w, bytes[1] / w));
+}
+
+uint8_t GameView::initial_code(int cell_index) const {
+    return rest[GAME_HEADER_SIZE + cell_index];
+}
+
+void GameView::initial_position(Board& board) const {
+    int w = width(), h = height();
+    board.clear(w, h);
+    for (int cell = 0; cell < w * h; ++cell) {
+        const ChessPiece* piece = piece_with_code(initial_code(cell));
+        if (!piece) {
+            throw runtime_error("GameView: unknown piece code in starting position");
+        }
+        board.set_piece(Cell(cell % w, cell / w), *piece);
+    }
+    board.set_teams_turn(first_to_move());
+}
+
+GameRecord GameView::to_record() const {
+    GameRecord game;
+    game.white_player = white_player();
+    game.black_player = black_player();
+    game.width = width();
+    game.height = height();
+    game.first_to_move = first_to_move();
+    game.winner = winner();
+    const uint8_t* codes = rest + GAME_HEADER_SIZE;
+    game.initial_codes.assign(codes, codes + width() * height());
+    for (int i = 0; i < num_moves(); ++i) {
+        game.moves.push_back(move(i));
+    }
+    return game;
+}
+
+GameArchive::GameArchive(const string& path) : data(nullptr), size(0) {
+#ifdef _WIN32
+    mapping_handle = nullptr;
+    file_handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file_handle == INVALID_HANDLE_VALUE) {
+        throw runtime_error("GameArchive: could not open " + path);
+    }
+    LARGE_INTEGER file_size;
+    GetFileSizeEx(file_handle, &file_size);
+    size = static_cast<size_t>(file_size.QuadPart);
+    mapping_handle = size ? CreateFileMappingA(file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+    if (mapping_handle) {
+        data = static_cast<const uint8_t*>(MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0));
+    }
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw runtime_error("GameArchive: could not open " + path);
+    }
+    struct stat info;
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+        size = static_cast<size_t>(info.st_size);
+        void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped != MAP_FAILED) {
+            data = static_cast<const uint8_t*>(mapped);
+            // Games are read front to back.
+            madvise(mapped, size, MADV_SEQUENTIAL);
+        }
+    }
+    close(fd);
+#endif
+    if (!data || size < sizeof(GAME_RECORD_MAGIC) || memcmp(data, GAME_RECORD_MAGIC, sizeof(GAME_RECORD_MAGIC)) != 0) {
+        unmap();
+        throw runtime_error("GameArchive: " + path + " is not a game record file");
+    }
+}
+
+GameArchive::~GameArchive() {
+    unmap();
+}
+
+void GameArchive::unmap() {
+#ifdef _WIN32
+    if (data) {
+        UnmapViewOfFile(data);
+    }
+    if (mapping_handle) {
+        CloseHandle(mapping_handle);
+    }
+    if (file_handle != INVALID_HANDLE_VALUE) {
+        CloseHandle(file_handle);
+    }
+    mapping_handle = nullptr;
+    file_handle = INVALID_HANDLE_VALUE;
+#else
+    if (data) {
+        munmap(const_cast<uint8_t*>(data), size);
+    }
+#endif
+    data = nullptr;
+}
+
+GameArchive::iterator& GameArchive::iterator::operator++() {
+    // Checks the game before skipping it, so a damaged size can't send the
+    // iterator past the end of the file.
+    position += GameView(position, end - position).size();
+    return *this;
+}
+
+GameArchive::iterator GameArchive::begin() const {
+    return iterator(data + sizeof(GAME_RECORD_MAGIC), data + size);
+}
+
+GameArchive::iterator GameArchive::end() const {
+    return iterator(data + size, data + size);
+}
@@ -0,0 +1,134 @@
+#ifndef _GAME_RECORD_H_
+#define _GAME_RECORD_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "chess_board.h"
+
+using std::ofstream;
+using std::string;
+using std::vector;
+
+// A whole game: who played it, the position it started from, the moves and
+// how it ended.
+struct GameRecord {
+    string white_player;
+    string black_player;
+    int width = 8;
+    int height = 8;
+    Team first_to_move = WHITE;
+    // The piece code of every cell of the starting position, indexed by
+    // y * width + x (see Board::piece_codes).
+    vector<uint8_t> initial_codes;
+    vector<Move> moves;
+    // NONE for a draw.
+    Team winner = NONE;
+
+    GameRecord() = default;
+    // A record of a game starting from board, with no moves yet.
+    GameRecord(const Board& board, const string& white_player, const string& black_player);
+};
+
+// Game record files are a 4 byte "SCGR" header followed by games. Each game
+// is stored as:
+//   uint32  size of the game in bytes, including this field
+//   uint8   length of White's name, then the name
+//   uint8   length of Black's name, then the name
+//   uint8   width, uint8 height, uint8 first_to_move, uint8 winner
+//   uint32  number of moves
+//   width * height piece codes
+//   2 bytes per move: the from and to cells as y * width + x
+// Numbers are little endian. Boards can have at most 255 cells on a side
+// and 256 cells in all. Custom pieces are stored by their codes, so games
+// with them can only be read back once the same piece definitions are
+// loaded, in the same order.
+
+// Appends games to a game record file, creating it if needed.
+class GameRecordWriter {
+    ofstream out;
+    vector<uint8_t> buffer;
+public:
+    explicit GameRecordWriter(const string& path);
+    // Writes out any games still in the buffer, ignoring errors.
+    ~GameRecordWriter();
+    // Throws invalid_argument if the board is too big to record or the
+    // record doesn't make sense.
+    void write(const GameRecord& game);
+    // Games are buffered and written to the file in large blocks; this
+    // writes the buffered ones now. Throws runtime_error if they can't be
+    // written (the disk is full, say).
+    void flush();
+};
+
+// A game inside a mapped file. It points straight into the file, so nothing
+// is copied until you ask for it.
+class GameView {
+    const uint8_t* data;
+    const uint8_t* names;
+    const uint8_t* rest;
+public:
+    // Checks that the game fits in the available bytes and that its sizes
+    // agree, and throws runtime_error if not.
+    GameView(const uint8_t* data, size_t available);
+    // The size of the game in the file, in bytes.
+    uint32_t size() const;
+    string white_player() const;
+    string black_player() const;
+    int width() const;
+    int height() const;
+    Team first_to_move() const;
+    Team winner() const;
+    int num_moves() const;
+    Move move(int index) const;
+    // The piece code of a cell of the starting position.
+    uint8_t initial_code(int cell_index) const;
+    // Sets board to the starting position.
+    void initial_position(Board& board) const;
+    GameRecord to_record() const;
+};
+
+// Maps a game record file into memory (read only) and walks through its
+// games without parsing or copying them. Throws runtime_error if the file
+// can't be opened or isn't a game record file. Each game is only checked
+// when the iterator reaches it, so opening a big file doesn't read all of
+// it; reaching a damaged or cut short game throws runtime_error.
+class GameArchive {
+    const uint8_t* data;
+    size_t size;
+#ifdef _WIN32
+    void* file_handle;
+    void* mapping_handle;
+#endif
+    void unmap();
+public:
+    explicit GameArchive(const string& path);
+    ~GameArchive();
+    GameArchive(const GameArchive&) = delete;
+    GameArchive& operator=(const GameArchive&) = delete;
+
+    class iterator {
+        const uint8_t* position;
+        const uint8_t* end;
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = GameView;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const GameView*;
+        using reference = GameView;
+
+        iterator(const uint8_t* position, const uint8_t* end) : position(position), end(end) {}
+        GameView operator*() const { return GameView(position, end - position); }
+        iterator& operator++();
+        bool operator==(const iterator& other) const { return position == other.position; }
+        bool operator!=(const iterator& other) const { return position != other.position; }
+    };
+    iterator begin() const;
+    iterator end() const;
+};
+
+#endif  // _GAME_RECORD_H_
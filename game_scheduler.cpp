@@ -0,0 +1,375 @@
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#include "chess_pieces.h"
+#include "game_scheduler.h"
+
+using std::condition_variable;
+using std::coroutine_handle;
+using std::exception_ptr;
+using std::lock_guard;
+using std::logic_error;
+using std::mutex;
+using std::runtime_error;
+using std::string;
+using std::thread;
+using std::unique_lock;
+
+// The worker the current thread is, if it's one of a pool's workers, so
+// tasks pushed from inside the pool go on the pushing worker's own queue.
+static thread_local const WorkStealingPool* current_pool = nullptr;
+static thread_local int current_worker = -1;
+
+WorkStealingPool::WorkStealingPool(int threads)
+    : queued(0), next_queue(0), steal_count(0), stopping(false) {
+    if (threads <= 0) {
+        threads = std::max(1u, thread::hardware_concurrency());
+    }
+    for (int i = 0; i < threads; ++i) {
+        queues.emplace_back(new WorkerQueue);
+    }
+    for (int i = 0; i < threads; ++i) {
+        workers.emplace_back(&WorkStealingPool::run, this, i);
+    }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        lock_guard<mutex> lock(sleep_mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (thread& worker : workers) {
+        worker.join();
+    }
+}
+
+void WorkStealingPool::push(Task task) {
+    int queue = current_pool == this ? current_worker : static_cast<int>(next_queue++ % queues.size());
+    {
+        // Counted before another worker can pop it, so queued never goes
+        // below zero.
+        lock_guard<mutex> lock(queues[queue]->mutex);
+        ++queued;
+        queues[queue]->tasks.push_back(std::move(task));
+    }
+    {
+        // Taking the lock makes sure a worker about to sleep either saw
+        // queued go up or is already waiting for this notify.
+        lock_guard<mutex> lock(sleep_mutex);
+    }
+    wake.notify_one();
+}
+
+int WorkStealingPool::size() const {
+    return static_cast<int>(workers.size());
+}
+
+vector<size_t> WorkStealingPool::queue_depths() const {
+    vector<size_t> depths;
+    for (const unique_ptr<WorkerQueue>& queue : queues) {
+        lock_guard<mutex> lock(queue->mutex);
+        depths.push_back(queue->tasks.size());
+    }
+    return depths;
+}
+
+uint64_t WorkStealingPool::steals() const {
+    return steal_count;
+}
+
+bool WorkStealingPool::pop(int worker, Task& task) {
+    {
+        WorkerQueue& own = *queues[worker];
+        lock_guard<mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+    for (size_t i = 1; i < queues.size(); ++i) {
+        WorkerQueue& other = *queues[(worker + i) % queues.size()];
+        lock_guard<mutex> lock(other.mutex);
+        if (!other.tasks.empty()) {
+            task = std::move(other.tasks.front());
+            other.tasks.pop_front();
+            ++steal_count;
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkStealingPool::run(int worker) {
+    current_pool = this;
+    current_worker = worker;
+    Task task;
+    while (true) {
+        if (pop(worker, task)) {
+            --queued;
+            task();
+            task = nullptr;
+            continue;
+        }
+        unique_lock<mutex> lock(sleep_mutex);
+        wake.wait(lock, [this] { return queued > 0 || stopping; });
+        if (queued == 0 && stopping) {
+            return;
+        }
+    }
+}
+
+ostream& operator<<(ostream& os, const SchedulerStats& stats) {
+    os << stats.games_running << " games running, " << stats.games_finished << " finished, "
+       << stats.moves << " moves, queues";
+    for (size_t depth : stats.queue_depths) {
+        os << ' ' << depth;
+    }
+    return os
+        << ", blocking queue " << stats.blocking_queue_depth << ", " << stats.steals << " steals, "
+        << "mean game " << stats.mean_game_seconds << "s (" << stats.mean_move_seconds << "s choosing moves), "
+        << "max resume delay " << stats.max_resume_delay * 1000 << "ms";
+}
+
+RemotePlayer::RemotePlayer(Team team) : Player(team) {}
+
+Move RemotePlayer::get_move(const Board& board, const vector<Move>& moves) const {
+    throw logic_error("RemotePlayer::get_move: remote players can only play in a GameScheduler");
+}
+
+void RemotePlayer::deliver(Move move) {
+    function<void(Move)> resume;
+    {
+        lock_guard<mutex> lock(move_mutex);
+        if (!waiting) {
+            has_move = true;
+            this->move = move;
+            return;
+        }
+        resume.swap(waiting);
+    }
+    resume(move);
+}
+
+void RemotePlayer::request_move(function<void(Move)> resume) {
+    Move delivered;
+    {
+        lock_guard<mutex> lock(move_mutex);
+        if (!has_move) {
+            waiting = std::move(resume);
+            return;
+        }
+        has_move = false;
+        delivered = move;
+    }
+    resume(delivered);
+}
+
+// A game's coroutine state. Games start suspended, so start_game can hand
+// them to the pool, and free themselves when they finish.
+struct GameScheduler::Game::promise_type {
+    GameScheduler* scheduler = nullptr;
+    exception_ptr error;
+
+    struct FinalAwaiter {
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(coroutine_handle<promise_type> game) noexcept {
+            // Once game_finished runs, wait() can return and the scheduler
+            // go away, so the game is freed first.
+            GameScheduler* scheduler = game.promise().scheduler;
+            exception_ptr error = game.promise().error;
+            game.destroy();
+            scheduler->game_finished(error);
+        }
+        void await_resume() const noexcept {}
+    };
+
+    Game get_return_object() { return Game{ coroutine_handle<promise_type>::from_promise(*this) }; }
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    FinalAwaiter final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() { error = std::current_exception(); }
+};
+
+GameScheduler::GameScheduler(int threads, int blocking_threads_count) : pool(threads), moves_played(0) {
+    for (int i = 0; i < blocking_threads_count; ++i) {
+        blocking_threads.emplace_back(&GameScheduler::run_blocking, this);
+    }
+}
+
+GameScheduler::~GameScheduler() {
+    {
+        unique_lock<mutex> lock(games_mutex);
+        games_done.wait(lock, [this] { return games_running == 0; });
+    }
+    {
+        lock_guard<mutex> lock(blocking_mutex);
+        stopping = true;
+    }
+    blocking_wake.notify_all();
+    for (thread& blocking_thread : blocking_threads) {
+        blocking_thread.join();
+    }
+}
+
+int GameScheduler::start_game(
+    unique_ptr<Player> white, unique_ptr<Player> black, int max_plies,
+    function<void(const GameSummary&)> done) {
+    int id;
+    {
+        lock_guard<mutex> lock(games_mutex);
+        id = next_game_id++;
+        ++games_running;
+    }
+    Game game = play_game(id, std::move(white), std::move(black), max_plies, std::move(done));
+    game.handle.promise().scheduler = this;
+    coroutine_handle<> handle = game.handle;
+    pool.push([handle] { handle.resume(); });
+    return id;
+}
+
+void GameScheduler::wait() {
+    unique_lock<mutex> lock(games_mutex);
+    games_done.wait(lock, [this] { return games_running == 0; });
+    if (first_error) {
+        exception_ptr error = first_error;
+        first_error = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+SchedulerStats GameScheduler::stats() const {
+    SchedulerStats stats;
+    stats.queue_depths = pool.queue_depths();
+    stats.steals = pool.steals();
+    stats.moves = moves_played;
+    {
+        lock_guard<mutex> lock(blocking_mutex);
+        stats.blocking_queue_depth = blocking_queue.size();
+    }
+    lock_guard<mutex> lock(games_mutex);
+    stats.games_running = games_running;
+    stats.games_finished = static_cast<int>(summaries.size());
+    for (const GameSummary& summary : summaries) {
+        stats.mean_game_seconds += summary.seconds;
+        stats.mean_move_seconds += summary.move_seconds;
+        stats.max_resume_delay = std::max(stats.max_resume_delay, summary.max_resume_delay);
+    }
+    if (!summaries.empty()) {
+        stats.mean_game_seconds /= summaries.size();
+        stats.mean_move_seconds /= summaries.size();
+    }
+    return stats;
+}
+
+static double seconds_between(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to) {
+    return std::chrono::duration<double>(to - from).count();
+}
+
+GameScheduler::Game GameScheduler::play_game(
+    int id, unique_ptr<Player> white, unique_ptr<Player> black, int max_plies,
+    function<void(const GameSummary&)> done) {
+    GameSummary summary{ id, NONE, 0, 0, 0, 0 };
+    Clock::time_point start = Clock::now();
+    Board board;
+    while (summary.plies < max_plies && !board.game_over()) {
+        vector<Move> moves = board.get_moves();
+        if (moves.empty()) {
+            break;
+        }
+        Player& player = board.teams_turn() == WHITE ? *white : *black;
+        MoveAwaiter awaiter{ *this, player, board, moves };
+        Move move = co_await awaiter;
+        summary.move_seconds += seconds_between(awaiter.asked_time, awaiter.ready_time);
+        summary.max_resume_delay = std::max(summary.max_resume_delay, seconds_between(awaiter.ready_time, awaiter.resumed_time));
+        if (std::find(moves.begin(), moves.end(), move) == moves.end()) {
+            throw runtime_error(string("GameScheduler: ") + player.name() + " chose a move that isn't allowed");
+        }
+        board.make_move(move);
+        ++summary.plies;
+        ++moves_played;
+    }
+    summary.winner = board.winner();
+    summary.seconds = seconds_between(start, Clock::now());
+    {
+        lock_guard<mutex> lock(games_mutex);
+        summaries.push_back(summary);
+    }
+    if (done) {
+        done(summary);
+    }
+}
+
+void GameScheduler::MoveAwaiter::await_suspend(coroutine_handle<> game) {
+    asked_time = Clock::now();
+    // Nothing here may touch the awaiter once the move is handed off: the
+    // game can be resumed, and the awaiter gone, before this returns.
+    if (RemotePlayer* remote = dynamic_cast<RemotePlayer*>(&player)) {
+        remote->request_move([this, game](Move delivered) {
+            move = delivered;
+            scheduler.resume(game, *this);
+        });
+        return;
+    }
+    auto choose = [this, game] {
+        try {
+            move = player.get_move(board, moves);
+        }
+        catch (...) {
+            error = std::current_exception();
+        }
+        scheduler.resume(game, *this);
+    };
+    if (player.blocks()) {
+        {
+            lock_guard<mutex> lock(scheduler.blocking_mutex);
+            scheduler.blocking_queue.push_back(choose);
+        }
+        scheduler.blocking_wake.notify_one();
+    }
+    else {
+        scheduler.pool.push(choose);
+    }
+}
+
+Move GameScheduler::MoveAwaiter::await_resume() {
+    resumed_time = Clock::now();
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    return move;
+}
+
+void GameScheduler::resume(coroutine_handle<> game, MoveAwaiter& awaiter) {
+    awaiter.ready_time = Clock::now();
+    pool.push([game] { game.resume(); });
+}
+
+void GameScheduler::run_blocking() {
+    while (true) {
+        function<void()> choose;
+        {
+            unique_lock<mutex> lock(blocking_mutex);
+            blocking_wake.wait(lock, [this] { return !blocking_queue.empty() || stopping; });
+            if (blocking_queue.empty()) {
+                return;
+            }
+            choose = std::move(blocking_queue.front());
+            blocking_queue.pop_front();
+        }
+        choose();
+    }
+}
+
+void GameScheduler::game_finished(exception_ptr error) {
+    // Notifying under the lock: once the lock is free the destructor can
+    // see no games running and destroy games_done.
+    lock_guard<mutex> lock(games_mutex);
+    if (error && !first_error) {
+        first_error = error;
+    }
+    --games_running;
+    games_done.notify_all();
+}
@@ -0,0 +1,197 @@
+#ifndef _GAME_SCHEDULER_H_
+#define _GAME_SCHEDULER_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "chess_board.h"
+#include "chess_player.h"
+
+using std::function;
+using std::ostream;
+using std::unique_ptr;
+using std::vector;
+
+// A pool of threads that each have their own queue of tasks. A worker runs
+// the newest task in its own queue first (it's the one most likely to still
+// be in cache), and when that is empty takes the oldest task from another
+// worker's queue. Tasks pushed from outside the pool are spread over the
+// queues in turn.
+class WorkStealingPool {
+public:
+    using Task = function<void()>;
+
+    // threads = 0 means one per core.
+    explicit WorkStealingPool(int threads = 0);
+    // Runs every task already pushed, then stops the workers.
+    ~WorkStealingPool();
+
+    void push(Task task);
+    int size() const;
+    // The number of tasks waiting in each worker's queue.
+    vector<size_t> queue_depths() const;
+    // How many tasks were taken from another worker's queue.
+    uint64_t steals() const;
+
+private:
+    struct WorkerQueue {
+        mutable std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+    vector<unique_ptr<WorkerQueue>> queues;
+    vector<std::thread> workers;
+    // Workers sleep on this when every queue is empty.
+    std::mutex sleep_mutex;
+    std::condition_variable wake;
+    std::atomic<size_t> queued;
+    std::atomic<size_t> next_queue;
+    std::atomic<uint64_t> steal_count;
+    bool stopping;
+
+    bool pop(int worker, Task& task);
+    void run(int worker);
+};
+
+// What happened in one game run by a GameScheduler.
+struct GameSummary {
+    int id;
+    // NONE if nobody won within the game's ply limit.
+    Team winner;
+    int plies;
+    // From the game starting to it ending.
+    double seconds;
+    // Time spent waiting for the players to choose moves.
+    double move_seconds;
+    // The longest a game was ready to carry on (its move had been chosen)
+    // before a worker picked it up again.
+    double max_resume_delay;
+};
+
+struct SchedulerStats {
+    // Tasks waiting in each worker's queue.
+    vector<size_t> queue_depths;
+    // Moves waiting for a blocking thread (see Player::blocks).
+    size_t blocking_queue_depth = 0;
+    uint64_t steals = 0;
+    int games_running = 0;
+    int games_finished = 0;
+    uint64_t moves = 0;
+    // Averages and maxima over the finished games' summaries.
+    double mean_game_seconds = 0;
+    double mean_move_seconds = 0;
+    double max_resume_delay = 0;
+};
+
+ostream& operator<<(ostream& os, const SchedulerStats& stats);
+
+class GameScheduler;
+
+// A player whose moves come from outside, like a client connected over the
+// network. Its game waits without using any thread until deliver is called
+// with the move.
+class RemotePlayer : public Player {
+public:
+    RemotePlayer(Team team);
+    // Remote players can only play in a GameScheduler.
+    Move get_move(const Board& board, const vector<Move>& moves) const override;
+    // Plays move in this player's game. A move delivered before the game
+    // asks for one is kept until it does.
+    void deliver(Move move);
+
+private:
+    friend class GameScheduler;
+    std::mutex move_mutex;
+    bool has_move = false;
+    Move move;
+    // The game waiting for a move, if any, and where to put it.
+    function<void(Move)> waiting;
+
+    // Calls resume with the next move, now or once it's delivered.
+    void request_move(function<void(Move)> resume);
+};
+
+// Runs many games at once as coroutines on a WorkStealingPool. A game only
+// holds a worker while it's making moves: asking a player for a move
+// suspends the game. Moves from computer players are searched as separate
+// pool tasks, moves from players that block (a person at the keyboard) are
+// asked for on their own threads, and remote players' games sleep until the
+// move is delivered. Either way the game carries on from whichever worker
+// picks it up next.
+class GameScheduler {
+public:
+    // threads = 0 means one per core.
+    explicit GameScheduler(int threads = 0, int blocking_threads = 1);
+    // Waits for every game to finish.
+    ~GameScheduler();
+
+    // Starts a game from the starting position that lasts at most max_plies
+    // plies, and returns its id. The scheduler owns the players until the
+    // game ends, when done (if set) is called with the game's summary.
+    int start_game(
+        unique_ptr<Player> white, unique_ptr<Player> black, int max_plies = 1000,
+        function<void(const GameSummary&)> done = nullptr);
+    // Waits until every game started so far has finished. Rethrows the first
+    // exception a game threw, like runtime_error if a player picked a move
+    // that isn't allowed.
+    void wait();
+    SchedulerStats stats() const;
+
+    // The coroutine type games run as (see play_game).
+    struct Game {
+        struct promise_type;
+        std::coroutine_handle<promise_type> handle;
+    };
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    // Suspends a game until player has chosen its move.
+    struct MoveAwaiter {
+        GameScheduler& scheduler;
+        Player& player;
+        const Board& board;
+        const vector<Move>& moves;
+        Move move;
+        std::exception_ptr error;
+        // When the move was asked for, chosen, and the game picked up again.
+        Clock::time_point asked_time, ready_time, resumed_time;
+
+        bool await_ready() const { return false; }
+        void await_suspend(std::coroutine_handle<> game);
+        Move await_resume();
+    };
+
+    WorkStealingPool pool;
+    vector<std::thread> blocking_threads;
+    mutable std::mutex blocking_mutex;
+    std::deque<function<void()>> blocking_queue;
+    std::condition_variable blocking_wake;
+    bool stopping = false;
+
+    mutable std::mutex games_mutex;
+    std::condition_variable games_done;
+    int next_game_id = 0;
+    int games_running = 0;
+    vector<GameSummary> summaries;
+    std::exception_ptr first_error;
+    std::atomic<uint64_t> moves_played;
+
+    Game play_game(int id, unique_ptr<Player> white, unique_ptr<Player> black, int max_plies, function<void(const GameSummary&)> done);
+    // Puts the game back on the pool once its move is in.
+    void resume(std::coroutine_handle<> game, MoveAwaiter& awaiter);
+    void run_blocking();
+    void game_finished(std::exception_ptr error);
+};
+
+#endif  // _GAME_SCHEDULER_H_
@@ -0,0 +1,168 @@
+#include <algorithm>
+
+#include "chess_eval.h"
+#include "move_picker.h"
+
+// 2^16 entries of 24 bytes each.
+const int MOVE_TABLE_SIZE_LOG2 = 16;
+
+MoveTable::MoveTable(int size_log2)
+    : entries(size_t(1) << size_log2, Entry{ 0, 0, Move() }), mask((uint64_t(1) << size_log2) - 1), current_search(1) {
+}
+
+void MoveTable::new_search() {
+    ++current_search;
+}
+
+bool MoveTable::probe(uint64_t key, Move& move) const {
+    const Entry& entry = entries[key & mask];
+    if (entry.key != key || entry.search != current_search) {
+        return false;
+    }
+    move = entry.move;
+    return true;
+}
+
+void MoveTable::store(uint64_t key, Move move) {
+    entries[key & mask] = Entry{ key, current_search, move };
+}
+
+MoveTable& thread_move_table() {
+    thread_local MoveTable table(MOVE_TABLE_SIZE_LOG2);
+    return table;
+}
+
+KillerMoves::KillerMoves() {
+    clear();
+}
+
+void KillerMoves::clear() {
+    std::fill(counts, counts + MAX_DEPTH, 0);
+}
+
+void KillerMoves::add(int depth, Move move) {
+    if (depth < 0 || depth >= MAX_DEPTH || (counts[depth] > 0 && moves[depth][0] == move)) {
+        return;
+    }
+    moves[depth][1] = moves[depth][0];
+    moves[depth][0] = move;
+    counts[depth] = std::min(counts[depth] + 1, 2);
+}
+
+const Move* KillerMoves::at(int depth, int& count) const {
+    if (depth < 0 || depth >= MAX_DEPTH) {
+        count = 0;
+        return nullptr;
+    }
+    count = counts[depth];
+    return moves[depth];
+}
+
+MovePicker::MovePicker(const Board& board, const Move* hash_move, const Move* killers, int num_killers)
+    : board(board), stage(PLAY_HASH_MOVE), has_hash_move(hash_move != nullptr),
+      num_killers(std::min(num_killers, 2)), killers_played(0), index(0) {
+    if (hash_move) {
+        this->hash_move = *hash_move;
+    }
+    for (int i = 0; i < this->num_killers; ++i) {
+        this->killers[i] = killers[i];
+    }
+}
+
+bool MovePicker::is_move_of_kind(Move move, MoveKind kind) const {
+    if (!board.contains(move.from) || !board.contains(move.to)) {
+        return false;
+    }
+    const ChessPiece& piece = board[move.from];
+    if (piece.type == EMPTY || piece.team != board.teams_turn()) {
+        return false;
+    }
+    thread_local vector<Move> piece_moves;
+    piece_moves.clear();
+    piece.get_moves_of_kind(board, move.from, kind, piece_moves);
+    return std::find(piece_moves.begin(), piece_moves.end(), move) != piece_moves.end();
+}
+
+bool MovePicker::already_played(Move move) const {
+    if (has_hash_move && move == hash_move) {
+        return true;
+    }
+    for (int i = 0; i < killers_played; ++i) {
+        if (move == killers[i]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool MovePicker::next(Move& move) {
+    while (true) {
+        switch (stage) {
+        case PLAY_HASH_MOVE:
+            stage = GENERATE_CAPTURES;
+            if (has_hash_move) {
+                has_hash_move = is_move_of_kind(hash_move, ALL_MOVES);
+                if (has_hash_move) {
+                    move = hash_move;
+                    return true;
+                }
+            }
+            break;
+        case GENERATE_CAPTURES:
+            moves = board.get_captures();
+            // Most valuable victim first, then least valuable attacker.
+            std::stable_sort(moves.begin(), moves.end(), [this](Move a, Move b) {
+                int victim_a = material_score(board[a.to].type), victim_b = material_score(board[b.to].type);
+                if (victim_a != victim_b) {
+                    return victim_a > victim_b;
+                }
+                return material_score(board[a.from].type) < material_score(board[b.from].type);
+            });
+            index = 0;
+            stage = PLAY_CAPTURES;
+            break;
+        case PLAY_CAPTURES:
+            while (index < moves.size()) {
+                move = moves[index++];
+                if (!already_played(move)) {
+                    return true;
+                }
+            }
+            stage = PLAY_KILLERS;
+            break;
+        case PLAY_KILLERS:
+            // Killers that were captures here, or aren't moves here at all,
+            // are dropped; the hash move was already played.
+            while (killers_played < num_killers) {
+                Move killer = killers[killers_played];
+                if (!already_played(killer) && is_move_of_kind(killer, QUIET_MOVES)) {
+                    ++killers_played;
+                    move = killer;
+                    return true;
+                }
+                // Take the killer out so already_played only sees the ones
+                // that were played.
+                killers[killers_played] = killers[num_killers - 1];
+                --num_killers;
+            }
+            stage = GENERATE_QUIETS;
+            break;
+        case GENERATE_QUIETS:
+            moves = board.get_quiet_moves();
+            index = 0;
+            stage = PLAY_QUIETS;
+            break;
+        case PLAY_QUIETS:
+            while (index < moves.size()) {
+                move = moves[index++];
+                if (!already_played(move)) {
+                    return true;
+                }
+            }
+            stage = DONE;
+            break;
+        case DONE:
+            return false;
+        }
+    }
+}
@@ -0,0 +1,109 @@
+#ifndef _MOVE_PICKER_H_
+#define _MOVE_PICKER_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "chess_board.h"
+#include "chess_pieces.h"
+
+using std::vector;
+
+// Remembers the best move a search found in each position, indexed by the
+// position's hash, so that the next time the search reaches the position (at
+// the next depth of an iterative deepening search, or through a different
+// order of moves) it tries that move first. Like EvalCache, a newer entry
+// always replaces whatever was in its slot. The table only orders moves:
+// a move read from it is checked before it's played, so a hash collision
+// costs nothing but a worse order.
+class MoveTable {
+    struct Entry {
+        uint64_t key;
+        uint32_t search;
+        Move move;
+    };
+    vector<Entry> entries;
+    uint64_t mask;
+    // Entries from earlier searches are ignored, so a search's move order
+    // only depends on the search itself.
+    uint32_t current_search;
+
+public:
+    // A table with 2^size_log2 entries.
+    explicit MoveTable(int size_log2);
+    // Forgets the moves of earlier searches.
+    void new_search();
+    // If key has a move from this search, sets move and returns true.
+    bool probe(uint64_t key, Move& move) const;
+    void store(uint64_t key, Move move);
+};
+
+// Each thread has its own table, like its eval cache.
+MoveTable& thread_move_table();
+
+// Quiet moves that made a search cut off, two for each remaining depth.
+// A move that refutes one position often refutes its siblings too.
+class KillerMoves {
+public:
+    static const int MAX_DEPTH = 64;
+
+    KillerMoves();
+    void clear();
+    // Makes move the newest killer at depth, keeping the previous one.
+    void add(int depth, Move move);
+    // The killers at depth, newest first; count is how many there are.
+    const Move* at(int depth, int& count) const;
+
+private:
+    Move moves[MAX_DEPTH][2];
+    int counts[MAX_DEPTH];
+};
+
+// Hands out the moves of a position one at a time, in the order a search
+// wants to try them: the hash move, the captures (most valuable victim
+// first, then least valuable attacker), the killers, and then the rest of
+// the quiet moves. Captures are only generated once the hash move has been
+// tried and quiet moves once the killers have, so a search that cuts off
+// early never generates them. Every move of the position comes out exactly
+// once, just like Board::get_moves.
+//
+// The board has to be in the same position every time next is called (a
+// search makes and undoes each move before asking for the next).
+class MovePicker {
+public:
+    // hash_move and killers can be nullptr. They're only played if they're
+    // moves of the position (and killers only if they're quiet).
+    MovePicker(const Board& board, const Move* hash_move, const Move* killers, int num_killers);
+    // Sets move to the next move and returns true, or returns false once
+    // every move has been handed out.
+    bool next(Move& move);
+
+private:
+    enum Stage {
+        PLAY_HASH_MOVE,
+        GENERATE_CAPTURES,
+        PLAY_CAPTURES,
+        PLAY_KILLERS,
+        GENERATE_QUIETS,
+        PLAY_QUIETS,
+        DONE,
+    };
+
+    const Board& board;
+    Stage stage;
+    bool has_hash_move;
+    Move hash_move;
+    Move killers[2];
+    int num_killers;
+    // How many killers were handed out, from the start of killers.
+    int killers_played;
+    vector<Move> moves;
+    size_t index;
+
+    // True if move is one of the position's moves of kind.
+    bool is_move_of_kind(Move move, MoveKind kind) const;
+    // True if move was already handed out before the generated moves.
+    bool already_played(Move move) const;
+};
+
+#endif  // _MOVE_PICKER_H_
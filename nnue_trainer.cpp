@@ -0,0 +1,148 @@
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+#include "chess_board.h"
+#include "chess_eval.h"
+#include "chess_nnue.h"
+#include "chess_pieces.h"
+#include "nnue_trainer.h"
+#include "position_dataset.h"
+
+using std::endl;
+using std::max;
+using std::min;
+using std::mt19937;
+using std::shuffle;
+using std::uniform_real_distribution;
+
+// How much of a training target comes from the game result; the rest comes
+// from the table evaluation.
+const float RESULT_WEIGHT = 0.5f;
+const float LEARNING_RATE = 0.01f;
+
+static float sigmoid(float x) {
+    return 1.0f / (1.0f + std::exp(-x));
+}
+
+NnueTrainingPosition make_training_position(const Board& board, float target) {
+    NnueTrainingPosition position;
+    Team own = board.teams_turn();
+    Team other = own == WHITE ? BLACK : WHITE;
+    for (int y = 0; y < board.height(); ++y) {
+        for (int x = 0; x < board.width(); ++x) {
+            Cell cell(x, y);
+            int code = board[cell].code;
+            if (code_type(code) != EMPTY) {
+                int square = pst_square(cell, board.width(), board.height());
+                position.inputs[0].push_back(static_cast<uint16_t>(nnue_input(code, square, own)));
+                position.inputs[1].push_back(static_cast<uint16_t>(nnue_input(code, square, other)));
+            }
+        }
+    }
+    position.target = target;
+    return position;
+}
+
+vector<NnueTrainingPosition> generate_selfplay_positions(int num_games, unsigned seed) {
+    vector<NnueTrainingPosition> positions;
+    for_each_selfplay_position(num_games, seed, [&](const Board& position, Team winner) {
+        bool white_to_move = position.teams_turn() == WHITE;
+        // The side to move's score: 1 for a win, 0.5 for a draw, 0 for a loss.
+        float result = winner == NONE ? 0.5f : winner == position.teams_turn() ? 1.0f : 0.0f;
+        int eval = white_to_move ? evaluate(position) : -evaluate(position);
+        float eval_score = sigmoid(static_cast<float>(eval) / NNUE_OUTPUT_SCALE);
+        float target = RESULT_WEIGHT * result + (1.0f - RESULT_WEIGHT) * eval_score;
+        positions.push_back(make_training_position(position, target));
+    });
+    return positions;
+}
+
+// Runs the float network on position. hidden gets the clipped ReLU outputs
+// (side to move first) and the return value is the raw output, in units of
+// NNUE_OUTPUT_SCALE centipawns.
+static float forward(const NnueFloatWeights& weights, const NnueTrainingPosition& position, float* hidden) {
+    float output = weights.output_bias;
+    for (int perspective = 0; perspective < 2; ++perspective) {
+        float* h = hidden + perspective * NNUE_HIDDEN;
+        for (int i = 0; i < NNUE_HIDDEN; ++i) {
+            h[i] = weights.input_biases[i];
+        }
+        for (uint16_t input : position.inputs[perspective]) {
+            const float* row = &weights.input_weights[input * NNUE_HIDDEN];
+            for (int i = 0; i < NNUE_HIDDEN; ++i) {
+                h[i] += row[i];
+            }
+        }
+        for (int i = 0; i < NNUE_HIDDEN; ++i) {
+            h[i] = max(0.0f, min(1.0f, h[i]));
+            output += h[i] * weights.output_weights[perspective * NNUE_HIDDEN + i];
+        }
+    }
+    return output;
+}
+
+double nnue_loss(const NnueFloatWeights& weights, const vector<NnueTrainingPosition>& positions) {
+    vector<float> hidden(2 * NNUE_HIDDEN);
+    double total = 0;
+    for (const NnueTrainingPosition& position : positions) {
+        float error = sigmoid(forward(weights, position, hidden.data())) - position.target;
+        total += error * error;
+    }
+    return positions.empty() ? 0 : total / positions.size();
+}
+
+NnueFloatWeights train_nnue(const vector<NnueTrainingPosition>& positions, int epochs, unsigned seed, ostream& log) {
+    mt19937 random_number_generator(seed);
+    NnueFloatWeights weights;
+    uniform_real_distribution<float> input_init(-0.05f, 0.05f);
+    uniform_real_distribution<float> output_init(-0.1f, 0.1f);
+    for (float& w : weights.input_weights) {
+        w = input_init(random_number_generator);
+    }
+    for (float& b : weights.input_biases) {
+        b = 0.25f;
+    }
+    for (float& w : weights.output_weights) {
+        w = output_init(random_number_generator);
+    }
+
+    vector<size_t> order(positions.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    vector<float> hidden(2 * NNUE_HIDDEN);
+    vector<float> hidden_gradient(NNUE_HIDDEN);
+    for (int epoch = 1; epoch <= epochs; ++epoch) {
+        shuffle(order.begin(), order.end(), random_number_generator);
+        for (size_t index : order) {
+            const NnueTrainingPosition& position = positions[index];
+            float predicted = sigmoid(forward(weights, position, hidden.data()));
+            // d(error^2)/d(output) through the sigmoid
+            float output_gradient = 2 * (predicted - position.target) * predicted * (1 - predicted);
+
+            for (int perspective = 0; perspective < 2; ++perspective) {
+                const float* h = hidden.data() + perspective * NNUE_HIDDEN;
+                float* output_weights = &weights.output_weights[perspective * NNUE_HIDDEN];
+                for (int i = 0; i < NNUE_HIDDEN; ++i) {
+                    // The clipped ReLU only passes gradients where it isn't clamped.
+                    bool active = h[i] > 0 && h[i] < 1;
+                    hidden_gradient[i] = active ? output_gradient * output_weights[i] : 0;
+                    output_weights[i] -= LEARNING_RATE * output_gradient * h[i];
+                }
+                for (uint16_t input : position.inputs[perspective]) {
+                    float* row = &weights.input_weights[input * NNUE_HIDDEN];
+                    for (int i = 0; i < NNUE_HIDDEN; ++i) {
+                        row[i] -= LEARNING_RATE * hidden_gradient[i];
+                    }
+                }
+                for (int i = 0; i < NNUE_HIDDEN; ++i) {
+                    weights.input_biases[i] -= LEARNING_RATE * hidden_gradient[i];
+                }
+            }
+            weights.output_bias -= LEARNING_RATE * output_gradient;
+        }
+        log << "epoch " << epoch << ": loss " << nnue_loss(weights, positions) << endl;
+    }
+    return weights;
+}
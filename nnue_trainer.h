@@ -0,0 +1,40 @@
+#ifndef _NNUE_TRAINER_H_
+#define _NNUE_TRAINER_H_
+
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "chess_board.h"
+#include "chess_nnue.h"
+
+using std::ostream;
+using std::vector;
+
+// One position to train on: the network inputs that are on, from the side to
+// move's perspective and then from the other team's perspective, and the
+// score the network should predict for the side to move (0 is a loss, 0.5 a
+// draw and 1 a win).
+struct NnueTrainingPosition {
+    vector<uint16_t> inputs[2];
+    float target;
+};
+
+// Turns a board into a training position with the given target.
+NnueTrainingPosition make_training_position(const Board& board, float target);
+
+// Plays num_games games of self-play from the starting position and returns
+// the positions that came up, labeled with a blend of the game's result and
+// the table evaluation (chess_eval.h) of the position. Games start with a
+// few random moves so they don't all look the same.
+vector<NnueTrainingPosition> generate_selfplay_positions(int num_games, unsigned seed);
+
+// Fits a network to positions with stochastic gradient descent, printing the
+// loss after every epoch to log.
+NnueFloatWeights train_nnue(const vector<NnueTrainingPosition>& positions, int epochs, unsigned seed, ostream& log);
+
+// The loss train_nnue minimizes: the mean squared error between the
+// network's predicted score and the targets.
+double nnue_loss(const NnueFloatWeights& weights, const vector<NnueTrainingPosition>& positions);
+
+#endif  // _NNUE_TRAINER_H_
@@ -0,0 +1,173 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+#include "chess_board.h"
+#include "chess_pieces.h"
+#include "notation.h"
+#include "piece_registry.h"
+#include "utf8_codepoint.h"
+
+using std::invalid_argument;
+
+// Notation letters for White's pieces by PieceType; Black's are lower case.
+static const char PIECE_LETTERS[NUM_PIECE_TYPES + 1] = " PNBRQKHM";
+
+// The piece code for each character, or -1 if it isn't a piece letter.
+struct LetterCodes {
+    int8_t codes[128];
+
+    LetterCodes() {
+        memset(codes, -1, sizeof(codes));
+        for (int type = PAWN; type < NUM_PIECE_TYPES; ++type) {
+            char letter = PIECE_LETTERS[type];
+            codes[static_cast<int>(letter)] = static_cast<int8_t>(type);
+            codes[letter - 'A' + 'a'] = static_cast<int8_t>(type + NUM_PIECE_TYPES);
+        }
+    }
+};
+
+static const LetterCodes LETTER_CODES;
+
+bool parse_notation(const char* begin, const char* end, Board& board) {
+    // The rows come top down, so collect the cells before building the board.
+    uint8_t codes[MAX_NOTATION_CELLS];
+    int num_cells = 0, width = 0, row_width = 0, height = 1;
+    const char* p = begin;
+    for (; p != end && *p != ' '; ++p) {
+        char c = *p;
+        if (c == '/') {
+            if (height == 1) {
+                width = row_width;
+            }
+            else if (row_width != width) {
+                return false;
+            }
+            row_width = 0;
+            ++height;
+        }
+        else if (c >= '1' && c <= '9') {
+            int run = 0;
+            for (; p != end && *p >= '0' && *p <= '9'; ++p) {
+                run = run * 10 + (*p - '0');
+                if (run > MAX_NOTATION_CELLS) {
+                    return false;
+                }
+            }
+            --p;
+            if (num_cells + run > MAX_NOTATION_CELLS) {
+                return false;
+            }
+            memset(codes + num_cells, EMPTY_SPACE.code, run);
+            num_cells += run;
+            row_width += run;
+        }
+        else {
+            int code = c >= 0 ? LETTER_CODES.codes[static_cast<int>(c)] : -1;
+            if (code < 0) {
+                // Custom pieces are written as their glyph.
+                size_t length = std::min<size_t>(utf8_sequence_length(static_cast<unsigned char>(c)), end - p);
+                char32_t glyph[4];
+                size_t bytes_used;
+                if (length == 0 || utf8_decode(p, length, glyph, &bytes_used) != 1 || bytes_used != length) {
+                    return false;
+                }
+                code = piece_registry().id_of(glyph[0]);
+                p += length - 1;
+            }
+            if (code <= EMPTY || num_cells == MAX_NOTATION_CELLS) {
+                return false;
+            }
+            codes[num_cells++] = static_cast<uint8_t>(code);
+            ++row_width;
+        }
+    }
+    if (height == 1) {
+        width = row_width;
+    }
+    if (row_width != width || width == 0) {
+        return false;
+    }
+    Team turn = WHITE;
+    if (p != end) {
+        ++p;
+        if (end - p != 1 || (*p != 'w' && *p != 'b')) {
+            return false;
+        }
+        turn = *p == 'w' ? WHITE : BLACK;
+    }
+
+    board.clear(width, height);
+    for (int y = 0; y < height; ++y) {
+        const uint8_t* row = codes + (height - 1 - y) * width;
+        for (int x = 0; x < width; ++x) {
+            if (row[x] != EMPTY_SPACE.code) {
+                board.set_piece(Cell(x, y), *piece_with_code(row[x]));
+            }
+        }
+    }
+    board.set_teams_turn(turn);
+    return true;
+}
+
+Board board_from_notation(const string& text) {
+    Board board;
+    if (!parse_notation(text.data(), text.data() + text.size(), board)) {
+        throw invalid_argument("board_from_notation: not a valid position: " + text);
+    }
+    return board;
+}
+
+static void append_number(int number, string& out) {
+    char digits[12];
+    int num_digits = 0;
+    do {
+        digits[num_digits++] = static_cast<char>('0' + number % 10);
+        number /= 10;
+    } while (number > 0);
+    while (num_digits > 0) {
+        out += digits[--num_digits];
+    }
+}
+
+void append_notation(const Board& board, string& out) {
+    const uint8_t* codes = board.piece_codes();
+    int width = board.width();
+    for (int y = board.height() - 1; y >= 0; --y) {
+        int empty_run = 0;
+        for (int x = 0; x < width; ++x) {
+            int code = codes[y * width + x];
+            if (code == EMPTY_SPACE.code) {
+                ++empty_run;
+                continue;
+            }
+            if (empty_run > 0) {
+                append_number(empty_run, out);
+                empty_run = 0;
+            }
+            if (code >= NUM_PIECE_CODES) {
+                char32_t glyph = board[Cell(x, y)].utf8_codepoint;
+                char bytes[4];
+                out.append(bytes, utf8_encode(&glyph, 1, bytes));
+                continue;
+            }
+            char letter = PIECE_LETTERS[code_type(code)];
+            out += code_team(code) == BLACK ? static_cast<char>(letter - 'A' + 'a') : letter;
+        }
+        if (empty_run > 0) {
+            append_number(empty_run, out);
+        }
+        if (y > 0) {
+            out += '/';
+        }
+    }
+    out += ' ';
+    out += board.teams_turn() == BLACK ? 'b' : 'w';
+}
+
+string board_to_notation(const Board& board) {
+    string out;
+    append_notation(board, out);
+    return out;
+}
@@ -0,0 +1,36 @@
+#ifndef _NOTATION_H_
+#define _NOTATION_H_
+
+#include <cstddef>
+#include <string>
+
+#include "chess_board.h"
+
+using std::string;
+
+// A one line notation for positions, like FEN: the rows of the board from
+// the top down separated by '/', then a space and whose turn it is ('w' or
+// 'b'). In a row, a number is that many empty cells and a letter is a piece:
+// K Q R B N P for the classical pieces, H for a BackBencher and M for a
+// Mouse, upper case for White and lower case for Black. The board's size
+// comes from the rows, so any size up to MAX_NOTATION_CELLS cells works.
+// Custom pieces (see piece_registry.h) are written as their glyph, so they
+// can only be read back if their glyph isn't a letter, digit, '/' or space.
+// The starting position is
+//   rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w
+
+const int MAX_NOTATION_CELLS = 1024;
+
+// Reads the notation in [begin, end) into board in one pass, without
+// allocating (as long as board is already the right size). Returns false,
+// leaving board alone, if the text isn't a valid position.
+bool parse_notation(const char* begin, const char* end, Board& board);
+
+// Like parse_notation, but throws invalid_argument for an invalid position.
+Board board_from_notation(const string& text);
+
+// Appends board's notation to out, reusing out's memory.
+void append_notation(const Board& board, string& out);
+string board_to_notation(const Board& board);
+
+#endif  // _NOTATION_H_
@@ -0,0 +1,136 @@
+#include <stdexcept>
+
+#include "chess_pieces.h"
+#include "piece_registry.h"
+#include "utf8_codepoint.h"
+
+using std::invalid_argument;
+
+// The built-in glyphs hash to distinct slots of a 32 entry table with this
+// multiplier (checked below when the table is built).
+const uint32_t BUILT_IN_HASH_MULTIPLIER = 0xAFD9D5ABu;
+const int BUILT_IN_HASH_BITS = 5;
+const int BUILT_IN_HASH_SLOTS = 1 << BUILT_IN_HASH_BITS;
+
+constexpr int built_in_slot(char32_t glyph) {
+    return static_cast<int>(static_cast<uint32_t>(glyph * BUILT_IN_HASH_MULTIPLIER) >> (32 - BUILT_IN_HASH_BITS));
+}
+
+// The piece code in each slot, or -1.
+struct BuiltInSlots {
+    int8_t codes[BUILT_IN_HASH_SLOTS];
+    bool perfect;
+
+    constexpr BuiltInSlots() : codes(), perfect(true) {
+        for (int slot = 0; slot < BUILT_IN_HASH_SLOTS; ++slot) {
+            codes[slot] = -1;
+        }
+        for (int code = 0; code < NUM_PIECE_CODES; ++code) {
+            if (PIECE_GLYPHS[code] == 0) {
+                continue;
+            }
+            int slot = built_in_slot(PIECE_GLYPHS[code]);
+            perfect = perfect && codes[slot] == -1;
+            codes[slot] = static_cast<int8_t>(code);
+        }
+    }
+};
+
+constexpr BuiltInSlots BUILT_IN_SLOTS;
+static_assert(BUILT_IN_SLOTS.perfect, "Two built-in glyphs hash to the same slot; pick a new BUILT_IN_HASH_MULTIPLIER");
+
+// The code of the built-in piece drawn as glyph, or -1.
+static int built_in_code(char32_t glyph) {
+    int code = BUILT_IN_SLOTS.codes[built_in_slot(glyph)];
+    return code >= 0 && PIECE_GLYPHS[code] == glyph ? code : -1;
+}
+
+// Fibonacci hashing: the high bits of the product depend on every bit of
+// the glyph, while the low bits only depend on its low bits.
+static size_t table_slot(char32_t glyph, int bits) {
+    return (static_cast<uint32_t>(glyph) * 0x9E3779B1u) >> (32 - bits);
+}
+
+PieceRegistry::PieceRegistry() : table(16, Entry{ 0, -1 }), table_bits(4), num_added(0) {}
+
+int PieceRegistry::id_of(char32_t glyph) const {
+    int code = built_in_code(glyph);
+    if (code >= 0 || num_added == 0 || glyph == 0) {
+        return code;
+    }
+    size_t mask = table.size() - 1;
+    for (size_t slot = table_slot(glyph, table_bits); table[slot].glyph != 0; slot = (slot + 1) & mask) {
+        if (table[slot].glyph == glyph) {
+            return table[slot].id;
+        }
+    }
+    return -1;
+}
+
+const ChessPiece* PieceRegistry::find(char32_t glyph) const {
+    return piece(id_of(glyph));
+}
+
+const ChessPiece* PieceRegistry::piece(int id) const {
+    if (id < 0) {
+        return nullptr;
+    }
+    if (id < NUM_PIECE_CODES) {
+        return BUILT_IN_PIECES[id];
+    }
+    if (id - NUM_PIECE_CODES < static_cast<int>(added.size())) {
+        return added[id - NUM_PIECE_CODES];
+    }
+    return nullptr;
+}
+
+int PieceRegistry::size() const {
+    return NUM_PIECE_CODES + static_cast<int>(added.size());
+}
+
+void PieceRegistry::grow() {
+    vector<Entry> old_table(2 * table.size(), Entry{ 0, -1 });
+    old_table.swap(table);
+    ++table_bits;
+    size_t mask = table.size() - 1;
+    for (const Entry& entry : old_table) {
+        if (entry.glyph != 0) {
+            size_t slot = table_slot(entry.glyph, table_bits);
+            while (table[slot].glyph != 0) {
+                slot = (slot + 1) & mask;
+            }
+            table[slot] = entry;
+        }
+    }
+}
+
+int PieceRegistry::add(const ChessPiece& piece) {
+    char32_t glyph = piece.utf8_codepoint;
+    if (glyph == 0 || id_of(glyph) >= 0) {
+        throw invalid_argument("PieceRegistry::add: a piece already uses that glyph");
+    }
+    int id = piece.code;
+    if (id < NUM_PIECE_CODES || this->piece(id) != nullptr) {
+        throw invalid_argument("PieceRegistry::add: a piece already uses that code");
+    }
+    if (2 * (num_added + 1) > static_cast<int>(table.size())) {
+        grow();
+    }
+    size_t mask = table.size() - 1;
+    size_t slot = table_slot(glyph, table_bits);
+    while (table[slot].glyph != 0) {
+        slot = (slot + 1) & mask;
+    }
+    table[slot] = Entry{ glyph, id };
+    if (id >= size()) {
+        added.resize(id - NUM_PIECE_CODES + 1, nullptr);
+    }
+    added[id - NUM_PIECE_CODES] = &piece;
+    ++num_added;
+    return id;
+}
+
+PieceRegistry& piece_registry() {
+    static PieceRegistry registry;
+    return registry;
+}
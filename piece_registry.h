@@ -0,0 +1,52 @@
+#ifndef _PIECE_REGISTRY_H_
+#define _PIECE_REGISTRY_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "chess_pieces.h"
+
+using std::vector;
+
+// Finds pieces by their glyph. The built-in pieces are found through a
+// perfect hash worked out at compile time (one multiply, one shift and one
+// compare); custom pieces added at run time go in a flat open addressing
+// hash table. A piece's ID is its ChessPiece::code, which is what boards
+// store and what the evaluation and hash tables are indexed by: the built-in
+// pieces' codes are below NUM_PIECE_CODES, and custom pieces get theirs from
+// new_piece_code.
+class PieceRegistry {
+    struct Entry {
+        // 0 marks an empty slot.
+        char32_t glyph;
+        int id;
+    };
+    // 2^table_bits entries, never more than half full.
+    vector<Entry> table;
+    int table_bits;
+    // Added pieces by ID - NUM_PIECE_CODES, with nullptr for codes given to
+    // pieces that weren't added to this registry.
+    vector<const ChessPiece*> added;
+    int num_added;
+
+    void grow();
+public:
+    PieceRegistry();
+    // The piece drawn as glyph, or nullptr if there isn't one.
+    const ChessPiece* find(char32_t glyph) const;
+    // The ID of the piece drawn as glyph, or -1 if there isn't one.
+    int id_of(char32_t glyph) const;
+    // The piece with this ID, or nullptr.
+    const ChessPiece* piece(int id) const;
+    // One more than the largest ID.
+    int size() const;
+    // Registers a custom piece (which has to outlive the registry) and
+    // returns its ID. Throws invalid_argument if its glyph or code is taken.
+    int add(const ChessPiece& piece);
+};
+
+// The registry the board readers use. Add custom pieces to it before other
+// threads start reading boards.
+PieceRegistry& piece_registry();
+
+#endif  // _PIECE_REGISTRY_H_
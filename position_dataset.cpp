@@ -0,0 +1,161 @@
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+
+#include "chess_board.h"
+#include "chess_pieces.h"
+#include "chess_player.h"
+#include "position_dataset.h"
+
+using std::ifstream;
+using std::ios;
+using std::mt19937;
+using std::runtime_error;
+
+static const char DATASET_MAGIC[4] = { 'S', 'C', 'P', 'D' };
+// Positions read from disk at a time by read_dataset.
+const size_t DATASET_CHUNK = 1 << 16;
+
+// Moves played at random at the start of each self-play game.
+const int RANDOM_OPENING_PLIES = 8;
+// Games that go on longer than this are counted as draws.
+const int MAX_SELFPLAY_PLIES = 300;
+
+static_assert(sizeof(PackedPosition) == 25, "PackedPosition should be 25 bytes");
+
+// Piece codes (0 - NUM_PIECE_CODES) to/from the 4 bit pieces used in packing.
+static int code_to_nibble(int code) {
+    int type = code % NUM_PIECE_TYPES;
+    return (code >= NUM_PIECE_TYPES ? 8 : 0) + type - 1;
+}
+
+static int nibble_to_code(int nibble) {
+    int type = (nibble & 7) + 1;
+    return nibble >= 8 ? type + NUM_PIECE_TYPES : type;
+}
+
+bool pack_position(const Board& board, Team winner, PackedPosition& packed) {
+    if (board.width() != 8 || board.height() != 8) {
+        return false;
+    }
+    memset(&packed, 0, sizeof(packed));
+    const uint8_t* codes = board.piece_codes();
+    int num_pieces = 0;
+    for (int cell = 0; cell < 64; ++cell) {
+        if (codes[cell] == EMPTY_SPACE.code) {
+            continue;
+        }
+        if (num_pieces == 32 || codes[cell] >= NUM_PIECE_CODES) {
+            return false;
+        }
+        packed.occupancy[cell / 8] |= 1 << (cell % 8);
+        packed.pieces[num_pieces / 2] |= code_to_nibble(codes[cell]) << (num_pieces % 2 * 4);
+        ++num_pieces;
+    }
+    int result = winner == BLACK ? 0 : winner == WHITE ? 2 : 1;
+    packed.flags = (board.teams_turn() == BLACK ? 1 : 0) | result << 1;
+    return true;
+}
+
+void unpack_codes(const PackedPosition& packed, uint8_t* codes) {
+    int num_pieces = 0;
+    for (int cell = 0; cell < 64; ++cell) {
+        if (packed.occupancy[cell / 8] & (1 << (cell % 8))) {
+            int nibble = packed.pieces[num_pieces / 2] >> (num_pieces % 2 * 4) & 0xF;
+            codes[cell] = static_cast<uint8_t>(nibble_to_code(nibble));
+            ++num_pieces;
+        }
+        else {
+            codes[cell] = EMPTY_SPACE.code;
+        }
+    }
+}
+
+void unpack_position(const PackedPosition& packed, Board& board) {
+    uint8_t codes[64];
+    unpack_codes(packed, codes);
+    // Start from an empty 8x8 board, so a board of another size or one with
+    // moves to undo can be reused.
+    board.clear(8, 8);
+    for (int cell = 0; cell < 64; ++cell) {
+        board.set_piece(Cell(cell % 8, cell / 8), *piece_with_code(codes[cell]));
+    }
+    board.set_teams_turn(packed_teams_turn(packed));
+}
+
+Team packed_teams_turn(const PackedPosition& packed) {
+    return packed.flags & 1 ? BLACK : WHITE;
+}
+
+float packed_white_score(const PackedPosition& packed) {
+    return (packed.flags >> 1 & 3) * 0.5f;
+}
+
+DatasetWriter::DatasetWriter(const string& path) {
+    bool exists = static_cast<bool>(ifstream(path));
+    out.open(path, ios::binary | ios::app);
+    if (!out) {
+        throw runtime_error("DatasetWriter: could not open " + path);
+    }
+    if (!exists) {
+        out.write(DATASET_MAGIC, sizeof(DATASET_MAGIC));
+    }
+}
+
+void DatasetWriter::write(const PackedPosition& position) {
+    out.write(reinterpret_cast<const char*>(&position), sizeof(position));
+}
+
+vector<PackedPosition> read_dataset(const string& path) {
+    ifstream in(path, ios::binary);
+    char magic[4];
+    if (!in.read(magic, sizeof(magic)) || memcmp(magic, DATASET_MAGIC, sizeof(magic)) != 0) {
+        throw runtime_error("read_dataset: " + path + " is not a position dataset");
+    }
+    vector<PackedPosition> positions;
+    while (in) {
+        size_t old_size = positions.size();
+        positions.resize(old_size + DATASET_CHUNK);
+        in.read(reinterpret_cast<char*>(&positions[old_size]), DATASET_CHUNK * sizeof(PackedPosition));
+        positions.resize(old_size + in.gcount() / sizeof(PackedPosition));
+        if (in.gcount() % sizeof(PackedPosition) != 0) {
+            throw runtime_error("read_dataset: " + path + " ends partway through a position");
+        }
+    }
+    positions.shrink_to_fit();
+    return positions;
+}
+
+void for_each_selfplay_position(int num_games, unsigned seed, const function<void(const Board&, Team)>& visit) {
+    mt19937 random_number_generator(seed);
+    // The players' seeds come from seed too, so the same seed always plays
+    // the same games.
+    unsigned white_seed = random_number_generator(), black_seed = random_number_generator();
+    CheckMateCapturePlayer white(WHITE, white_seed), black(BLACK, black_seed);
+    vector<Board> seen;
+    for (int game = 0; game < num_games; ++game) {
+        Board board;
+        seen.clear();
+        for (int ply = 0; ply < MAX_SELFPLAY_PLIES && !board.game_over(); ++ply) {
+            vector<Move> moves = board.get_moves();
+            if (moves.empty()) {
+                break;
+            }
+            Move move;
+            if (ply < RANDOM_OPENING_PLIES) {
+                move = moves[random_number_generator() % moves.size()];
+            }
+            else {
+                seen.push_back(board);
+                Player& player = board.teams_turn() == WHITE ? static_cast<Player&>(white) : black;
+                move = player.get_move(board, moves);
+            }
+            board.make_move(move);
+        }
+        Team winner = board.winner();
+        for (const Board& position : seen) {
+            visit(position, winner);
+        }
+    }
+}
@@ -0,0 +1,62 @@
+#ifndef _POSITION_DATASET_H_
+#define _POSITION_DATASET_H_
+
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "chess_board.h"
+
+using std::function;
+using std::ofstream;
+using std::string;
+using std::vector;
+
+// A labeled 8x8 position packed into 25 bytes, so millions of them fit in
+// memory: which cells are occupied, a 4 bit piece for each occupied cell, and
+// who was to move and who won the game the position came from.
+struct PackedPosition {
+    // Bit y * 8 + x is set if that cell has a piece (little endian).
+    uint8_t occupancy[8];
+    // The pieces of the occupied cells in cell order, two per byte (low
+    // nibble first). White's piece types 1-8 are 0-7 and Black's are 8-15.
+    uint8_t pieces[16];
+    // Bit 0: Black to move. Bits 1-2: 0 if Black won, 1 for a draw and 2 if
+    // White won.
+    uint8_t flags;
+};
+
+// Packs board, labeled with the game's winner (NONE for a draw). Returns
+// false if the board isn't 8x8, has more than 32 pieces or has custom pieces
+// (the 4 bit packing only has room for the built-in pieces).
+bool pack_position(const Board& board, Team winner, PackedPosition& packed);
+// Writes the 64 piece codes of packed (see Board::piece_codes) to codes.
+void unpack_codes(const PackedPosition& packed, uint8_t* codes);
+// Replaces whatever board holds with the packed position.
+void unpack_position(const PackedPosition& packed, Board& board);
+Team packed_teams_turn(const PackedPosition& packed);
+// White's score in the game: 1 for a win, 0.5 for a draw and 0 for a loss.
+float packed_white_score(const PackedPosition& packed);
+
+// Appends positions to a dataset file, creating it if needed. A dataset file
+// is a 4 byte "SCPD" header followed by PackedPositions.
+class DatasetWriter {
+    ofstream out;
+public:
+    explicit DatasetWriter(const string& path);
+    void write(const PackedPosition& position);
+};
+
+// Reads every position in a dataset file, a chunk at a time. Throws
+// runtime_error if it isn't a dataset file or ends partway through a
+// position (a writer that was stopped mid-write).
+vector<PackedPosition> read_dataset(const string& path);
+
+// Plays num_games self-play games and calls visit with each position reached
+// (after a few random opening moves) and the winner of the game it was in.
+// The same seed always gives the same positions.
+void for_each_selfplay_position(int num_games, unsigned seed, const function<void(const Board&, Team)>& visit);
+
+#endif  // _POSITION_DATASET_H_
@@ -0,0 +1,319 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "chess_player.h"
+#include "sharded_tournament.h"
+#include "tournament.h"
+
+using std::deque;
+using std::endl;
+using std::ifstream;
+using std::invalid_argument;
+using std::ios;
+using std::ofstream;
+using std::runtime_error;
+using std::vector;
+
+// A shard that brings down this many workers in a row stops the tournament.
+const int MAX_SHARD_ATTEMPTS = 3;
+
+// What a worker sends back for each shard, and what the journal holds.
+struct ShardResult {
+    uint32_t shard;
+    uint32_t first_wins;
+    uint32_t draws;
+    uint32_t second_wins;
+    double seconds;
+};
+
+static_assert(sizeof(ShardResult) == 24, "ShardResult should have no padding");
+
+// The start of a journal file: a magic number and everything that decides
+// which games the tournament plays (including a hash of the network "nnue"
+// players use), so a journal is never used for the wrong tournament.
+static string journal_header(const ShardedTournamentOptions& options) {
+    const TournamentOptions& tournament = options.tournament;
+    string header = "SCSJ";
+    auto add_u32 = [&header](uint32_t value) {
+        header.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    };
+    add_u32(tournament.first_game);
+    add_u32(tournament.games);
+    add_u32(options.shard_games);
+    add_u32(tournament.seed);
+    add_u32(tournament.max_plies);
+    add_u32(tournament.no_capture_limit);
+    for (const string& player : { tournament.first_player, tournament.second_player }) {
+        add_u32(static_cast<uint32_t>(player.size()));
+        header += player;
+    }
+    add_u32(tournament.network != nullptr);
+    if (tournament.network) {
+        uint64_t network_hash = tournament.network->hash();
+        header.append(reinterpret_cast<const char*>(&network_hash), sizeof(network_hash));
+    }
+    return header;
+}
+
+// Reads the shards already finished from the journal at path, creating it
+// if it doesn't exist.
+static vector<ShardResult> read_journal(const string& path, const string& header) {
+    vector<ShardResult> results;
+    ifstream in(path, ios::binary);
+    if (in) {
+        string existing(header.size(), '\0');
+        in.read(&existing[0], existing.size());
+        if (in.gcount() != 0 && (in.gcount() != static_cast<std::streamsize>(header.size()) || existing != header)) {
+            throw runtime_error("run_sharded_tournament: " + path + " is the journal of a different tournament");
+        }
+        // A coordinator that died mid-write can leave half a result at the
+        // end, which is dropped.
+        ShardResult result;
+        while (in.read(reinterpret_cast<char*>(&result), sizeof(result))) {
+            results.push_back(result);
+        }
+        if (in.gcount() != 0 || results.empty()) {
+            in.close();
+            // Rewrite the file without the partial result (or with just a header).
+            ofstream out(path, ios::binary | ios::trunc);
+            out.write(header.data(), header.size());
+            out.write(reinterpret_cast<const char*>(results.data()), results.size() * sizeof(ShardResult));
+        }
+        return results;
+    }
+    ofstream out(path, ios::binary);
+    if (!out.write(header.data(), header.size())) {
+        throw runtime_error("run_sharded_tournament: could not write " + path);
+    }
+    return results;
+}
+
+static void add_shard(TournamentResult& result, const ShardResult& shard) {
+    result.first_wins += shard.first_wins;
+    result.draws += shard.draws;
+    result.second_wins += shard.second_wins;
+}
+
+#ifdef _WIN32
+
+TournamentResult run_sharded_tournament(const ShardedTournamentOptions& options, ostream& log) {
+    throw runtime_error("run_sharded_tournament: worker processes need fork, which Windows doesn't have");
+}
+
+#else
+
+// Sends or receives exactly size bytes. Returns false if the other end has
+// gone away.
+static bool send_all(int fd, const void* data, size_t size) {
+    const char* bytes = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t sent = send(fd, bytes, size, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent <= 0) {
+            return false;
+        }
+        bytes += sent;
+        size -= sent;
+    }
+    return true;
+}
+
+static bool receive_all(int fd, void* data, size_t size) {
+    char* bytes = static_cast<char*>(data);
+    while (size > 0) {
+        ssize_t received = recv(fd, bytes, size, 0);
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        if (received <= 0) {
+            return false;
+        }
+        bytes += received;
+        size -= received;
+    }
+    return true;
+}
+
+// A worker process: plays each shard it's sent and sends back the result,
+// until the coordinator closes the socket.
+[[noreturn]] static void run_worker(int fd, const ShardedTournamentOptions& options) {
+    const TournamentOptions& tournament = options.tournament;
+    uint32_t shard;
+    while (receive_all(fd, &shard, sizeof(shard))) {
+        TournamentOptions shard_options = tournament;
+        shard_options.threads = std::max(1, tournament.threads);
+        shard_options.first_game = tournament.first_game + shard * options.shard_games;
+        shard_options.games = std::min(options.shard_games, tournament.games - static_cast<int>(shard) * options.shard_games);
+        ShardResult result;
+        try {
+            TournamentResult played = run_tournament(shard_options);
+            result = ShardResult{ shard, static_cast<uint32_t>(played.first_wins),
+                static_cast<uint32_t>(played.draws), static_cast<uint32_t>(played.second_wins), played.seconds };
+        }
+        catch (...) {
+            _exit(1);
+        }
+        if (!send_all(fd, &result, sizeof(result))) {
+            break;
+        }
+    }
+    // _exit, so the worker doesn't run the destructors of the coordinator's
+    // objects that fork copied.
+    _exit(0);
+}
+
+struct WorkerProcess {
+    pid_t pid;
+    int fd;
+    // The shard it's playing, or -1.
+    int shard;
+};
+
+TournamentResult run_sharded_tournament(const ShardedTournamentOptions& options, ostream& log) {
+    const TournamentOptions& tournament = options.tournament;
+    if (!tournament.record_path.empty()) {
+        throw invalid_argument("run_sharded_tournament: worker processes can't share a game record file");
+    }
+    if (options.shard_games <= 0 || tournament.games < 0) {
+        throw invalid_argument("run_sharded_tournament: shards need at least one game");
+    }
+    // Bad player kinds fail here instead of in every worker.
+    make_player(tournament.first_player, WHITE, 0, tournament.network);
+    make_player(tournament.second_player, WHITE, 0, tournament.network);
+
+    auto start = std::chrono::steady_clock::now();
+    int num_shards = (tournament.games + options.shard_games - 1) / options.shard_games;
+    TournamentResult result;
+    vector<bool> finished(num_shards, false);
+    ofstream journal;
+    if (!options.journal_path.empty()) {
+        for (const ShardResult& shard : read_journal(options.journal_path, journal_header(options))) {
+            if (shard.shard < finished.size() && !finished[shard.shard]) {
+                finished[shard.shard] = true;
+                add_shard(result, shard);
+            }
+        }
+        journal.open(options.journal_path, ios::binary | ios::app);
+    }
+    deque<int> queue;
+    for (int shard = 0; shard < num_shards; ++shard) {
+        if (!finished[shard]) {
+            queue.push_back(shard);
+        }
+    }
+    log << num_shards - queue.size() << " of " << num_shards << " shards already in the journal" << endl;
+
+    int processes = options.processes > 0 ? options.processes : std::max(1u, std::thread::hardware_concurrency());
+    vector<WorkerProcess> workers;
+    vector<int> attempts(num_shards, 0);
+    auto hand_out = [&](WorkerProcess& worker) {
+        if (queue.empty()) {
+            // Nothing left, so let the worker finish.
+            shutdown(worker.fd, SHUT_WR);
+            worker.shard = -1;
+            return;
+        }
+        worker.shard = queue.front();
+        queue.pop_front();
+        uint32_t shard = worker.shard;
+        // If the worker is already gone this shows up as a hang-up below.
+        send_all(worker.fd, &shard, sizeof(shard));
+    };
+
+    while (!queue.empty() || !workers.empty()) {
+        // Checked before each hand_out, which takes a shard off the queue.
+        while (static_cast<int>(workers.size()) < processes && !queue.empty()) {
+            int fds[2];
+            if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+                throw runtime_error("run_sharded_tournament: could not create a socket");
+            }
+            log.flush();
+            pid_t pid = fork();
+            if (pid < 0) {
+                throw runtime_error("run_sharded_tournament: could not fork a worker");
+            }
+            if (pid == 0) {
+                close(fds[0]);
+                for (const WorkerProcess& other : workers) {
+                    close(other.fd);
+                }
+                run_worker(fds[1], options);
+            }
+            close(fds[1]);
+            workers.push_back(WorkerProcess{ pid, fds[0], -1 });
+            hand_out(workers.back());
+        }
+
+        vector<pollfd> polls;
+        for (const WorkerProcess& worker : workers) {
+            polls.push_back(pollfd{ worker.fd, POLLIN, 0 });
+        }
+        if (poll(polls.data(), polls.size(), -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw runtime_error("run_sharded_tournament: poll failed");
+        }
+        for (size_t i = polls.size(); i-- > 0;) {
+            if (polls[i].revents == 0) {
+                continue;
+            }
+            WorkerProcess& worker = workers[i];
+            ShardResult shard;
+            if (worker.shard >= 0 && receive_all(worker.fd, &shard, sizeof(shard))) {
+                finished[shard.shard] = true;
+                add_shard(result, shard);
+                if (journal.is_open()) {
+                    journal.write(reinterpret_cast<const char*>(&shard), sizeof(shard));
+                    journal.flush();
+                }
+                log << "shard " << shard.shard << " (games " << tournament.first_game + shard.shard * options.shard_games
+                    << "-): +" << shard.first_wins << " =" << shard.draws << " -" << shard.second_wins << endl;
+                hand_out(worker);
+                continue;
+            }
+            // The worker has exited, finished or not.
+            close(worker.fd);
+            int status = 0;
+            waitpid(worker.pid, &status, 0);
+            if (worker.shard >= 0) {
+                log << "worker " << worker.pid << " died playing shard " << worker.shard << ", playing it again" << endl;
+                if (++attempts[worker.shard] >= MAX_SHARD_ATTEMPTS) {
+                    for (const WorkerProcess& other : workers) {
+                        if (other.pid != worker.pid) {
+                            kill(other.pid, SIGKILL);
+                            close(other.fd);
+                            waitpid(other.pid, &status, 0);
+                        }
+                    }
+                    throw runtime_error("run_sharded_tournament: shard " + std::to_string(worker.shard) + " failed too many times");
+                }
+                queue.push_front(worker.shard);
+            }
+            workers.erase(workers.begin() + i);
+        }
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+#endif
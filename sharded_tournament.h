@@ -0,0 +1,44 @@
+#ifndef _SHARDED_TOURNAMENT_H_
+#define _SHARDED_TOURNAMENT_H_
+
+#include <iostream>
+#include <string>
+
+#include "tournament.h"
+
+using std::ostream;
+using std::string;
+
+// A tournament split into shards of games, each played by run_tournament in
+// a worker process forked from this one. The coordinator hands shards out
+// over a Unix socket to each worker as it finishes its last one, so the
+// games spread out like run_tournament's threads, and since every game is
+// seeded from its index the result is the same as run_tournament's.
+//
+// If a worker dies, its shard goes back on the queue and a new worker is
+// forked. With a journal, every finished shard's result is also appended to
+// a file, and running the same tournament again with the same journal only
+// plays the shards that aren't in it, so a crashed or interrupted
+// tournament can carry on where it stopped.
+//
+// Workers are separate processes, so players with big tables don't share
+// memory. Only works where fork does (not on Windows).
+struct ShardedTournamentOptions {
+    // threads is the threads in each worker (0 means 1, since there's a
+    // worker per core already), and record_path has to be empty (workers
+    // can't share a record file).
+    TournamentOptions tournament;
+    // Worker processes, 0 for one per core.
+    int processes = 0;
+    int shard_games = 10;
+    // The journal file, or empty for none.
+    string journal_path;
+};
+
+// Plays the tournament and prints a line to log as each shard finishes or a
+// worker dies. Throws invalid_argument if the options can't be sharded and
+// runtime_error if the journal belongs to a different tournament or a shard
+// keeps failing.
+TournamentResult run_sharded_tournament(const ShardedTournamentOptions& options, ostream& log);
+
+#endif  // _SHARDED_TOURNAMENT_H_
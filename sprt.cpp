@@ -0,0 +1,97 @@
+#include <algorithm>
+#include <cmath>
+
+#include "sprt.h"
+#include "tournament.h"
+
+using std::endl;
+
+// The expected score of a player elo points stronger than its opponent.
+static double elo_to_score(double elo) {
+    return 1.0 / (1.0 + std::pow(10.0, -elo / 400.0));
+}
+
+static double score_to_elo(double score) {
+    return -400.0 * std::log10(1.0 / score - 1.0);
+}
+
+// The mean score per game and its variance. A result that never happened is
+// counted as half a game, so the variance isn't 0 after a run of wins.
+static void score_statistics(const TournamentResult& results, double& n, double& mean, double& variance) {
+    double wins = results.first_wins, draws = results.draws, losses = results.second_wins;
+    if (wins == 0 || draws == 0 || losses == 0) {
+        wins += 0.5;
+        draws += 0.5;
+        losses += 0.5;
+    }
+    n = wins + draws + losses;
+    mean = (wins + 0.5 * draws) / n;
+    variance = (wins * (1 - mean) * (1 - mean) + draws * (0.5 - mean) * (0.5 - mean) + losses * mean * mean) / n;
+}
+
+double sprt_llr(const TournamentResult& results, double elo0, double elo1) {
+    if (results.games() == 0) {
+        return 0;
+    }
+    double n, mean, variance;
+    score_statistics(results, n, mean, variance);
+    double score0 = elo_to_score(elo0), score1 = elo_to_score(elo1);
+    return results.games() * (score1 - score0) * (2 * mean - score0 - score1) / (2 * variance);
+}
+
+void update_sprt(SprtResult& result, const SprtOptions& options) {
+    result.lower_bound = std::log(options.beta / (1 - options.alpha));
+    result.upper_bound = std::log((1 - options.beta) / options.alpha);
+    result.llr = sprt_llr(result.games, options.elo0, options.elo1);
+    if (result.llr >= result.upper_bound) {
+        result.decision = SPRT_ACCEPT_H1;
+    }
+    else if (result.llr <= result.lower_bound) {
+        result.decision = SPRT_ACCEPT_H0;
+    }
+    else {
+        result.decision = SPRT_CONTINUE;
+    }
+    if (result.games.games() == 0) {
+        result.elo = result.elo_error = 0;
+        return;
+    }
+    double n, mean, variance;
+    score_statistics(result.games, n, mean, variance);
+    double error = 1.96 * std::sqrt(variance / result.games.games());
+    result.elo = score_to_elo(mean);
+    // The interval is symmetric in score, not in Elo, so report the wider side.
+    double low = score_to_elo(std::max(mean - error, 1e-6)), high = score_to_elo(std::min(mean + error, 1 - 1e-6));
+    result.elo_error = std::max(result.elo - low, high - result.elo);
+}
+
+ostream& operator<<(ostream& os, const SprtResult& result) {
+    os
+        << result.games << ", Elo " << result.elo << " +/- " << result.elo_error
+        << ", LLR " << result.llr << " (" << result.lower_bound << ", " << result.upper_bound << ")";
+    if (result.decision == SPRT_ACCEPT_H1) {
+        os << ": H1 accepted";
+    }
+    else if (result.decision == SPRT_ACCEPT_H0) {
+        os << ": H0 accepted";
+    }
+    return os;
+}
+
+SprtResult run_sprt(const SprtOptions& options, ostream& log) {
+    SprtResult result;
+    TournamentOptions batch = options.match;
+    int batch_games = std::max(2, options.batch_games + options.batch_games % 2);
+    while (result.decision == SPRT_CONTINUE && result.games.games() < options.max_games) {
+        batch.first_game = result.games.games();
+        batch.games = std::min(batch_games, options.max_games - result.games.games());
+        TournamentResult played = run_tournament(batch);
+        result.games.first_wins += played.first_wins;
+        result.games.draws += played.draws;
+        result.games.second_wins += played.second_wins;
+        result.games.seconds += played.seconds;
+        update_sprt(result, options);
+        log << result << endl;
+    }
+    return result;
+}
@@ -0,0 +1,57 @@
+#ifndef _SPRT_H_
+#define _SPRT_H_
+
+#include <iostream>
+
+#include "tournament.h"
+
+using std::ostream;
+
+// A sequential probability ratio test between two players: games are played
+// in batches until the results show, with the chosen error rates, that the
+// first player is elo1 or more stronger than the second (H1) or at most elo0
+// stronger (H0).
+struct SprtOptions {
+    // The players, threads, seed and so on. match.games is ignored.
+    TournamentOptions match;
+    double elo0 = 0;
+    double elo1 = 10;
+    // The chance of accepting H1 when H0 is true, and the other way round.
+    double alpha = 0.05;
+    double beta = 0.05;
+    // Games played between checks. Kept even so both players get as many
+    // games with White as with Black.
+    int batch_games = 100;
+    // Stop without a decision after this many games.
+    int max_games = 20000;
+};
+
+enum SprtDecision { SPRT_CONTINUE, SPRT_ACCEPT_H0, SPRT_ACCEPT_H1 };
+
+struct SprtResult {
+    TournamentResult games;
+    // The log likelihood ratio of H1 to H0 and the bounds it is tested against.
+    double llr = 0;
+    double lower_bound = 0;
+    double upper_bound = 0;
+    SprtDecision decision = SPRT_CONTINUE;
+    // The Elo difference the games suggest and the half width of its 95%
+    // confidence interval.
+    double elo = 0;
+    double elo_error = 0;
+};
+
+ostream& operator<<(ostream& os, const SprtResult& result);
+
+// The log likelihood ratio of elo1 to elo0 given these results (the usual
+// normal approximation to the trinomial win/draw/loss model).
+double sprt_llr(const TournamentResult& results, double elo0, double elo1);
+
+// Fills in result's Elo estimate, LLR and decision from result.games.
+void update_sprt(SprtResult& result, const SprtOptions& options);
+
+// Plays batches of games until the test decides or max_games is reached,
+// printing the state of the test to log after every batch.
+SprtResult run_sprt(const SprtOptions& options, ostream& log);
+
+#endif  // _SPRT_H_
@@ -0,0 +1,331 @@
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <random>
+#include <thread>
+
+#include "chess_eval.h"
+#include "chess_pieces.h"
+#include "position_dataset.h"
+#include "texel_tuner.h"
+
+using std::condition_variable;
+using std::endl;
+using std::function;
+using std::lock_guard;
+using std::min;
+using std::mt19937;
+using std::mutex;
+using std::shuffle;
+using std::thread;
+using std::unique_lock;
+
+// Where each parameter lives in the flat vector the tuner works on.
+const int MATERIAL_INDEX = 0;
+const int PIECE_SQUARE_INDEX = MATERIAL_INDEX + NUM_PIECE_TYPES;
+const int DOUBLED_PAWN_INDEX = PIECE_SQUARE_INDEX + NUM_PIECE_TYPES * PST_SQUARES;
+const int ISOLATED_PAWN_INDEX = DOUBLED_PAWN_INDEX + 1;
+const int PASSED_PAWN_INDEX = ISOLATED_PAWN_INDEX + 1;
+const int NUM_PARAMETERS = PASSED_PAWN_INDEX + 8;
+
+static vector<double> params_to_vector(const EvalParams& params) {
+    vector<double> values(NUM_PARAMETERS);
+    for (int type = 0; type < NUM_PIECE_TYPES; ++type) {
+        values[MATERIAL_INDEX + type] = params.material[type];
+        for (int square = 0; square < PST_SQUARES; ++square) {
+            values[PIECE_SQUARE_INDEX + type * PST_SQUARES + square] = params.piece_square[type][square];
+        }
+    }
+    values[DOUBLED_PAWN_INDEX] = params.doubled_pawn;
+    values[ISOLATED_PAWN_INDEX] = params.isolated_pawn;
+    for (int rank = 0; rank < 8; ++rank) {
+        values[PASSED_PAWN_INDEX + rank] = params.passed_pawn[rank];
+    }
+    return values;
+}
+
+static EvalParams vector_to_params(const vector<double>& values) {
+    EvalParams params;
+    for (int type = 0; type < NUM_PIECE_TYPES; ++type) {
+        params.material[type] = static_cast<int>(std::lround(values[MATERIAL_INDEX + type]));
+        for (int square = 0; square < PST_SQUARES; ++square) {
+            params.piece_square[type][square] = static_cast<int>(
+                std::lround(values[PIECE_SQUARE_INDEX + type * PST_SQUARES + square]));
+        }
+    }
+    params.doubled_pawn = static_cast<int>(std::lround(values[DOUBLED_PAWN_INDEX]));
+    params.isolated_pawn = static_cast<int>(std::lround(values[ISOLATED_PAWN_INDEX]));
+    for (int rank = 0; rank < 8; ++rank) {
+        params.passed_pawn[rank] = static_cast<int>(std::lround(values[PASSED_PAWN_INDEX + rank]));
+    }
+    return params;
+}
+
+// Parameters the tuner leaves alone: empty cells are always worth nothing,
+// a king is never missing from a position still being played, and pawns
+// can't be passed on their first or last rank.
+static vector<bool> frozen_parameters() {
+    vector<bool> frozen(NUM_PARAMETERS, false);
+    frozen[MATERIAL_INDEX + EMPTY] = true;
+    frozen[MATERIAL_INDEX + KING] = true;
+    for (int square = 0; square < PST_SQUARES; ++square) {
+        frozen[PIECE_SQUARE_INDEX + EMPTY * PST_SQUARES + square] = true;
+    }
+    frozen[PASSED_PAWN_INDEX] = true;
+    frozen[PASSED_PAWN_INDEX + 7] = true;
+    return frozen;
+}
+
+// eval = sum of value * parameter[index] over a position's coefficients.
+struct Coefficient {
+    int index;
+    int value;
+};
+
+static void position_coefficients(const PackedPosition& position, vector<Coefficient>& coefficients) {
+    coefficients.clear();
+    uint8_t codes[64];
+    unpack_codes(position, codes);
+    for (int square = 0; square < 64; ++square) {
+        int code = codes[square];
+        int type = code % NUM_PIECE_TYPES;
+        if (type == EMPTY) {
+            continue;
+        }
+        bool black = code >= NUM_PIECE_TYPES;
+        int sign = black ? -1 : 1;
+        int table_square = black ? square ^ 56 : square;
+        coefficients.push_back(Coefficient{ MATERIAL_INDEX + type, sign });
+        coefficients.push_back(Coefficient{ PIECE_SQUARE_INDEX + type * PST_SQUARES + table_square, sign });
+    }
+    PawnStructureTerms terms = pawn_structure_terms(codes, 8, 8);
+    if (terms.doubled_pawns != 0) {
+        coefficients.push_back(Coefficient{ DOUBLED_PAWN_INDEX, terms.doubled_pawns });
+    }
+    if (terms.isolated_pawns != 0) {
+        coefficients.push_back(Coefficient{ ISOLATED_PAWN_INDEX, terms.isolated_pawns });
+    }
+    for (int rank = 0; rank < 8; ++rank) {
+        if (terms.passed_pawns[rank] != 0) {
+            coefficients.push_back(Coefficient{ PASSED_PAWN_INDEX + rank, terms.passed_pawns[rank] });
+        }
+    }
+}
+
+static double predict(double eval, double k) {
+    return 1.0 / (1.0 + std::exp(-k * eval / 400.0));
+}
+
+static int thread_count(int threads) {
+    if (threads > 0) {
+        return threads;
+    }
+    return std::max(1u, thread::hardware_concurrency());
+}
+
+// Threads started once and reused for every parallel_for, so tuning doesn't
+// start and join threads for each mini-batch. The calling thread does the
+// first piece of the work itself.
+class TunerThreads {
+public:
+    explicit TunerThreads(int threads) : threads(threads) {
+        for (int t = 1; t < threads; ++t) {
+            workers.emplace_back(&TunerThreads::run, this, t);
+        }
+    }
+
+    ~TunerThreads() {
+        {
+            lock_guard<mutex> lock(work_mutex);
+            stopping = true;
+        }
+        start.notify_all();
+        for (thread& worker : workers) {
+            worker.join();
+        }
+    }
+
+    int size() const {
+        return threads;
+    }
+
+    // Splits [0, count) between the threads and calls work(thread, begin,
+    // end) on each piece in parallel.
+    void parallel_for(size_t count, const function<void(int, size_t, size_t)>& work) {
+        {
+            lock_guard<mutex> lock(work_mutex);
+            this->work = &work;
+            this->count = count;
+            running = threads - 1;
+            ++generation;
+        }
+        start.notify_all();
+        work_piece(0);
+        unique_lock<mutex> lock(work_mutex);
+        done.wait(lock, [this] { return running == 0; });
+        this->work = nullptr;
+    }
+
+private:
+    int threads;
+    vector<thread> workers;
+    mutex work_mutex;
+    condition_variable start, done;
+    const function<void(int, size_t, size_t)>* work = nullptr;
+    size_t count = 0;
+    int running = 0;
+    // Counts parallel_for calls, so a worker knows when there's new work.
+    long generation = 0;
+    bool stopping = false;
+
+    void work_piece(int t) {
+        size_t per_thread = (count + threads - 1) / threads;
+        size_t begin = min(count, t * per_thread), end = min(count, begin + per_thread);
+        (*work)(t, begin, end);
+    }
+
+    void run(int t) {
+        long seen = 0;
+        while (true) {
+            {
+                unique_lock<mutex> lock(work_mutex);
+                start.wait(lock, [this, seen] { return generation != seen || stopping; });
+                if (stopping) {
+                    return;
+                }
+                seen = generation;
+            }
+            work_piece(t);
+            lock_guard<mutex> lock(work_mutex);
+            if (--running == 0) {
+                done.notify_one();
+            }
+        }
+    }
+};
+
+static double texel_error(const vector<PackedPosition>& positions, const EvalParams& params, double k, TunerThreads& threads) {
+    vector<double> values = params_to_vector(params);
+    vector<double> errors(threads.size());
+    threads.parallel_for(positions.size(), [&](int t, size_t begin, size_t end) {
+        vector<Coefficient> coefficients;
+        double error = 0;
+        for (size_t i = begin; i < end; ++i) {
+            position_coefficients(positions[i], coefficients);
+            double eval = 0;
+            for (Coefficient c : coefficients) {
+                eval += c.value * values[c.index];
+            }
+            double difference = packed_white_score(positions[i]) - predict(eval, k);
+            error += difference * difference;
+        }
+        errors[t] = error;
+    });
+    double total = 0;
+    for (double error : errors) {
+        total += error;
+    }
+    return positions.empty() ? 0 : total / positions.size();
+}
+
+double texel_error(const vector<PackedPosition>& positions, const EvalParams& params, double k, int threads) {
+    TunerThreads tuner_threads(thread_count(threads));
+    return texel_error(positions, params, k, tuner_threads);
+}
+
+static double fit_texel_scale(const vector<PackedPosition>& positions, const EvalParams& params, TunerThreads& threads) {
+    // A coarse scan and then finer scans around the best k found so far.
+    double best_k = 1.0, best_error = texel_error(positions, params, best_k, threads);
+    for (double step = 0.5; step >= 0.01; step /= 5) {
+        double center = best_k;
+        for (int i = -5; i <= 5; ++i) {
+            double k = center + i * step;
+            if (k <= 0 || i == 0) {
+                continue;
+            }
+            double error = texel_error(positions, params, k, threads);
+            if (error < best_error) {
+                best_error = error;
+                best_k = k;
+            }
+        }
+    }
+    return best_k;
+}
+
+double fit_texel_scale(const vector<PackedPosition>& positions, const EvalParams& params, int threads) {
+    TunerThreads tuner_threads(thread_count(threads));
+    return fit_texel_scale(positions, params, tuner_threads);
+}
+
+EvalParams tune_eval_params(
+    const vector<PackedPosition>& positions, const EvalParams& initial,
+    const TexelTunerOptions& options, ostream& log) {
+    TunerThreads threads(thread_count(options.threads));
+    double k = fit_texel_scale(positions, initial, threads);
+    log << "k = " << k << ", starting error " << texel_error(positions, initial, k, threads) << endl;
+
+    vector<double> values = params_to_vector(initial);
+    vector<bool> frozen = frozen_parameters();
+    // Adam's running averages of the gradient and squared gradient.
+    const double beta1 = 0.9, beta2 = 0.999, epsilon = 1e-8;
+    vector<double> mean(NUM_PARAMETERS), variance(NUM_PARAMETERS);
+    long step = 0;
+
+    vector<size_t> order(positions.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    mt19937 random_number_generator(1);
+    vector<vector<double>> thread_gradients(threads.size(), vector<double>(NUM_PARAMETERS));
+    vector<double> gradient(NUM_PARAMETERS);
+
+    for (int epoch = 1; epoch <= options.epochs; ++epoch) {
+        shuffle(order.begin(), order.end(), random_number_generator);
+        for (size_t batch_begin = 0; batch_begin < order.size(); batch_begin += options.batch_size) {
+            size_t batch_size = min(options.batch_size, order.size() - batch_begin);
+            threads.parallel_for(batch_size, [&](int t, size_t begin, size_t end) {
+                vector<double>& local = thread_gradients[t];
+                std::fill(local.begin(), local.end(), 0.0);
+                vector<Coefficient> coefficients;
+                for (size_t i = begin; i < end; ++i) {
+                    const PackedPosition& position = positions[order[batch_begin + i]];
+                    position_coefficients(position, coefficients);
+                    double eval = 0;
+                    for (Coefficient c : coefficients) {
+                        eval += c.value * values[c.index];
+                    }
+                    double predicted = predict(eval, k);
+                    // d(error^2)/d(eval) through the sigmoid
+                    double d_eval = -2 * (packed_white_score(position) - predicted)
+                        * predicted * (1 - predicted) * k / 400.0;
+                    for (Coefficient c : coefficients) {
+                        local[c.index] += d_eval * c.value;
+                    }
+                }
+            });
+
+            std::fill(gradient.begin(), gradient.end(), 0.0);
+            for (const vector<double>& local : thread_gradients) {
+                for (int i = 0; i < NUM_PARAMETERS; ++i) {
+                    gradient[i] += local[i] / batch_size;
+                }
+            }
+            ++step;
+            for (int i = 0; i < NUM_PARAMETERS; ++i) {
+                if (frozen[i]) {
+                    continue;
+                }
+                mean[i] = beta1 * mean[i] + (1 - beta1) * gradient[i];
+                variance[i] = beta2 * variance[i] + (1 - beta2) * gradient[i] * gradient[i];
+                double mean_hat = mean[i] / (1 - std::pow(beta1, step));
+                double variance_hat = variance[i] / (1 - std::pow(beta2, step));
+                values[i] -= options.learning_rate * mean_hat / (std::sqrt(variance_hat) + epsilon);
+            }
+        }
+        log << "epoch " << epoch << ": error " << texel_error(positions, vector_to_params(values), k, threads) << endl;
+    }
+    return vector_to_params(values);
+}
@@ -0,0 +1,39 @@
+#ifndef _TEXEL_TUNER_H_
+#define _TEXEL_TUNER_H_
+
+#include <iostream>
+#include <vector>
+
+#include "chess_eval.h"
+#include "position_dataset.h"
+
+using std::ostream;
+using std::vector;
+
+// Texel's tuning method: the evaluation predicts each position's game
+// result through sigmoid(k * eval / 400), and the parameters are moved to
+// minimize the mean squared error between the predictions and the results.
+// Our evaluation is linear in its parameters, so the gradient is exact.
+struct TexelTunerOptions {
+    int epochs = 20;
+    // Positions per gradient step.
+    size_t batch_size = 16384;
+    // Adam step size, in centipawns.
+    double learning_rate = 1.0;
+    // Threads computing each gradient, 0 for one per core.
+    int threads = 0;
+};
+
+// The mean squared prediction error of params over positions.
+double texel_error(const vector<PackedPosition>& positions, const EvalParams& params, double k, int threads = 0);
+
+// Finds the k that makes params predict the results best.
+double fit_texel_scale(const vector<PackedPosition>& positions, const EvalParams& params, int threads = 0);
+
+// Tunes every parameter except the king and empty cell values, starting
+// from initial, and prints the error after each epoch to log.
+EvalParams tune_eval_params(
+    const vector<PackedPosition>& positions, const EvalParams& initial,
+    const TexelTunerOptions& options, ostream& log);
+
+#endif  // _TEXEL_TUNER_H_
@@ -0,0 +1,143 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "chess_board.h"
+#include "chess_pieces.h"
+#include "chess_player.h"
+#include "game_record.h"
+#include "tournament.h"
+
+using std::atomic;
+using std::find;
+using std::lock_guard;
+using std::mutex;
+using std::runtime_error;
+using std::thread;
+using std::unique_ptr;
+using std::vector;
+
+Team play_headless_game(const Player& white, const Player& black, int max_plies, GameRecord* record, int no_capture_limit) {
+    Board board;
+    board.set_no_capture_limit(no_capture_limit);
+    for (int ply = 0; ply < max_plies; ++ply) {
+        vector<Move> moves = board.get_moves();
+        if (moves.empty()) {
+            break;
+        }
+        const Player& player = board.teams_turn() == WHITE ? white : black;
+        Move move = player.get_move(board, moves);
+        if (find(moves.begin(), moves.end(), move) == moves.end()) {
+            throw runtime_error(string("play_headless_game: ") + player.name() + " chose a move that isn't allowed");
+        }
+        board.make_move(move);
+        if (record) {
+            record->moves.push_back(move);
+        }
+        if (board.game_over()) {
+            break;
+        }
+    }
+    if (record) {
+        record->winner = board.winner();
+    }
+    return board.winner();
+}
+
+int TournamentResult::games() const {
+    return first_wins + draws + second_wins;
+}
+
+double TournamentResult::score() const {
+    return games() == 0 ? 0 : (first_wins + 0.5 * draws) / games();
+}
+
+ostream& operator<<(ostream& os, const TournamentResult& result) {
+    return os
+        << "+" << result.first_wins << " =" << result.draws << " -" << result.second_wins
+        << " (score " << result.score() << ", " << result.seconds << "s)";
+}
+
+// splitmix64, to spread nearby seeds far apart.
+static uint64_t mix_seed(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+static unsigned game_seed(unsigned seed, int game, Team team) {
+    return static_cast<unsigned>(mix_seed((static_cast<uint64_t>(seed) << 32) + game * 2 + (team == BLACK ? 1 : 0)));
+}
+
+TournamentResult run_tournament(const TournamentOptions& options) {
+    auto start = std::chrono::steady_clock::now();
+    int threads = options.threads > 0 ? options.threads : std::max(1u, thread::hardware_concurrency());
+    threads = std::max(1, std::min(threads, options.games));
+
+    // Games are handed out one at a time, so a thread that gets short games
+    // goes on to play more of them.
+    atomic<int> next_game(0), first_wins(0), draws(0), second_wins(0);
+    vector<std::exception_ptr> errors(threads);
+    unique_ptr<GameRecordWriter> writer;
+    mutex writer_mutex;
+    if (!options.record_path.empty()) {
+        writer.reset(new GameRecordWriter(options.record_path));
+    }
+    auto play_games = [&](int t) {
+        try {
+            for (int index = next_game++; index < options.games; index = next_game++) {
+                int game = options.first_game + index;
+                bool first_is_white = game % 2 == 0;
+                const string& white_kind = first_is_white ? options.first_player : options.second_player;
+                const string& black_kind = first_is_white ? options.second_player : options.first_player;
+                unique_ptr<Player> white = make_player(white_kind, WHITE, game_seed(options.seed, game, WHITE), options.network);
+                unique_ptr<Player> black = make_player(black_kind, BLACK, game_seed(options.seed, game, BLACK), options.network);
+                GameRecord record(Board(), white_kind, black_kind);
+                Team winner = play_headless_game(*white, *black, options.max_plies, writer ? &record : nullptr, options.no_capture_limit);
+                if (writer) {
+                    lock_guard<mutex> lock(writer_mutex);
+                    writer->write(record);
+                }
+                if (winner == NONE) {
+                    ++draws;
+                }
+                else if ((winner == WHITE) == first_is_white) {
+                    ++first_wins;
+                }
+                else {
+                    ++second_wins;
+                }
+            }
+        }
+        catch (...) {
+            errors[t] = std::current_exception();
+            next_game = options.games;
+        }
+    };
+    vector<thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back(play_games, t);
+    }
+    for (thread& worker : workers) {
+        worker.join();
+    }
+    for (const std::exception_ptr& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    TournamentResult result;
+    result.first_wins = first_wins;
+    result.draws = draws;
+    result.second_wins = second_wins;
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
@@ -0,0 +1,68 @@
+#ifndef _TOURNAMENT_H_
+#define _TOURNAMENT_H_
+
+#include <iostream>
+#include <string>
+
+#include "chess_board.h"
+#include "chess_nnue.h"
+#include "chess_player.h"
+#include "game_record.h"
+
+using std::ostream;
+using std::string;
+
+// Plays one game between white and black without printing anything and
+// returns the winner, or NONE if the game was drawn (see Board::is_draw,
+// with no_capture_limit as the board's limit) or nobody has won after
+// max_plies moves. Throws runtime_error if a player picks a move that isn't
+// allowed. If record isn't nullptr, the moves and the result are added to it.
+Team play_headless_game(
+    const Player& white, const Player& black, int max_plies, GameRecord* record = nullptr,
+    int no_capture_limit = DEFAULT_NO_CAPTURE_LIMIT);
+
+struct TournamentOptions {
+    // Player kinds, as accepted by make_player.
+    string first_player = "ai";
+    string second_player = "checkmate";
+    int games = 100;
+    // The index of the first game, so a tournament can carry on from where
+    // another one with the same seed stopped.
+    int first_game = 0;
+    // Threads playing games, 0 for one per core.
+    int threads = 0;
+    // Every game's players are seeded from this, the game's index and their
+    // side, so a tournament plays the same games however many threads it has.
+    unsigned seed = 1;
+    // Games that go on longer than this are counted as draws.
+    int max_plies = 1000;
+    // Games are also drawn after this many plies without a capture (0 for
+    // no limit), or when a position comes up for the third time.
+    int no_capture_limit = DEFAULT_NO_CAPTURE_LIMIT;
+    // The network used by "nnue" players.
+    const NnueNetwork* network = nullptr;
+    // If set, every game is appended to this game record file (in the order
+    // the games finish).
+    string record_path;
+};
+
+// Win/draw/loss counts from the first player's point of view.
+struct TournamentResult {
+    int first_wins = 0;
+    int draws = 0;
+    int second_wins = 0;
+    double seconds = 0;
+
+    int games() const;
+    // The first player's average score: 1 for a win, 0.5 for a draw.
+    double score() const;
+};
+
+ostream& operator<<(ostream& os, const TournamentResult& result);
+
+// Plays options.games games between the two players on a pool of threads.
+// The players swap colors every game, the first player taking White in the
+// even numbered ones.
+TournamentResult run_tournament(const TournamentOptions& options);
+
+#endif  // _TOURNAMENT_H_
@@ -0,0 +1,175 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+
+#include "trace.h"
+
+using std::endl;
+using std::lock_guard;
+using std::mutex;
+using std::ofstream;
+using std::unique_ptr;
+
+struct TraceEvent {
+    int zone;
+    uint64_t start;
+    uint64_t duration;
+};
+
+struct ZoneTotals {
+    uint64_t calls = 0;
+    uint64_t nanoseconds = 0;
+};
+
+struct ThreadTrace {
+    int thread_id;
+    // The ring: event i of the thread goes in events[i % TRACE_RING_EVENTS].
+    vector<TraceEvent> events;
+    uint64_t recorded = 0;
+    // Indexed by zone id, grown as the thread enters new zones.
+    vector<ZoneTotals> totals;
+};
+
+// Never destroyed, so threads and atexit handlers can use it however late.
+struct TraceRegistry {
+    mutex registry_mutex;
+    vector<const char*> zone_names;
+    vector<unique_ptr<ThreadTrace>> threads;
+    std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+};
+
+static TraceRegistry& registry() {
+    static TraceRegistry* trace_registry = new TraceRegistry;
+    return *trace_registry;
+}
+
+static thread_local ThreadTrace* current_thread_trace = nullptr;
+
+static ThreadTrace& thread_trace() {
+    if (!current_thread_trace) {
+        TraceRegistry& traces = registry();
+        lock_guard<mutex> lock(traces.registry_mutex);
+        unique_ptr<ThreadTrace> trace(new ThreadTrace);
+        trace->thread_id = static_cast<int>(traces.threads.size());
+        trace->events.resize(TRACE_RING_EVENTS);
+        current_thread_trace = trace.get();
+        traces.threads.push_back(std::move(trace));
+    }
+    return *current_thread_trace;
+}
+
+static uint64_t trace_now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - registry().epoch).count();
+}
+
+#ifdef SILLY_CHESS_TRACE
+static void write_trace_at_exit() {
+    const char* path = std::getenv("SILLY_CHESS_TRACE_FILE");
+    string trace_path = path ? path : "silly-chess-trace.json";
+    ofstream out(trace_path);
+    write_chrome_trace(out);
+    std::cerr << "Trace written to " << trace_path << endl;
+    print_trace_summary(std::cerr);
+}
+#endif
+
+int register_trace_zone(const char* name) {
+    TraceRegistry& traces = registry();
+    lock_guard<mutex> lock(traces.registry_mutex);
+    for (size_t i = 0; i < traces.zone_names.size(); ++i) {
+        if (string(traces.zone_names[i]) == name) {
+            return static_cast<int>(i);
+        }
+    }
+#ifdef SILLY_CHESS_TRACE
+    if (traces.zone_names.empty()) {
+        std::atexit(write_trace_at_exit);
+    }
+#endif
+    traces.zone_names.push_back(name);
+    return static_cast<int>(traces.zone_names.size() - 1);
+}
+
+TraceZone::TraceZone(int zone) : zone(zone), start(trace_now()) {
+}
+
+TraceZone::~TraceZone() {
+    uint64_t duration = trace_now() - start;
+    ThreadTrace& trace = thread_trace();
+    trace.events[trace.recorded % TRACE_RING_EVENTS] = TraceEvent{ zone, start, duration };
+    ++trace.recorded;
+    if (static_cast<size_t>(zone) >= trace.totals.size()) {
+        trace.totals.resize(zone + 1);
+    }
+    ++trace.totals[zone].calls;
+    trace.totals[zone].nanoseconds += duration;
+}
+
+vector<TraceZoneSummary> trace_summary() {
+    TraceRegistry& traces = registry();
+    lock_guard<mutex> lock(traces.registry_mutex);
+    vector<TraceZoneSummary> summary(traces.zone_names.size());
+    for (size_t zone = 0; zone < summary.size(); ++zone) {
+        summary[zone].name = traces.zone_names[zone];
+    }
+    for (const unique_ptr<ThreadTrace>& trace : traces.threads) {
+        for (size_t zone = 0; zone < trace->totals.size(); ++zone) {
+            summary[zone].calls += trace->totals[zone].calls;
+            summary[zone].total_seconds += trace->totals[zone].nanoseconds * 1e-9;
+        }
+    }
+    summary.erase(std::remove_if(summary.begin(), summary.end(), [](const TraceZoneSummary& zone) {
+        return zone.calls == 0;
+    }), summary.end());
+    std::stable_sort(summary.begin(), summary.end(), [](const TraceZoneSummary& a, const TraceZoneSummary& b) {
+        return a.total_seconds > b.total_seconds;
+    });
+    return summary;
+}
+
+void print_trace_summary(ostream& os) {
+    os << std::left << std::setw(24) << "zone" << std::right << std::setw(12) << "calls"
+        << std::setw(14) << "total ms" << std::setw(12) << "mean ns" << endl;
+    for (const TraceZoneSummary& zone : trace_summary()) {
+        os << std::left << std::setw(24) << zone.name << std::right << std::setw(12) << zone.calls
+            << std::setw(14) << std::fixed << std::setprecision(3) << zone.total_seconds * 1e3
+            << std::setw(12) << std::setprecision(0) << zone.total_seconds * 1e9 / zone.calls << endl;
+    }
+    os << std::defaultfloat << std::setprecision(6);
+}
+
+void write_chrome_trace(ostream& os) {
+    TraceRegistry& traces = registry();
+    lock_guard<mutex> lock(traces.registry_mutex);
+    os << "{\"traceEvents\":[";
+    bool first = true;
+    for (const unique_ptr<ThreadTrace>& trace : traces.threads) {
+        uint64_t kept = std::min<uint64_t>(trace->recorded, TRACE_RING_EVENTS);
+        for (uint64_t i = trace->recorded - kept; i < trace->recorded; ++i) {
+            const TraceEvent& event = trace->events[i % TRACE_RING_EVENTS];
+            // Zone names are identifiers like Board::make_move, so they
+            // don't need escaping. Times are in microseconds.
+            os << (first ? "\n" : ",\n") << "{\"name\":\"" << traces.zone_names[event.zone]
+                << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << trace->thread_id
+                << ",\"ts\":" << event.start / 1000 << '.' << std::setfill('0') << std::setw(3) << event.start % 1000
+                << ",\"dur\":" << event.duration / 1000 << '.' << std::setw(3) << event.duration % 1000
+                << std::setfill(' ') << "}";
+            first = false;
+        }
+    }
+    os << "\n],\"displayTimeUnit\":\"ns\"}" << endl;
+}
+
+void clear_trace() {
+    TraceRegistry& traces = registry();
+    lock_guard<mutex> lock(traces.registry_mutex);
+    for (const unique_ptr<ThreadTrace>& trace : traces.threads) {
+        trace->recorded = 0;
+        trace->totals.clear();
+    }
+}
@@ -0,0 +1,73 @@
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using std::ostream;
+using std::string;
+using std::vector;
+
+// Scoped timing zones for finding where the time goes without an external
+// profiler. TRACE_ZONE("name") at the top of a block times that block. The
+// zones only exist when the program is built with SILLY_CHESS_TRACE defined;
+// otherwise the macro expands to nothing and costs nothing.
+//
+// Each thread records its zones into its own ring buffer, so a zone is a
+// couple of clock reads and no locking. The ring keeps each thread's newest
+// TRACE_RING_EVENTS zones for the Chrome trace, while the per-zone call
+// counts and times cover every zone. In a traced build, the program writes
+// the trace to the file named by the SILLY_CHESS_TRACE_FILE environment
+// variable (silly-chess-trace.json if unset) and prints the summary to cerr
+// when it exits.
+#ifdef SILLY_CHESS_TRACE
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_ZONE(name) \
+    static const int TRACE_CONCAT(trace_zone_id_, __LINE__) = register_trace_zone(name); \
+    TraceZone TRACE_CONCAT(trace_zone_, __LINE__)(TRACE_CONCAT(trace_zone_id_, __LINE__))
+#else
+#define TRACE_ZONE(name) ((void)0)
+#endif
+
+const size_t TRACE_RING_EVENTS = 1 << 15;
+
+// Returns the id of the zone called name, adding it if it's new. name has to
+// live as long as the program (TRACE_ZONE passes string literals).
+int register_trace_zone(const char* name);
+
+// Times the zone from construction to destruction. Use TRACE_ZONE instead
+// of making these directly, so untraced builds don't pay for them.
+class TraceZone {
+public:
+    explicit TraceZone(int zone);
+    ~TraceZone();
+    TraceZone(const TraceZone&) = delete;
+    TraceZone& operator=(const TraceZone&) = delete;
+
+private:
+    int zone;
+    uint64_t start;
+};
+
+struct TraceZoneSummary {
+    string name;
+    uint64_t calls = 0;
+    // Time inside the zone, including any zones nested in it.
+    double total_seconds = 0;
+};
+
+// Every zone entered so far over all threads, most total time first. Like
+// the functions below, this reads other threads' buffers without locking
+// them, so the traced threads should be idle (or finished) when it's called.
+vector<TraceZoneSummary> trace_summary();
+void print_trace_summary(ostream& os);
+// Writes the zones still in the ring buffers as Chrome trace event JSON, for
+// chrome://tracing or Perfetto.
+void write_chrome_trace(ostream& os);
+// Forgets every recorded zone.
+void clear_trace();
+
+#endif  // _TRACE_H_
@@ -1,113 +1,214 @@
-
-#include "utf8_codepoint.h"
-
-UTF8CodePoint::UTF8CodePoint(char32_t code_point) : code_point(code_point) {}
-
-UTF8CodePoint::operator char32_t() const {
-    return code_point;
-}
-
-// | First code point |  Byte 1  |  Byte 2  |  Byte 3  |  Byte 4  |
-// |:----------------:|:--------:|:--------:|:--------:|:--------:|
-// |           U+0000 | 0xxxxxxx |          |          |          |
-// |           U+0080 | 110xxxxx | 10xxxxxx |          |          |
-// |           U+0800 | 1110xxxx | 10xxxxxx | 10xxxxxx |          |
-// |          U+10000 | 11110xxx | 10xxxxxx | 10xxxxxx | 10xxxxxx |
-ostream& operator<<(ostream& os, const UTF8CodePoint cp) {
-    if (cp.code_point < 0x80) {
-        os.put(cp.code_point);
-    }
-    else if (cp.code_point < 0x800) {
-        os.put(0b1100'0000 | (cp.code_point >> 6 & 0b0001'1111));
-        os.put(0b1000'0000 | (cp.code_point & 0b0011'1111));
-    }
-    else if (cp.code_point < 0x10000) {
-        os.put(0b1110'0000 | (cp.code_point >> 12 & 0b0000'1111));
-        os.put(0b1000'0000 | (cp.code_point >> 6 & 0b0011'1111));
-        os.put(0b1000'0000 | (cp.code_point & 0b0011'1111));
-    }
-    else {  // if (cp.code_point < 0x200000)
-        os.put(0b1111'0000 | (cp.code_point >> 18 & 0b0000'0111));
-        os.put(0b1000'0000 | (cp.code_point >> 12 & 0b0011'1111));
-        os.put(0b1000'0000 | (cp.code_point >> 6 & 0b0011'1111));
-        os.put(0b1000'0000 | (cp.code_point & 0b0011'1111));
-    }
-    return os;
-}
-
-
-// | First code point |  Byte 1  |  Byte 2  |  Byte 3  |  Byte 4  |
-// |:----------------:|:--------:|:--------:|:--------:|:--------:|
-// |           U+0000 | 0xxxxxxx |          |          |          |
-// |           U+0080 | 110xxxxx | 10xxxxxx |          |          |
-// |           U+0800 | 1110xxxx | 10xxxxxx | 10xxxxxx |          |
-// |          U+10000 | 11110xxx | 10xxxxxx | 10xxxxxx | 10xxxxxx |
-istream& operator>>(istream& is, UTF8CodePoint& cp) {
-    unsigned char bytes[4];
-    is.read(reinterpret_cast<char*>(&bytes[0]), 1);
-
-    // Note: We don't need to check if is.read(..., 1) failed here because we
-    // check if (!is) after is.read().
-
-    // Figure out how many bytes we need to read for this UTF-8 code point.
-    int num_bytes;
-    if ((bytes[0] & 0b1000'0000) == 0b0000'0000) {
-        num_bytes = 1;
-    }
-    else if ((bytes[0] & 0b1110'0000) == 0b1100'0000) {
-        num_bytes = 2;
-    }
-    else if ((bytes[0] & 0b1111'0000) == 0b1110'0000) {
-        num_bytes = 3;
-    }
-    else if ((bytes[0] & 0b1111'1000) == 0b1111'0000) {
-        num_bytes = 4;
-    }
-    else {
-        is.putback(bytes[0]);
-        is.setstate(std::ios_base::failbit);
-        return is;
-    }
-
-    // We've already read the 0th byte and we need to read the rest.
-    is.read(reinterpret_cast<char*>(bytes + 1), num_bytes - 1);
-    if (!is) {
-        return is;
-    }
-
-    // Check bytes after bytes[0] are valid (i.e. highest 2 bits are "10")
-    for (int i = 1; i < num_bytes; ++i) {
-        if ((bytes[i] & 0b1100'0000) != 0b1000'0000) {
-            for (int j = 1; j < num_bytes; ++j) {
-                is.putback(bytes[j]);
-            }
-            is.setstate(std::ios_base::failbit);
-            return is;
-        }
-    }
-
-    switch (num_bytes) {
-    case 1:
-        cp.code_point = bytes[0];
-        return is;
-    case 2:
-        cp.code_point = (bytes[1] & 0b0011'1111) | (bytes[0] & 0b0001'1111) << 6;
-        return is;
-    case 3:
-        cp.code_point = (
-            (bytes[2] & 0b0011'1111) |
-            (bytes[1] & 0b0011'1111) << 6 |
-            (bytes[0] & 0b0000'1111) << 12);
-        return is;
-    case 4:
-        cp.code_point = (
-            (bytes[3] & 0b0011'1111) |
-            (bytes[2] & 0b0011'1111) << 6 |
-            (bytes[1] & 0b0011'1111) << 12 |
-            (bytes[0] & 0b0000'0111) << 18);
-        return is;
-    }
-
-    // Should never reach this line
-    return is;
-}
\ No newline at end of file
+
+#include <cstring>
+
+#if defined(__AVX2__) || defined(__SSE4_1__)
+#include <immintrin.h>
+#endif
+
+#include "utf8_codepoint.h"
+
+UTF8CodePoint::UTF8CodePoint(char32_t code_point) : code_point(code_point) {}
+
+UTF8CodePoint::operator char32_t() const {
+    return code_point;
+}
+
+// | First code point |  Byte 1  |  Byte 2  |  Byte 3  |  Byte 4  |
+// |:----------------:|:--------:|:--------:|:--------:|:--------:|
+// |           U+0000 | 0xxxxxxx |          |          |          |
+// |           U+0080 | 110xxxxx | 10xxxxxx |          |          |
+// |           U+0800 | 1110xxxx | 10xxxxxx | 10xxxxxx |          |
+// |          U+10000 | 11110xxx | 10xxxxxx | 10xxxxxx | 10xxxxxx |
+int utf8_sequence_length(unsigned char first_byte) {
+    if ((first_byte & 0b1000'0000) == 0b0000'0000) {
+        return 1;
+    }
+    else if ((first_byte & 0b1110'0000) == 0b1100'0000) {
+        return 2;
+    }
+    else if ((first_byte & 0b1111'0000) == 0b1110'0000) {
+        return 3;
+    }
+    else if ((first_byte & 0b1111'1000) == 0b1111'0000) {
+        return 4;
+    }
+    return 0;
+}
+
+// Encodes one code point into out and returns the number of bytes written.
+static size_t encode_one(char32_t code_point, char* out) {
+    if (code_point < 0x80) {
+        out[0] = static_cast<char>(code_point);
+        return 1;
+    }
+    else if (code_point < 0x800) {
+        out[0] = static_cast<char>(0b1100'0000 | (code_point >> 6 & 0b0001'1111));
+        out[1] = static_cast<char>(0b1000'0000 | (code_point & 0b0011'1111));
+        return 2;
+    }
+    else if (code_point < 0x10000) {
+        out[0] = static_cast<char>(0b1110'0000 | (code_point >> 12 & 0b0000'1111));
+        out[1] = static_cast<char>(0b1000'0000 | (code_point >> 6 & 0b0011'1111));
+        out[2] = static_cast<char>(0b1000'0000 | (code_point & 0b0011'1111));
+        return 3;
+    }
+    else {  // if (code_point < 0x200000)
+        out[0] = static_cast<char>(0b1111'0000 | (code_point >> 18 & 0b0000'0111));
+        out[1] = static_cast<char>(0b1000'0000 | (code_point >> 12 & 0b0011'1111));
+        out[2] = static_cast<char>(0b1000'0000 | (code_point >> 6 & 0b0011'1111));
+        out[3] = static_cast<char>(0b1000'0000 | (code_point & 0b0011'1111));
+        return 4;
+    }
+}
+
+// Decodes the num_bytes byte sequence at bytes, returning false if the bytes
+// after the first aren't continuation bytes (10xxxxxx).
+static bool decode_one(const unsigned char* bytes, int num_bytes, char32_t& code_point) {
+    for (int i = 1; i < num_bytes; ++i) {
+        if ((bytes[i] & 0b1100'0000) != 0b1000'0000) {
+            return false;
+        }
+    }
+    switch (num_bytes) {
+    case 1:
+        code_point = bytes[0];
+        return true;
+    case 2:
+        code_point = (bytes[1] & 0b0011'1111) | (bytes[0] & 0b0001'1111) << 6;
+        return true;
+    case 3:
+        code_point = (
+            (bytes[2] & 0b0011'1111) |
+            (bytes[1] & 0b0011'1111) << 6 |
+            (bytes[0] & 0b0000'1111) << 12);
+        return true;
+    case 4:
+        code_point = (
+            (bytes[3] & 0b0011'1111) |
+            (bytes[2] & 0b0011'1111) << 6 |
+            (bytes[1] & 0b0011'1111) << 12 |
+            (bytes[0] & 0b0000'0111) << 18);
+        return true;
+    }
+    return false;
+}
+
+ostream& operator<<(ostream& os, const UTF8CodePoint cp) {
+    char bytes[4];
+    return os.write(bytes, encode_one(cp.code_point, bytes));
+}
+
+// Reads one sequence's bytes off the stream and decodes them with
+// utf8_decode, so streams and buffers accept exactly the same UTF-8.
+istream& operator>>(istream& is, UTF8CodePoint& cp) {
+    char bytes[4];
+    is.read(bytes, 1);
+
+    // Note: We don't need to check if is.read(..., 1) failed here because we
+    // check if (!is) after is.read().
+
+    // Figure out how many bytes we need to read for this UTF-8 code point.
+    int num_bytes = utf8_sequence_length(static_cast<unsigned char>(bytes[0]));
+    if (num_bytes == 0) {
+        is.putback(bytes[0]);
+        is.setstate(std::ios_base::failbit);
+        return is;
+    }
+
+    // We've already read the 0th byte and we need to read the rest.
+    is.read(bytes + 1, num_bytes - 1);
+    if (!is) {
+        return is;
+    }
+
+    if (utf8_decode(bytes, num_bytes, &cp.code_point) != 1) {
+        for (int j = 1; j < num_bytes; ++j) {
+            is.putback(bytes[j]);
+        }
+        is.setstate(std::ios_base::failbit);
+    }
+    return is;
+}
+
+// Widens the ASCII run starting at bytes[i] into out[n], as many whole
+// vectors at a time as fit, and advances i and n past it.
+static void decode_ascii_run(const unsigned char* bytes, size_t length, char32_t* out, size_t& i, size_t& n) {
+#if defined(__AVX2__)
+    while (i + 32 <= length) {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bytes + i));
+        if (_mm256_movemask_epi8(chunk) != 0) {
+            break;
+        }
+        for (int part = 0; part < 4; ++part) {
+            __m128i eight = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(bytes + i + 8 * part));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + n + 8 * part), _mm256_cvtepu8_epi32(eight));
+        }
+        i += 32;
+        n += 32;
+    }
+#elif defined(__SSE4_1__)
+    while (i + 16 <= length) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + i));
+        if (_mm_movemask_epi8(chunk) != 0) {
+            break;
+        }
+        for (int part = 0; part < 4; ++part) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + n + 4 * part), _mm_cvtepu8_epi32(chunk));
+            chunk = _mm_srli_si128(chunk, 4);
+        }
+        i += 16;
+        n += 16;
+    }
+#endif
+    while (i < length && bytes[i] < 0x80) {
+        out[n++] = bytes[i++];
+    }
+}
+
+size_t utf8_decode(const char* text, size_t length, char32_t* out, size_t* bytes_used) {
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(text);
+    size_t i = 0, n = 0;
+    while (i < length) {
+        if (bytes[i] < 0x80) {
+            decode_ascii_run(bytes, length, out, i, n);
+            continue;
+        }
+        int num_bytes = utf8_sequence_length(bytes[i]);
+        if (num_bytes == 0 || i + num_bytes > length || !decode_one(bytes + i, num_bytes, out[n])) {
+            break;
+        }
+        i += num_bytes;
+        ++n;
+    }
+    if (bytes_used) {
+        *bytes_used = i;
+    }
+    return n;
+}
+
+size_t utf8_encode(const char32_t* code_points, size_t count, char* out) {
+    size_t i = 0, n = 0;
+    while (i < count) {
+#if defined(__AVX2__) || defined(__SSE4_1__)
+        // Four ASCII code points at a time: check the high bits are all 0,
+        // then narrow each 32 bit code point to a byte.
+        const __m128i not_ascii = _mm_set1_epi32(~0x7F);
+        while (i + 4 <= count) {
+            __m128i four = _mm_loadu_si128(reinterpret_cast<const __m128i*>(code_points + i));
+            if (!_mm_testz_si128(four, not_ascii)) {
+                break;
+            }
+            __m128i narrow = _mm_packus_epi16(_mm_packus_epi32(four, four), _mm_setzero_si128());
+            int packed = _mm_cvtsi128_si32(narrow);
+            memcpy(out + n, &packed, 4);
+            i += 4;
+            n += 4;
+        }
+        if (i == count) {
+            break;
+        }
+#endif
+        n += encode_one(code_points[i++], out + n);
+    }
+    return n;
+}
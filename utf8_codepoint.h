@@ -1,25 +1,41 @@
-#ifndef _UTF8_CODE_POINT_
-#define _UTF8_CODE_POINT_
-
-#include <iostream>
-#include <string>
-#include <cstdint>  // char32_t
-
-using std::ostream;
-using std::istream;
-
-class UTF8CodePoint {
-	char32_t code_point;
-public:
-	// Since we created other constructors, we have to use " = default" to get the
-	// default constructor (or define our own default constructor).
-	UTF8CodePoint() = default;
-	UTF8CodePoint(char32_t code_point);
-
-	operator char32_t() const;
-
-	friend ostream& operator<<(ostream& os, const UTF8CodePoint cp);
-	friend istream& operator>>(istream& is, UTF8CodePoint& cp);
-};
-
-#endif  // _UTF8_CODE_POINT_#pragma once
+#ifndef _UTF8_CODE_POINT_
+#define _UTF8_CODE_POINT_
+
+#include <iostream>
+#include <string>
+#include <cstddef>
+#include <cstdint>  // char32_t
+
+using std::ostream;
+using std::istream;
+
+class UTF8CodePoint {
+	char32_t code_point;
+public:
+	// Since we created other constructors, we have to use " = default" to get the
+	// default constructor (or define our own default constructor).
+	UTF8CodePoint() = default;
+	UTF8CodePoint(char32_t code_point);
+
+	operator char32_t() const;
+
+	friend ostream& operator<<(ostream& os, const UTF8CodePoint cp);
+	friend istream& operator>>(istream& is, UTF8CodePoint& cp);
+};
+
+// The number of bytes in the UTF-8 sequence that starts with first_byte, or
+// 0 if first_byte can't start a sequence.
+int utf8_sequence_length(unsigned char first_byte);
+
+// Decodes the UTF-8 in bytes[0, length) into out, which needs room for
+// length code points. Stops early at an invalid or unfinished sequence.
+// Returns the number of code points written, and stores the number of bytes
+// decoded in *bytes_used if it isn't nullptr. Runs of ASCII (like the empty
+// cells of a board) are decoded 16 or 32 bytes at a time with SSE4.1/AVX2.
+size_t utf8_decode(const char* bytes, size_t length, char32_t* out, size_t* bytes_used = nullptr);
+
+// Encodes count code points into out, which needs room for 4 * count
+// bytes. Returns the number of bytes written.
+size_t utf8_encode(const char32_t* code_points, size_t count, char* out);
+
+#endif  // _UTF8_CODE_POINT_#pragma once